@@ -0,0 +1,75 @@
+/*
+  Dispatch cost of delegates compared with virtual calls and
+  std::function.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+
+#include <rock/delegate.hpp>
+
+
+namespace {
+
+const int iterations = 100000000;
+
+class Handler {
+public:
+  __attribute__((noinline)) int on_event(int x) { return value += x; }
+
+  int value = 0;
+};
+
+class VirtualBase {
+public:
+  virtual ~VirtualBase() {}
+  virtual int on_event(int x) = 0;
+};
+
+class VirtualHandler : public VirtualBase {
+public:
+  __attribute__((noinline)) int on_event(int x) override { return value += x; }
+
+  int value = 0;
+};
+
+// hides the pointer value from the optimizer, so calls are not devirtualized
+template<typename T>
+T *opaque(T *p) {
+  __asm__ volatile("" : "+r"(p));
+  return p;
+}
+
+template<typename F>
+void run(const char *name, F &&f) {
+  auto start = std::chrono::steady_clock::now();
+  int r = 0;
+  for (int i = 0; i < iterations; i++) {
+    r = f(i);
+  }
+  auto end = std::chrono::steady_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(end - start).count();
+  std::printf("%-24s %6.2f ns/call (%d)\n", name, ns / iterations, r);
+}
+
+}
+
+
+int main() {
+  Handler h;
+  VirtualHandler vh;
+
+  auto d = rock::delegate<int (int)>::from<Handler, &Handler::on_event>(&h);
+  auto *dp = opaque(&d);
+  run("rock::delegate", [dp](int x) { return (*dp)(x); });
+
+  VirtualBase *vb = opaque<VirtualBase>(&vh);
+  run("virtual", [vb](int x) { return vb->on_event(x); });
+
+  std::function<int (int)> f = std::bind(&Handler::on_event, &h, std::placeholders::_1);
+  auto *fp = opaque(&f);
+  run("std::function", [fp](int x) { return (*fp)(x); });
+
+  return 0;
+}
@@ -0,0 +1,247 @@
+#ifndef _ROCK_ACTOR_HPP_
+#define _ROCK_ACTOR_HPP_
+
+/*
+  Actor runtime
+
+  Actor:
+    mailbox  - lock-free MPSC stack of messages (head pointer)
+    inbox    -> Queue of messages taken from the mailbox, FIFO
+    handler  - delegate called for each message
+    run_node - link in run queue of the runtime
+
+  Mailbox head:
+    nullptr  - idle, no messages
+    marker   - scheduled or running, no new messages
+    Message  - new messages (newest first), actor is scheduled
+
+
+  notes:
+  - messages embed queue_node, runtime never allocates
+  - sender pushes with one CAS, the sender which finds the mailbox idle
+    schedules the actor, so an actor is in the run queue at most once
+  - worker takes the whole mailbox with one exchange and handles up to
+    batch messages per turn, actor with remaining messages goes to the
+    end of the run queue
+  - idle actor costs 8 words and no runtime resources
+  - actor has to be idle when it is destroyed, handler must not throw
+ */
+
+
+#include <atomic>
+#include <cassert>
+#include <cinttypes>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "delegate.hpp"
+#include "queue.hpp"
+#include "utils.hpp"
+
+
+namespace rock {
+
+class actor_runtime;
+
+class actor_base : private queue_base {
+public:
+  actor_base(const actor_base&) = delete;
+  actor_base &operator=(const actor_base&) = delete;
+
+  ~actor_base() {
+    assert(idle());
+  }
+
+  // True when the actor has no messages and is not scheduled.
+  bool idle() const noexcept {
+    return !mailbox_.load(std::memory_order_acquire);
+  }
+
+protected:
+  using dispatch_type = void (*)(actor_base&, queue_node&);
+
+  actor_base(actor_runtime &rt, dispatch_type dispatch) noexcept
+    : runtime_(&rt), dispatch_(dispatch) {}
+
+  void post(queue_node &n) noexcept;
+
+private:
+  static queue_node *marker_() noexcept {
+    return reinterpret_cast<queue_node*>(uintptr_t(1));
+  }
+
+  // Returns true when the actor has to be scheduled again.
+  bool run_(unsigned batch) {
+    take_();
+    for (unsigned i = 0; i < batch && !is_empty(); i++) {
+      dispatch_(*this, queue_base::pop());
+    }
+    if (!is_empty()) {
+      return true;
+    }
+
+    queue_node *m = marker_();
+    if (mailbox_.compare_exchange_strong(m, nullptr, std::memory_order_acq_rel)) {
+      return false;
+    }
+    // messages arrived during the turn
+    return true;
+  }
+
+  // Moves messages from the mailbox to the inbox in arrival order.
+  void take_() noexcept {
+    queue_node *n = mailbox_.exchange(marker_(), std::memory_order_acquire);
+    queue_node *rev = nullptr;
+    while (n && n != marker_()) {
+      queue_node *next = n->next_;
+      n->next_ = rev;
+      rev = n;
+      n = next;
+    }
+    while (rev) {
+      queue_node *next = rev->next_;
+      queue_base::push(*rev);
+      rev = next;
+    }
+  }
+
+  std::atomic<queue_node*>  mailbox_{nullptr};
+  actor_runtime            *runtime_;
+  dispatch_type             dispatch_;
+  queue_node                run_node_;
+
+  friend class actor_runtime;
+
+public:
+  using run_node_dmp = dmp<queue_node actor_base::*, &actor_base::run_node_>;
+};
+
+
+template<typename DMP>
+class actor : public actor_base {
+public:
+  typedef typename DMP::container_type value_type;
+  typedef value_type                  &reference;
+  typedef delegate<void (reference)>   handler_type;
+
+  actor(actor_runtime &rt, handler_type handler) noexcept
+    : actor_base(rt, &dispatch_),
+      handler_(handler) {}
+
+  // Can be called from any thread.
+  void send(reference m) noexcept {
+    post(*DMP::to_member(&m));
+  }
+
+private:
+  static void dispatch_(actor_base &a, queue_node &n) {
+    static_cast<actor&>(a).handler_(*DMP::to_container(&n));
+  }
+
+  handler_type handler_;
+};
+
+
+class actor_runtime {
+public:
+  static constexpr unsigned default_batch = 64;
+
+  // Runtime without threads runs actors only in poll().
+  explicit actor_runtime(unsigned threads = std::thread::hardware_concurrency(),
+                         unsigned batch = default_batch)
+    : batch_(batch) {
+    assert(batch_);
+    workers_.reserve(threads);
+    for (unsigned i = 0; i < threads; i++) {
+      workers_.emplace_back([this]() { work_(); });
+    }
+  }
+
+  actor_runtime(const actor_runtime&) = delete;
+  actor_runtime &operator=(const actor_runtime&) = delete;
+
+  ~actor_runtime() {
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      stop_ = true;
+    }
+    ready_cond_.notify_all();
+    for (auto &w : workers_) {
+      w.join();
+    }
+  }
+
+  std::size_t threads() const noexcept { return workers_.size(); }
+  unsigned batch() const noexcept { return batch_; }
+
+  // Runs scheduled actors on the calling thread until the run queue is
+  // empty, returns number of turns.
+  std::size_t poll() {
+    std::size_t turns = 0;
+    std::unique_lock<std::mutex> guard(lock_);
+    while (!ready_.is_empty()) {
+      actor_base &a = ready_.pop();
+      guard.unlock();
+      turn_(a);
+      turns++;
+      guard.lock();
+    }
+    return turns;
+  }
+
+private:
+  void schedule_(actor_base &a) {
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      ready_.push(a);
+    }
+    ready_cond_.notify_one();
+  }
+
+  void turn_(actor_base &a) {
+    if (a.run_(batch_)) {
+      schedule_(a);
+    }
+  }
+
+  void work_() {
+    std::unique_lock<std::mutex> guard(lock_);
+    for (;;) {
+      ready_cond_.wait(guard, [this]() { return !ready_.is_empty() || stop_; });
+      if (stop_) {
+        return;
+      }
+      actor_base &a = ready_.pop();
+      guard.unlock();
+      turn_(a);
+      guard.lock();
+    }
+  }
+
+  unsigned                           batch_;
+  std::mutex                         lock_;
+  std::condition_variable            ready_cond_;
+  queue<actor_base::run_node_dmp>    ready_;
+  bool                               stop_ = false;
+  std::vector<std::thread>           workers_;
+
+  friend class actor_base;
+};
+
+
+inline void actor_base::post(queue_node &n) noexcept {
+  queue_node *head = mailbox_.load(std::memory_order_relaxed);
+  do {
+    n.next_ = head == marker_() ? nullptr : head;
+  } while (!mailbox_.compare_exchange_weak(head, &n, std::memory_order_release,
+                                           std::memory_order_relaxed));
+  if (!head) {
+    runtime_->schedule_(*this);
+  }
+}
+
+}
+
+#endif
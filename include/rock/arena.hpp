@@ -0,0 +1,130 @@
+#ifndef _ROCK_ARENA_HPP_
+#define _ROCK_ARENA_HPP_
+
+/*
+  Arena and compaction
+
+  Arena:
+    items    -> one 64 byte aligned block of capacity objects
+    size     - number of constructed objects
+
+
+  notes:
+  - objects are constructed in order and destroyed with the arena, the
+    arena never grows, so objects never move once constructed
+  - compact() moves elements of a long-lived container into the arena
+    in container order, consecutive elements become neighbours in memory
+  - element has to be nothrow move constructible, nodes are not moved by
+    the element move constructor, the compacted container moves its own
+    links and relink moves the other list memberships with
+    list_node::relocate_from(), so the element can be in many lists but
+    in one queue at most
+  - compact() checks the free space of the arena before moving anything
+  - relink_by_address() of list and queue is the cheaper alternative
+    when the order doesn't matter and elements stay where they are
+ */
+
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+
+namespace rock {
+
+template<typename T>
+class arena {
+public:
+  typedef T              value_type;
+  typedef T             *pointer;
+  typedef T             &reference;
+  typedef std::size_t    size_type;
+
+  typedef T       *iterator;
+  typedef const T *const_iterator;
+
+  explicit arena(size_type capacity) : capacity_(capacity) {
+    void *p;
+    std::size_t align = alignof(T) > 64 ? alignof(T) : 64;
+    if (posix_memalign(&p, align, capacity * sizeof(T) + !capacity)) {
+      throw std::bad_alloc();
+    }
+    items_ = static_cast<T*>(p);
+  }
+
+  arena(const arena&) = delete;
+  arena &operator=(const arena&) = delete;
+
+  ~arena() {
+    while (size_) {
+      items_[--size_].~T();
+    }
+    free(items_);
+  }
+
+  size_type size() const noexcept { return size_; }
+  size_type capacity() const noexcept { return capacity_; }
+  bool full() const noexcept { return size_ == capacity_; }
+
+  bool contains(const T *p) const noexcept {
+    return p >= items_ && p < items_ + size_;
+  }
+
+  iterator begin() noexcept { return items_; }
+  iterator end() noexcept { return items_ + size_; }
+  const_iterator cbegin() const noexcept { return items_; }
+  const_iterator cend() const noexcept { return items_ + size_; }
+
+  template<typename... Args>
+  reference emplace(Args&&... args) {
+    assert(!full());
+    T *o = new (items_ + size_) T(std::forward<Args>(args)...);
+    size_++;
+    return *o;
+  }
+
+private:
+  T         *items_;
+  size_type  size_ = 0;
+  size_type  capacity_;
+};
+
+
+// Moves elements of c into a keeping c order, relink(old, new) is called
+// after each move to relocate memberships in other lists, dispose(old)
+// after that, c holds the new elements afterwards. Throws length_error
+// when the elements don't fit into a.
+template<typename Container, typename Relink, typename Dispose>
+void compact(Container &c, arena<typename Container::value_type> &a,
+             Relink relink, Dispose dispose) {
+  typedef typename Container::value_type value_type;
+  typedef typename Container::reference  reference;
+  static_assert(std::is_nothrow_move_constructible<value_type>::value,
+                "compacted element has to be nothrow move constructible");
+
+  std::size_t n = std::distance(c.begin(), c.end());
+  if (n > a.capacity() - a.size()) {
+    throw std::length_error("arena is too small");
+  }
+
+  c.relocate([&a, &relink](reference o) -> reference {
+      reference m = a.emplace(std::move(o));
+      relink(o, m);
+      return m;
+    }, dispose);
+}
+
+template<typename Container, typename Dispose>
+void compact(Container &c, arena<typename Container::value_type> &a, Dispose dispose) {
+  typedef typename Container::reference reference;
+  compact(c, a, [](reference, reference) {}, dispose);
+}
+
+}
+
+#endif
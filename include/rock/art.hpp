@@ -0,0 +1,865 @@
+#ifndef _ROCK_ART_HPP_
+#define _ROCK_ART_HPP_
+
+/*
+  Intrusive Adaptive Radix Tree
+
+  Root:
+    root -> Node | Leaf
+
+  Inner Node (4, 16, 48, 256):
+    prefix   - compressed path (only first art_max_prefix bytes are stored)
+    term     -> Leaf (key that ends at this node)
+    children -> Node | Leaf
+
+  Leaf:
+    tagged pointer to the user object, key is read through DMP
+
+
+  notes:
+  - inner nodes are allocated by the tree, user objects are never copied
+  - keys are compared as big-endian byte strings, so integer keys are
+    iterated in numeric order
+  - keys have to be unique
+ */
+
+
+#include <algorithm>
+#include <cassert>
+#include <cinttypes>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace rock {
+
+/*
+  Key encoding
+
+  Specialize art_key for custom key types, it should provide data()
+  and size() with the ordered byte representation of the key.
+ */
+template<typename K, typename Enable = void>
+class art_key;
+
+template<typename K>
+class art_key<K, typename std::enable_if<std::is_integral<K>::value>::type> {
+public:
+  explicit art_key(K k) noexcept {
+    using U = typename std::make_unsigned<K>::type;
+    U u = static_cast<U>(k);
+    if (std::is_signed<K>::value) {
+      u ^= U(1) << (sizeof(K) * 8 - 1);
+    }
+    for (std::size_t i = sizeof(K); i > 0; i--) {
+      bytes_[i - 1] = static_cast<uint8_t>(u);
+      u = static_cast<U>(u >> 4 >> 4);
+    }
+  }
+
+  const uint8_t *data() const noexcept { return bytes_; }
+  std::size_t size() const noexcept { return sizeof(K); }
+
+private:
+  uint8_t bytes_[sizeof(K)];
+};
+
+template<>
+class art_key<std::string> {
+public:
+  explicit art_key(const std::string &s) noexcept
+    : data_(reinterpret_cast<const uint8_t*>(s.data())),
+      size_(s.size()) {}
+
+  const uint8_t *data() const noexcept { return data_; }
+  std::size_t size() const noexcept { return size_; }
+
+private:
+  const uint8_t *data_;
+  std::size_t    size_;
+};
+
+
+static constexpr std::size_t art_max_prefix = 8;
+
+enum class art_node_type : uint8_t {
+  node4,
+  node16,
+  node48,
+  node256
+};
+
+class art_node {
+public:
+  art_node(const art_node&) = delete;
+  art_node &operator=(const art_node&) = delete;
+
+  explicit art_node(art_node_type t) noexcept : type(t) {}
+
+  art_node_type type;
+  uint16_t      size = 0;
+  uint32_t      prefix_len = 0;
+  uint8_t       prefix[art_max_prefix];
+  void         *term = nullptr;
+};
+
+class art_node4 : public art_node {
+public:
+  art_node4() noexcept : art_node(art_node_type::node4) {}
+
+  uint8_t keys[4];
+  void   *children[4];
+};
+
+class art_node16 : public art_node {
+public:
+  art_node16() noexcept : art_node(art_node_type::node16) {}
+
+  uint8_t keys[16];
+  void   *children[16];
+};
+
+class art_node48 : public art_node {
+public:
+  art_node48() noexcept : art_node(art_node_type::node48) {
+    std::memset(index, 0, sizeof(index));
+    std::memset(children, 0, sizeof(children));
+  }
+
+  uint8_t index[256];
+  void   *children[48];
+};
+
+class art_node256 : public art_node {
+public:
+  art_node256() noexcept : art_node(art_node_type::node256) {
+    std::memset(children, 0, sizeof(children));
+  }
+
+  void *children[256];
+};
+
+
+/*
+  Untyped part of the tree: node layout, child lookup, growing and
+  shrinking of the inner nodes.
+ */
+class art_base {
+public:
+  art_base() noexcept {}
+  art_base(const art_base&) = delete;
+  art_base &operator=(const art_base&) = delete;
+
+  ~art_base() { destroy_(root_); }
+
+  bool empty() const noexcept { return !root_; }
+  std::size_t size() const noexcept { return size_; }
+
+  void clear() noexcept {
+    destroy_(root_);
+    root_ = nullptr;
+    size_ = 0;
+  }
+
+protected:
+  static bool is_leaf_(const void *p) noexcept {
+    return reinterpret_cast<uintptr_t>(p) & 1;
+  }
+  static void *to_leaf_(const void *o) noexcept {
+    return reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(o) | 1);
+  }
+  static void *from_leaf_(const void *p) noexcept {
+    return reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(p) & ~uintptr_t(1));
+  }
+
+  static void **find_child_(art_node *n, uint8_t c) noexcept {
+    switch (n->type) {
+    case art_node_type::node4: {
+      art_node4 *p = static_cast<art_node4*>(n);
+      for (unsigned i = 0; i < n->size; i++) {
+        if (p->keys[i] == c) {
+          return &p->children[i];
+        }
+      }
+      return nullptr;
+    }
+    case art_node_type::node16: {
+      art_node16 *p = static_cast<art_node16*>(n);
+#ifdef __SSE2__
+      __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8(static_cast<char>(c)),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(p->keys)));
+      unsigned bits = static_cast<unsigned>(_mm_movemask_epi8(cmp)) & ((1u << n->size) - 1);
+      if (bits) {
+        return &p->children[__builtin_ctz(bits)];
+      }
+#else
+      for (unsigned i = 0; i < n->size; i++) {
+        if (p->keys[i] == c) {
+          return &p->children[i];
+        }
+      }
+#endif
+      return nullptr;
+    }
+    case art_node_type::node48: {
+      art_node48 *p = static_cast<art_node48*>(n);
+      uint8_t i = p->index[c];
+      return i ? &p->children[i - 1] : nullptr;
+    }
+    case art_node_type::node256: {
+      art_node256 *p = static_cast<art_node256*>(n);
+      return p->children[c] ? &p->children[c] : nullptr;
+    }
+    }
+    return nullptr;
+  }
+
+  static void copy_header_(art_node *dst, const art_node *src) noexcept {
+    dst->size = src->size;
+    dst->prefix_len = src->prefix_len;
+    std::memcpy(dst->prefix, src->prefix, art_max_prefix);
+    dst->term = src->term;
+  }
+
+  // Inserts new child into the node, node can be replaced with a larger one.
+  static void add_child_(art_node *n, void **ref, uint8_t c, void *child) {
+    switch (n->type) {
+    case art_node_type::node4: {
+      art_node4 *p = static_cast<art_node4*>(n);
+      if (n->size < 4) {
+        unsigned i = 0;
+        while (i < n->size && p->keys[i] < c) {
+          i++;
+        }
+        std::memmove(p->keys + i + 1, p->keys + i, n->size - i);
+        std::memmove(p->children + i + 1, p->children + i, (n->size - i) * sizeof(void*));
+        p->keys[i] = c;
+        p->children[i] = child;
+        n->size++;
+      } else {
+        art_node16 *g = new art_node16();
+        copy_header_(g, n);
+        std::memcpy(g->keys, p->keys, 4);
+        std::memcpy(g->children, p->children, 4 * sizeof(void*));
+        *ref = g;
+        delete p;
+        add_child_(g, ref, c, child);
+      }
+      break;
+    }
+    case art_node_type::node16: {
+      art_node16 *p = static_cast<art_node16*>(n);
+      if (n->size < 16) {
+        unsigned i = 0;
+        while (i < n->size && p->keys[i] < c) {
+          i++;
+        }
+        std::memmove(p->keys + i + 1, p->keys + i, n->size - i);
+        std::memmove(p->children + i + 1, p->children + i, (n->size - i) * sizeof(void*));
+        p->keys[i] = c;
+        p->children[i] = child;
+        n->size++;
+      } else {
+        art_node48 *g = new art_node48();
+        copy_header_(g, n);
+        for (unsigned i = 0; i < 16; i++) {
+          g->index[p->keys[i]] = static_cast<uint8_t>(i + 1);
+          g->children[i] = p->children[i];
+        }
+        *ref = g;
+        delete p;
+        add_child_(g, ref, c, child);
+      }
+      break;
+    }
+    case art_node_type::node48: {
+      art_node48 *p = static_cast<art_node48*>(n);
+      if (n->size < 48) {
+        // free slots are not compacted, find the first empty one
+        unsigned i = 0;
+        for (; i < 48; i++) {
+          if (!p->children[i]) {
+            break;
+          }
+        }
+        p->children[i] = child;
+        p->index[c] = static_cast<uint8_t>(i + 1);
+        n->size++;
+      } else {
+        art_node256 *g = new art_node256();
+        copy_header_(g, n);
+        for (unsigned i = 0; i < 256; i++) {
+          if (p->index[i]) {
+            g->children[i] = p->children[p->index[i] - 1];
+          }
+        }
+        *ref = g;
+        delete p;
+        add_child_(g, ref, c, child);
+      }
+      break;
+    }
+    case art_node_type::node256: {
+      art_node256 *p = static_cast<art_node256*>(n);
+      p->children[c] = child;
+      n->size++;
+      break;
+    }
+    }
+  }
+
+  // Removes child from the node, node can be replaced with a smaller one.
+  static void remove_child_(art_node *n, void **ref, uint8_t c, void **slot) {
+    switch (n->type) {
+    case art_node_type::node4: {
+      art_node4 *p = static_cast<art_node4*>(n);
+      unsigned i = static_cast<unsigned>(slot - p->children);
+      std::memmove(p->keys + i, p->keys + i + 1, n->size - i - 1);
+      std::memmove(p->children + i, p->children + i + 1, (n->size - i - 1) * sizeof(void*));
+      n->size--;
+      break;
+    }
+    case art_node_type::node16: {
+      art_node16 *p = static_cast<art_node16*>(n);
+      unsigned i = static_cast<unsigned>(slot - p->children);
+      std::memmove(p->keys + i, p->keys + i + 1, n->size - i - 1);
+      std::memmove(p->children + i, p->children + i + 1, (n->size - i - 1) * sizeof(void*));
+      n->size--;
+      if (n->size == 3) {
+        art_node4 *s = new art_node4();
+        copy_header_(s, n);
+        std::memcpy(s->keys, p->keys, 3);
+        std::memcpy(s->children, p->children, 3 * sizeof(void*));
+        *ref = s;
+        delete p;
+      }
+      break;
+    }
+    case art_node_type::node48: {
+      art_node48 *p = static_cast<art_node48*>(n);
+      p->children[p->index[c] - 1] = nullptr;
+      p->index[c] = 0;
+      n->size--;
+      if (n->size == 12) {
+        art_node16 *s = new art_node16();
+        copy_header_(s, n);
+        unsigned j = 0;
+        for (unsigned i = 0; i < 256; i++) {
+          if (p->index[i]) {
+            s->keys[j] = static_cast<uint8_t>(i);
+            s->children[j] = p->children[p->index[i] - 1];
+            j++;
+          }
+        }
+        *ref = s;
+        delete p;
+      }
+      break;
+    }
+    case art_node_type::node256: {
+      art_node256 *p = static_cast<art_node256*>(n);
+      p->children[c] = nullptr;
+      n->size--;
+      if (n->size == 37) {
+        art_node48 *s = new art_node48();
+        copy_header_(s, n);
+        unsigned j = 0;
+        for (unsigned i = 0; i < 256; i++) {
+          if (p->children[i]) {
+            s->children[j] = p->children[i];
+            s->index[i] = static_cast<uint8_t>(j + 1);
+            j++;
+          }
+        }
+        *ref = s;
+        delete p;
+      }
+      break;
+    }
+    }
+  }
+
+  // Replaces node with a single remaining entry by that entry.
+  static void collapse_(void **ref) {
+    art_node *n = static_cast<art_node*>(*ref);
+    if (n->size == 0) {
+      assert(n->term);
+      *ref = n->term;
+      delete_node_(n);
+      return;
+    }
+    if (n->size > 1 || n->term || n->type != art_node_type::node4) {
+      return;
+    }
+
+    art_node4 *p = static_cast<art_node4*>(n);
+    void *child = p->children[0];
+    if (!is_leaf_(child)) {
+      art_node *c = static_cast<art_node*>(child);
+      uint8_t prefix[art_max_prefix];
+      std::size_t len = n->prefix_len < art_max_prefix ? n->prefix_len : art_max_prefix;
+      std::memcpy(prefix, n->prefix, len);
+      if (len < art_max_prefix) {
+        prefix[len++] = p->keys[0];
+      }
+      std::size_t clen = c->prefix_len < art_max_prefix ? c->prefix_len : art_max_prefix;
+      for (std::size_t i = 0; len < art_max_prefix && i < clen; i++) {
+        prefix[len++] = c->prefix[i];
+      }
+      std::memcpy(c->prefix, prefix, len);
+      c->prefix_len += n->prefix_len + 1;
+    }
+    *ref = child;
+    delete p;
+  }
+
+  static void delete_node_(art_node *n) noexcept {
+    switch (n->type) {
+    case art_node_type::node4:   delete static_cast<art_node4*>(n);   break;
+    case art_node_type::node16:  delete static_cast<art_node16*>(n);  break;
+    case art_node_type::node48:  delete static_cast<art_node48*>(n);  break;
+    case art_node_type::node256: delete static_cast<art_node256*>(n); break;
+    }
+  }
+
+  static void destroy_(void *p) noexcept {
+    if (!p || is_leaf_(p)) {
+      return;
+    }
+    art_node *n = static_cast<art_node*>(p);
+    for_each_child_(n, [](uint8_t, void *c) { destroy_(c); return true; });
+    delete_node_(n);
+  }
+
+  // Visits children in key order, stops when callback returns false.
+  template<typename F>
+  static bool for_each_child_(art_node *n, F &&f) {
+    switch (n->type) {
+    case art_node_type::node4: {
+      art_node4 *p = static_cast<art_node4*>(n);
+      for (unsigned i = 0; i < n->size; i++) {
+        if (!f(p->keys[i], p->children[i])) return false;
+      }
+      break;
+    }
+    case art_node_type::node16: {
+      art_node16 *p = static_cast<art_node16*>(n);
+      for (unsigned i = 0; i < n->size; i++) {
+        if (!f(p->keys[i], p->children[i])) return false;
+      }
+      break;
+    }
+    case art_node_type::node48: {
+      art_node48 *p = static_cast<art_node48*>(n);
+      for (unsigned i = 0; i < 256; i++) {
+        if (p->index[i] && !f(static_cast<uint8_t>(i), p->children[p->index[i] - 1])) return false;
+      }
+      break;
+    }
+    case art_node_type::node256: {
+      art_node256 *p = static_cast<art_node256*>(n);
+      for (unsigned i = 0; i < 256; i++) {
+        if (p->children[i] && !f(static_cast<uint8_t>(i), p->children[i])) return false;
+      }
+      break;
+    }
+    }
+    return true;
+  }
+
+  static void *first_child_(art_node *n) noexcept {
+    void *r = nullptr;
+    for_each_child_(n, [&r](uint8_t, void *c) { r = c; return false; });
+    return r;
+  }
+
+  static void *last_child_(art_node *n) noexcept {
+    switch (n->type) {
+    case art_node_type::node4:
+      return static_cast<art_node4*>(n)->children[n->size - 1];
+    case art_node_type::node16:
+      return static_cast<art_node16*>(n)->children[n->size - 1];
+    case art_node_type::node48: {
+      art_node48 *p = static_cast<art_node48*>(n);
+      for (unsigned i = 256; i > 0; i--) {
+        if (p->index[i - 1]) return p->children[p->index[i - 1] - 1];
+      }
+      return nullptr;
+    }
+    case art_node_type::node256: {
+      art_node256 *p = static_cast<art_node256*>(n);
+      for (unsigned i = 256; i > 0; i--) {
+        if (p->children[i - 1]) return p->children[i - 1];
+      }
+      return nullptr;
+    }
+    }
+    return nullptr;
+  }
+
+  static void *minimum_(void *p) noexcept {
+    while (p && !is_leaf_(p)) {
+      art_node *n = static_cast<art_node*>(p);
+      p = n->term ? n->term : first_child_(n);
+    }
+    return p;
+  }
+
+  static void *maximum_(void *p) noexcept {
+    while (p && !is_leaf_(p)) {
+      art_node *n = static_cast<art_node*>(p);
+      p = n->size ? last_child_(n) : n->term;
+    }
+    return p;
+  }
+
+protected:
+  void        *root_ = nullptr;
+  std::size_t  size_ = 0;
+};
+
+
+template<typename DMP>
+class art : public art_base {
+public:
+  using value_type      = typename DMP::container_type;
+  using key_type        = typename DMP::member_type;
+  using pointer         = value_type*;
+  using const_pointer   = const value_type*;
+  using reference       = value_type&;
+  using const_reference = const value_type&;
+  using size_type       = std::size_t;
+
+  static_assert(alignof(value_type) >= 2, "leaf pointers are tagged with the low bit");
+
+
+  art() noexcept : art_base() {}
+
+
+  // Returns false when element with the same key is already in the tree.
+  bool insert(reference o) {
+    art_key<key_type> k(*DMP::to_member(&o));
+    if (insert_(&root_, k, to_leaf_(&o), 0)) {
+      size_++;
+      return true;
+    }
+    return false;
+  }
+
+  pointer find(const key_type &key) const noexcept {
+    art_key<key_type> k(key);
+    void *p = root_;
+    std::size_t depth = 0;
+    while (p) {
+      if (is_leaf_(p)) {
+        return leaf_matches_(p, k) ? to_object_(p) : nullptr;
+      }
+      art_node *n = static_cast<art_node*>(p);
+      if (n->prefix_len) {
+        if (check_prefix_(n, k, depth) != stored_prefix_(n)) {
+          return nullptr;
+        }
+        depth += n->prefix_len;
+      }
+      if (depth >= k.size()) {
+        p = depth == k.size() ? n->term : nullptr;
+        continue;
+      }
+      void **c = find_child_(n, k.data()[depth]);
+      p = c ? *c : nullptr;
+      depth++;
+    }
+    return nullptr;
+  }
+
+  pointer erase(const key_type &key) {
+    art_key<key_type> k(key);
+    pointer r = erase_(&root_, k, 0);
+    if (r) {
+      size_--;
+    }
+    return r;
+  }
+
+  void erase(reference o) {
+    erase(*DMP::to_member(&o));
+  }
+
+
+  pointer minimum() const noexcept {
+    void *p = minimum_(root_);
+    return p ? to_object_(p) : nullptr;
+  }
+
+  pointer maximum() const noexcept {
+    void *p = maximum_(root_);
+    return p ? to_object_(p) : nullptr;
+  }
+
+
+  // Visits elements in key order, stops when callback returns false.
+  template<typename F>
+  void for_each(F &&f) const {
+    if (root_) {
+      walk_(root_, f);
+    }
+  }
+
+  // Visits elements with keys starting with prefix in key order.
+  template<typename F>
+  void for_each_prefix(const uint8_t *prefix, std::size_t len, F &&f) const {
+    void *p = root_;
+    std::size_t depth = 0;
+    while (p) {
+      if (is_leaf_(p)) {
+        art_key<key_type> lk(*DMP::to_member(to_object_(p)));
+        if (lk.size() >= len && std::memcmp(lk.data(), prefix, len) == 0) {
+          f(*to_object_(p));
+        }
+        return;
+      }
+      art_node *n = static_cast<art_node*>(p);
+      if (n->prefix_len) {
+        std::size_t m = std::min(stored_prefix_(n), len - depth);
+        for (std::size_t i = 0; i < m; i++) {
+          if (n->prefix[i] != prefix[depth + i]) {
+            return;
+          }
+        }
+        depth += n->prefix_len;
+      }
+      if (depth >= len) {
+        // only stored part of the compressed paths was compared, all
+        // elements below share the path, so one full key check is enough
+        art_key<key_type> lk(*DMP::to_member(to_object_(minimum_(n))));
+        if (std::memcmp(lk.data(), prefix, len) == 0) {
+          walk_(n, f);
+        }
+        return;
+      }
+      void **c = find_child_(n, prefix[depth]);
+      p = c ? *c : nullptr;
+      depth++;
+    }
+  }
+
+private:
+  static pointer to_object_(const void *p) noexcept {
+    return static_cast<pointer>(from_leaf_(p));
+  }
+
+  static std::size_t stored_prefix_(const art_node *n) noexcept {
+    return n->prefix_len < art_max_prefix ? n->prefix_len : art_max_prefix;
+  }
+
+  static bool leaf_matches_(const void *p, const art_key<key_type> &k) noexcept {
+    art_key<key_type> lk(*DMP::to_member(to_object_(p)));
+    return lk.size() == k.size() && std::memcmp(lk.data(), k.data(), k.size()) == 0;
+  }
+
+  // Optimistic prefix check, compares only stored part of the prefix.
+  static std::size_t check_prefix_(const art_node *n, const art_key<key_type> &k,
+                                   std::size_t depth) noexcept {
+    std::size_t m = stored_prefix_(n);
+    if (depth + m > k.size()) {
+      return 0;
+    }
+    std::size_t i = 0;
+    while (i < m && n->prefix[i] == k.data()[depth + i]) {
+      i++;
+    }
+    return i;
+  }
+
+  // Pessimistic prefix check, returns index of the first mismatching byte.
+  static std::size_t prefix_mismatch_(art_node *n, const art_key<key_type> &k,
+                                      std::size_t depth) noexcept {
+    std::size_t avail = k.size() - depth;
+    std::size_t m = std::min(stored_prefix_(n), avail);
+    std::size_t i = 0;
+    for (; i < m; i++) {
+      if (n->prefix[i] != k.data()[depth + i]) {
+        return i;
+      }
+    }
+    if (n->prefix_len > art_max_prefix) {
+      art_key<key_type> lk(*DMP::to_member(to_object_(minimum_(n))));
+      std::size_t e = std::min<std::size_t>(n->prefix_len, avail);
+      for (; i < e; i++) {
+        if (lk.data()[depth + i] != k.data()[depth + i]) {
+          return i;
+        }
+      }
+    }
+    return i;
+  }
+
+  static void add_leaf_(art_node *n, void **ref, const art_key<key_type> &k,
+                        std::size_t depth, void *leaf) {
+    if (depth == k.size()) {
+      n->term = leaf;
+    } else {
+      add_child_(n, ref, k.data()[depth], leaf);
+    }
+  }
+
+  static bool insert_(void **ref, const art_key<key_type> &k, void *leaf, std::size_t depth) {
+    void *p = *ref;
+    if (!p) {
+      *ref = leaf;
+      return true;
+    }
+
+    if (is_leaf_(p)) {
+      art_key<key_type> lk(*DMP::to_member(to_object_(p)));
+      std::size_t end = std::min(lk.size(), k.size());
+      std::size_t d = depth;
+      while (d < end && lk.data()[d] == k.data()[d]) {
+        d++;
+      }
+      if (d == lk.size() && d == k.size()) {
+        return false;
+      }
+
+      art_node4 *n = new art_node4();
+      n->prefix_len = static_cast<uint32_t>(d - depth);
+      std::memcpy(n->prefix, k.data() + depth, stored_prefix_(n));
+      void *nref = n;
+      add_leaf_(n, &nref, lk, d, p);
+      add_leaf_(n, &nref, k, d, leaf);
+      *ref = nref;
+      return true;
+    }
+
+    art_node *n = static_cast<art_node*>(p);
+    if (n->prefix_len) {
+      std::size_t diff = prefix_mismatch_(n, k, depth);
+      if (diff < n->prefix_len) {
+        art_node4 *s = new art_node4();
+        s->prefix_len = static_cast<uint32_t>(diff);
+        std::memcpy(s->prefix, k.data() + depth, stored_prefix_(s));
+
+        uint8_t edge;
+        if (n->prefix_len <= art_max_prefix) {
+          edge = n->prefix[diff];
+          n->prefix_len -= static_cast<uint32_t>(diff + 1);
+          std::memmove(n->prefix, n->prefix + diff + 1, n->prefix_len);
+        } else {
+          art_key<key_type> lk(*DMP::to_member(to_object_(minimum_(n))));
+          edge = lk.data()[depth + diff];
+          n->prefix_len -= static_cast<uint32_t>(diff + 1);
+          std::memcpy(n->prefix, lk.data() + depth + diff + 1, stored_prefix_(n));
+        }
+
+        void *sref = s;
+        add_child_(s, &sref, edge, n);
+        add_leaf_(s, &sref, k, depth + diff, leaf);
+        *ref = sref;
+        return true;
+      }
+      depth += n->prefix_len;
+    }
+
+    if (depth == k.size()) {
+      if (n->term) {
+        return false;
+      }
+      n->term = leaf;
+      return true;
+    }
+
+    void **c = find_child_(n, k.data()[depth]);
+    if (c) {
+      return insert_(c, k, leaf, depth + 1);
+    }
+    add_child_(n, ref, k.data()[depth], leaf);
+    return true;
+  }
+
+  static pointer erase_(void **ref, const art_key<key_type> &k, std::size_t depth) {
+    void *p = *ref;
+    if (!p) {
+      return nullptr;
+    }
+    if (is_leaf_(p)) {
+      if (!leaf_matches_(p, k)) {
+        return nullptr;
+      }
+      *ref = nullptr;
+      return to_object_(p);
+    }
+
+    art_node *n = static_cast<art_node*>(p);
+    if (n->prefix_len) {
+      if (check_prefix_(n, k, depth) != stored_prefix_(n)) {
+        return nullptr;
+      }
+      depth += n->prefix_len;
+    }
+    if (depth > k.size()) {
+      return nullptr;
+    }
+
+    if (depth == k.size()) {
+      if (!n->term || !leaf_matches_(n->term, k)) {
+        return nullptr;
+      }
+      pointer r = to_object_(n->term);
+      n->term = nullptr;
+      collapse_(ref);
+      return r;
+    }
+
+    uint8_t c = k.data()[depth];
+    void **slot = find_child_(n, c);
+    if (!slot) {
+      return nullptr;
+    }
+    if (is_leaf_(*slot)) {
+      if (!leaf_matches_(*slot, k)) {
+        return nullptr;
+      }
+      pointer r = to_object_(*slot);
+      remove_child_(n, ref, c, slot);
+      collapse_(ref);
+      return r;
+    }
+    return erase_(slot, k, depth + 1);
+  }
+
+  template<typename F>
+  static bool walk_(void *p, F &f) {
+    if (is_leaf_(p)) {
+      return walk_leaf_(f, *to_object_(p));
+    }
+    art_node *n = static_cast<art_node*>(p);
+    if (n->term && !walk_leaf_(f, *to_object_(n->term))) {
+      return false;
+    }
+    return for_each_child_(n, [&f](uint8_t, void *c) { return walk_(c, f); });
+  }
+
+  // Callbacks can return void or bool (false stops iteration).
+  template<typename F>
+  static auto walk_leaf_(F &f, reference o) -> decltype(f(o), bool()) {
+    return call_(f, o, std::is_same<decltype(f(o)), void>());
+  }
+  template<typename F>
+  static bool call_(F &f, reference o, std::true_type) {
+    f(o);
+    return true;
+  }
+  template<typename F>
+  static bool call_(F &f, reference o, std::false_type) {
+    return f(o);
+  }
+};
+
+}
+
+#endif
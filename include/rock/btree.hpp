@@ -0,0 +1,779 @@
+#ifndef _ROCK_BTREE_HPP_
+#define _ROCK_BTREE_HPP_
+
+/*
+  Intrusive B+tree
+
+  Root:
+    root -> Inner | Leaf
+    head -> first Leaf
+    tail -> last Leaf
+
+  Inner node (NodeSize bytes, 64 byte aligned):
+    keys     - separator keys, keys[i] is the smallest key of children[i + 1]
+    children -> Inner | Leaf
+
+  Leaf (NodeSize bytes, 64 byte aligned):
+    prev, next -> Leaf
+    items      -> user objects, key is read through DMP
+
+
+  notes:
+  - nodes are allocated by the tree, user objects are never copied, only
+    separator keys are copied into inner nodes, so keys have to be
+    trivially copyable
+  - inner node is searched with SIMD comparisons for int32_t and int64_t
+    keys ordered by std::less and with branchless binary search otherwise
+  - leaves are linked, so range scans don't go back to inner nodes
+  - bulk_load() builds the tree bottom-up from sorted elements with
+    full leaves
+  - keys have to be unique
+ */
+
+
+#include <cassert>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+
+namespace rock {
+
+/*
+  Inner node search
+
+  Returns number of keys not greater than k, i.e. index of the child
+  which may contain k.
+ */
+template<typename K, typename Compare>
+class btree_search {
+public:
+  static unsigned upper_bound(const K *keys, unsigned n, const K &k, const Compare &less) noexcept {
+    if (!n) {
+      return 0;
+    }
+    const K *base = keys;
+    while (n > 1) {
+      unsigned half = n / 2;
+      base = less(k, base[half]) ? base : base + half;
+      n -= half;
+    }
+    return static_cast<unsigned>(base - keys) + !less(k, *base);
+  }
+};
+
+#ifdef __SSE2__
+template<>
+class btree_search<int32_t, std::less<int32_t>> {
+public:
+  static unsigned upper_bound(const int32_t *keys, unsigned n, int32_t k, const std::less<int32_t>&) noexcept {
+    __m128i v = _mm_set1_epi32(k);
+    unsigned r = 0;
+    unsigned i = 0;
+    for (; i + 4 <= n; i += 4) {
+      __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+      unsigned gt = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(c, v))));
+      r += 4 - __builtin_popcount(gt);
+    }
+    for (; i < n; i++) {
+      r += keys[i] <= k;
+    }
+    return r;
+  }
+};
+#endif
+
+#ifdef __SSE4_2__
+template<>
+class btree_search<int64_t, std::less<int64_t>> {
+public:
+  static unsigned upper_bound(const int64_t *keys, unsigned n, int64_t k, const std::less<int64_t>&) noexcept {
+    __m128i v = _mm_set1_epi64x(k);
+    unsigned r = 0;
+    unsigned i = 0;
+    for (; i + 2 <= n; i += 2) {
+      __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+      unsigned gt = static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(c, v))));
+      r += 2 - __builtin_popcount(gt);
+    }
+    if (i < n) {
+      r += keys[i] <= k;
+    }
+    return r;
+  }
+};
+#endif
+
+
+template<typename DMP,
+         typename Compare = std::less<typename DMP::member_type>,
+         std::size_t NodeSize = 256>
+class btree : private Compare {
+public:
+  using value_type = typename DMP::container_type;
+  using key_type   = typename DMP::member_type;
+  using pointer    = value_type*;
+  using reference  = value_type&;
+  using size_type  = std::size_t;
+
+  static_assert(std::is_trivially_copyable<key_type>::value, "separator keys are copied");
+  static_assert(NodeSize % 64 == 0, "nodes are cache line multiples");
+
+private:
+  struct node {
+    uint16_t size;
+    bool     leaf;
+  };
+
+  struct leaf_header : node {
+    void *prev;
+    void *next;
+  };
+
+  // keys follow the header, children are pointer aligned
+  static constexpr std::size_t inner_header_ =
+    (sizeof(node) + alignof(key_type) - 1) / alignof(key_type) * alignof(key_type);
+  static constexpr std::size_t inner_padding_ =
+    alignof(key_type) < alignof(void*) ? alignof(void*) - alignof(key_type) : 0;
+
+public:
+  static constexpr unsigned leaf_capacity =
+    static_cast<unsigned>((NodeSize - sizeof(leaf_header)) / sizeof(pointer));
+  static constexpr unsigned inner_capacity =
+    static_cast<unsigned>((NodeSize - sizeof(void*) - inner_header_ - inner_padding_) /
+                          (sizeof(key_type) + sizeof(void*)));
+
+  static_assert(leaf_capacity >= 4 && inner_capacity >= 3, "node size is too small for the key");
+
+private:
+  struct leaf_node : node {
+    leaf_node *prev;
+    leaf_node *next;
+    pointer    items[leaf_capacity];
+  };
+
+  struct inner_node : node {
+    key_type  keys[inner_capacity];
+    node     *children[inner_capacity + 1];
+  };
+
+  static_assert(sizeof(leaf_node) <= NodeSize && sizeof(inner_node) <= NodeSize, "node layout");
+
+public:
+  class iterator {
+  public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type        = btree::value_type;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = btree::pointer;
+    using reference         = btree::reference;
+
+    iterator() noexcept {}
+
+    reference operator*() const noexcept { return *leaf_->items[index_]; }
+    pointer operator->() const noexcept { return leaf_->items[index_]; }
+
+    iterator &operator++() noexcept {
+      if (++index_ == leaf_->size) {
+        leaf_ = leaf_->next;
+        index_ = 0;
+      }
+      return *this;
+    }
+
+    iterator operator++(int) noexcept {
+      iterator r = *this;
+      ++*this;
+      return r;
+    }
+
+    iterator &operator--() noexcept {
+      if (!leaf_) {
+        leaf_ = tree_->tail_;
+        index_ = leaf_->size;
+      } else if (!index_) {
+        leaf_ = leaf_->prev;
+        index_ = leaf_->size;
+      }
+      index_--;
+      return *this;
+    }
+
+    iterator operator--(int) noexcept {
+      iterator r = *this;
+      --*this;
+      return r;
+    }
+
+    bool operator==(const iterator &o) const noexcept {
+      return leaf_ == o.leaf_ && index_ == o.index_;
+    }
+    bool operator!=(const iterator &o) const noexcept {
+      return !(*this == o);
+    }
+
+  private:
+    iterator(const btree *t, leaf_node *l, unsigned i) noexcept
+      : tree_(t), leaf_(l), index_(i) {}
+
+    const btree *tree_ = nullptr;
+    leaf_node   *leaf_ = nullptr;
+    unsigned     index_ = 0;
+
+    friend class btree;
+  };
+
+
+  btree() noexcept {}
+  btree(const btree&) = delete;
+  btree &operator=(const btree&) = delete;
+
+  ~btree() {
+    clear();
+  }
+
+
+  bool empty() const noexcept { return !size_; }
+  size_type size() const noexcept { return size_; }
+  unsigned height() const noexcept { return height_; }
+
+  iterator begin() const noexcept { return iterator(this, head_, 0); }
+  iterator end() const noexcept { return iterator(this, nullptr, 0); }
+
+  // Unlinks all elements and frees nodes.
+  void clear() noexcept {
+    if (root_) {
+      destroy_(root_);
+    }
+    root_ = nullptr;
+    head_ = nullptr;
+    tail_ = nullptr;
+    size_ = 0;
+    height_ = 0;
+  }
+
+
+  // Returns false when element with the same key is already in the tree.
+  bool insert(reference o) {
+    const key_type &k = *DMP::to_member(&o);
+    if (!root_) {
+      leaf_node *l = alloc_leaf_();
+      l->items[0] = &o;
+      l->size = 1;
+      root_ = head_ = tail_ = l;
+      height_ = 1;
+      size_ = 1;
+      return true;
+    }
+
+    key_type split_key;
+    node *split = nullptr;
+    if (!insert_(root_, o, k, split_key, split)) {
+      return false;
+    }
+    if (split) {
+      inner_node *r = alloc_inner_();
+      r->size = 1;
+      r->keys[0] = split_key;
+      r->children[0] = root_;
+      r->children[1] = split;
+      root_ = r;
+      height_++;
+    }
+    size_++;
+    return true;
+  }
+
+  pointer find(const key_type &key) const noexcept {
+    if (!root_) {
+      return nullptr;
+    }
+    leaf_node *l = find_leaf_(key);
+    unsigned i = leaf_lower_bound_(l, key);
+    return i < l->size && !less_(key, key_(l->items[i])) ? l->items[i] : nullptr;
+  }
+
+  pointer erase(const key_type &key) noexcept {
+    if (!root_) {
+      return nullptr;
+    }
+    pointer r = erase_(root_, key);
+    if (!r) {
+      return nullptr;
+    }
+    size_--;
+
+    if (root_->leaf && !root_->size) {
+      free_(root_);
+      root_ = head_ = tail_ = nullptr;
+      height_ = 0;
+    } else if (!root_->leaf && !root_->size) {
+      node *c = static_cast<inner_node*>(root_)->children[0];
+      free_(root_);
+      root_ = c;
+      height_--;
+    }
+    return r;
+  }
+
+  void erase(reference o) noexcept {
+    erase(*DMP::to_member(&o));
+  }
+
+
+  // First element with key not less than key.
+  iterator lower_bound(const key_type &key) const noexcept {
+    if (!root_) {
+      return end();
+    }
+    leaf_node *l = find_leaf_(key);
+    unsigned i = leaf_lower_bound_(l, key);
+    if (i == l->size) {
+      return iterator(this, l->next, 0);
+    }
+    return iterator(this, l, i);
+  }
+
+  pointer minimum() const noexcept {
+    return head_ ? head_->items[0] : nullptr;
+  }
+
+  pointer maximum() const noexcept {
+    return tail_ ? tail_->items[tail_->size - 1] : nullptr;
+  }
+
+
+  // Visits elements in key order, stops when callback returns false.
+  template<typename F>
+  void for_each(F &&f) const {
+    for (leaf_node *l = head_; l; l = l->next) {
+      for (unsigned i = 0; i < l->size; i++) {
+        if (!call_(f, *l->items[i])) {
+          return;
+        }
+      }
+    }
+  }
+
+  // Visits elements with keys in [from, to) in key order.
+  template<typename F>
+  void range(const key_type &from, const key_type &to, F &&f) const {
+    if (!root_) {
+      return;
+    }
+    leaf_node *l = find_leaf_(from);
+    unsigned i = leaf_lower_bound_(l, from);
+    for (; l; l = l->next, i = 0) {
+      for (; i < l->size; i++) {
+        if (!less_(key_(l->items[i]), to) || !call_(f, *l->items[i])) {
+          return;
+        }
+      }
+    }
+  }
+
+  /*
+    Builds the tree from elements sorted by key, tree has to be empty.
+    Elements are distributed evenly, leaves are filled up to capacity.
+   */
+  template<typename It>
+  void bulk_load(It first, It last) {
+    assert(empty());
+    std::size_t n = static_cast<std::size_t>(std::distance(first, last));
+    if (!n) {
+      return;
+    }
+
+    // separator of a subtree is its smallest key
+    std::size_t count = (n + leaf_capacity - 1) / leaf_capacity;
+    std::vector<std::pair<node*, key_type>> level;
+    std::vector<node*> inner;
+    level.reserve(count);
+    for (std::size_t c = count; c > 1;) {
+      c = (c + inner_capacity) / (inner_capacity + 1);
+      inner.reserve(inner.capacity() + c);
+    }
+
+    try {
+      leaf_node *prev = nullptr;
+      for (std::size_t c = 0; c < count; c++) {
+        std::size_t take = n / count + (c < n % count);
+        leaf_node *l = alloc_leaf_();
+        l->prev = prev;
+        if (prev) {
+          prev->next = l;
+        } else {
+          head_ = l;
+        }
+        prev = l;
+        for (std::size_t i = 0; i < take; i++, ++first) {
+          reference o = *first;
+          assert(!l->size || less_(key_(l->items[l->size - 1]), *DMP::to_member(&o)));
+          l->items[l->size++] = &o;
+        }
+        level.emplace_back(l, key_(l->items[0]));
+      }
+      tail_ = prev;
+      height_ = 1;
+
+      while (level.size() > 1) {
+        std::size_t children = level.size();
+        count = (children + inner_capacity) / (inner_capacity + 1);
+        auto it = level.begin();
+        for (std::size_t c = 0; c < count; c++) {
+          std::size_t take = children / count + (c < children % count);
+          inner_node *p = alloc_inner_();
+          inner.push_back(p);
+          key_type min = it->second;
+          for (std::size_t i = 0; i < take; i++, ++it) {
+            if (i) {
+              p->keys[p->size++] = it->second;
+            }
+            p->children[i] = it->first;
+          }
+          level[c] = std::make_pair(static_cast<node*>(p), min);
+        }
+        level.resize(count);
+        height_++;
+      }
+    } catch (...) {
+      for (node *p : inner) {
+        free_(p);
+      }
+      for (leaf_node *l = head_; l;) {
+        leaf_node *next = l->next;
+        free_(l);
+        l = next;
+      }
+      head_ = tail_ = nullptr;
+      height_ = 0;
+      throw;
+    }
+    root_ = level[0].first;
+    size_ = n;
+  }
+
+private:
+  static constexpr unsigned leaf_min_ = leaf_capacity / 2;
+  static constexpr unsigned inner_min_ = inner_capacity / 2;
+
+  static void *alloc_() {
+    void *p;
+    if (posix_memalign(&p, 64, NodeSize)) {
+      throw std::bad_alloc();
+    }
+    return p;
+  }
+
+  static leaf_node *alloc_leaf_() {
+    leaf_node *l = static_cast<leaf_node*>(alloc_());
+    l->size = 0;
+    l->leaf = true;
+    l->prev = nullptr;
+    l->next = nullptr;
+    return l;
+  }
+
+  static inner_node *alloc_inner_() {
+    inner_node *n = static_cast<inner_node*>(alloc_());
+    n->size = 0;
+    n->leaf = false;
+    return n;
+  }
+
+  static void free_(node *n) noexcept {
+    std::free(n);
+  }
+
+  static void destroy_(node *n) noexcept {
+    if (!n->leaf) {
+      inner_node *p = static_cast<inner_node*>(n);
+      for (unsigned i = 0; i <= p->size; i++) {
+        destroy_(p->children[i]);
+      }
+    }
+    free_(n);
+  }
+
+  bool less_(const key_type &a, const key_type &b) const noexcept {
+    return Compare::operator()(a, b);
+  }
+
+  static const key_type &key_(const value_type *o) noexcept {
+    return *DMP::to_member(o);
+  }
+
+  unsigned child_index_(inner_node *n, const key_type &key) const noexcept {
+    return btree_search<key_type, Compare>::upper_bound(n->keys, n->size, key, *this);
+  }
+
+  // Branchless lower bound, keys are read through DMP.
+  unsigned leaf_lower_bound_(leaf_node *l, const key_type &key) const noexcept {
+    unsigned n = l->size;
+    if (!n) {
+      return 0;
+    }
+    pointer const *base = l->items;
+    while (n > 1) {
+      unsigned half = n / 2;
+      base = less_(key_(base[half]), key) ? base + half : base;
+      n -= half;
+    }
+    return static_cast<unsigned>(base - l->items) + less_(key_(*base), key);
+  }
+
+  leaf_node *find_leaf_(const key_type &key) const noexcept {
+    node *n = root_;
+    while (!n->leaf) {
+      inner_node *p = static_cast<inner_node*>(n);
+      n = p->children[child_index_(p, key)];
+    }
+    return static_cast<leaf_node*>(n);
+  }
+
+  // Returns false for duplicate key, split is set when n was split.
+  bool insert_(node *n, reference o, const key_type &key, key_type &split_key, node *&split) {
+    if (n->leaf) {
+      leaf_node *l = static_cast<leaf_node*>(n);
+      unsigned i = leaf_lower_bound_(l, key);
+      if (i < l->size && !less_(key, key_(l->items[i]))) {
+        return false;
+      }
+      if (l->size < leaf_capacity) {
+        leaf_insert_(l, i, &o);
+        return true;
+      }
+
+      leaf_node *r = alloc_leaf_();
+      unsigned mid = (leaf_capacity + 1) / 2;
+      r->size = static_cast<uint16_t>(l->size - mid);
+      std::memcpy(r->items, l->items + mid, r->size * sizeof(pointer));
+      l->size = static_cast<uint16_t>(mid);
+      if (i <= mid) {
+        leaf_insert_(l, i, &o);
+      } else {
+        leaf_insert_(r, i - mid, &o);
+      }
+      r->next = l->next;
+      r->prev = l;
+      if (l->next) {
+        l->next->prev = r;
+      } else {
+        tail_ = r;
+      }
+      l->next = r;
+      split_key = key_(r->items[0]);
+      split = r;
+      return true;
+    }
+
+    inner_node *p = static_cast<inner_node*>(n);
+    unsigned i = child_index_(p, key);
+    key_type child_key;
+    node *child_split = nullptr;
+    if (!insert_(p->children[i], o, key, child_key, child_split)) {
+      return false;
+    }
+    if (!child_split) {
+      return true;
+    }
+    if (p->size < inner_capacity) {
+      inner_insert_(p, i, child_key, child_split);
+      return true;
+    }
+
+    // split before inserting, middle key moves to the parent
+    inner_node *r = alloc_inner_();
+    unsigned mid = inner_capacity / 2;
+    r->size = static_cast<uint16_t>(p->size - mid - 1);
+    std::memcpy(r->keys, p->keys + mid + 1, r->size * sizeof(key_type));
+    std::memcpy(r->children, p->children + mid + 1, (r->size + 1) * sizeof(node*));
+    split_key = p->keys[mid];
+    p->size = static_cast<uint16_t>(mid);
+    if (i <= mid) {
+      inner_insert_(p, i, child_key, child_split);
+    } else {
+      inner_insert_(r, i - mid - 1, child_key, child_split);
+    }
+    split = r;
+    return true;
+  }
+
+  static void leaf_insert_(leaf_node *l, unsigned i, pointer o) noexcept {
+    std::memmove(l->items + i + 1, l->items + i, (l->size - i) * sizeof(pointer));
+    l->items[i] = o;
+    l->size++;
+  }
+
+  // Inserts key at i and child at i + 1.
+  static void inner_insert_(inner_node *p, unsigned i, const key_type &key, node *child) noexcept {
+    node **c = p->children;
+    std::memmove(p->keys + i + 1, p->keys + i, (p->size - i) * sizeof(key_type));
+    std::memmove(c + i + 2, c + i + 1, (p->size - i) * sizeof(node*));
+    p->keys[i] = key;
+    c[i + 1] = child;
+    p->size++;
+  }
+
+  // Removes key at i and child at i + 1.
+  static void inner_remove_(inner_node *p, unsigned i) noexcept {
+    node **c = p->children;
+    std::memmove(p->keys + i, p->keys + i + 1, (p->size - i - 1) * sizeof(key_type));
+    std::memmove(c + i + 1, c + i + 2, (p->size - i - 1) * sizeof(node*));
+    p->size--;
+  }
+
+  pointer erase_(node *n, const key_type &key) noexcept {
+    if (n->leaf) {
+      leaf_node *l = static_cast<leaf_node*>(n);
+      unsigned i = leaf_lower_bound_(l, key);
+      if (i == l->size || less_(key, key_(l->items[i]))) {
+        return nullptr;
+      }
+      pointer r = l->items[i];
+      std::memmove(l->items + i, l->items + i + 1, (l->size - i - 1) * sizeof(pointer));
+      l->size--;
+      return r;
+    }
+
+    inner_node *p = static_cast<inner_node*>(n);
+    unsigned i = child_index_(p, key);
+    node *c = p->children[i];
+    pointer r = erase_(c, key);
+    if (r && c->size < (c->leaf ? leaf_min_ : inner_min_)) {
+      rebalance_(p, i);
+    }
+    return r;
+  }
+
+  // Refills child i from a sibling or merges it with one.
+  void rebalance_(inner_node *p, unsigned i) noexcept {
+    node **c = p->children;
+    unsigned min = c[i]->leaf ? leaf_min_ : inner_min_;
+    if (i > 0 && c[i - 1]->size > min) {
+      borrow_left_(p, i);
+    } else if (i < p->size && c[i + 1]->size > min) {
+      borrow_right_(p, i);
+    } else if (i > 0) {
+      merge_(p, i - 1);
+    } else if (i < p->size) {
+      merge_(p, i);
+    }
+  }
+
+  void borrow_left_(inner_node *p, unsigned i) noexcept {
+    node **c = p->children;
+    if (c[i]->leaf) {
+      leaf_node *l = static_cast<leaf_node*>(c[i - 1]);
+      leaf_node *n = static_cast<leaf_node*>(c[i]);
+      leaf_insert_(n, 0, l->items[--l->size]);
+      p->keys[i - 1] = key_(n->items[0]);
+      return;
+    }
+    inner_node *l = static_cast<inner_node*>(c[i - 1]);
+    inner_node *n = static_cast<inner_node*>(c[i]);
+    node **nc = n->children;
+    std::memmove(n->keys + 1, n->keys, n->size * sizeof(key_type));
+    std::memmove(nc + 1, nc, (n->size + 1) * sizeof(node*));
+    n->keys[0] = p->keys[i - 1];
+    nc[0] = l->children[l->size];
+    n->size++;
+    p->keys[i - 1] = l->keys[l->size - 1];
+    l->size--;
+  }
+
+  void borrow_right_(inner_node *p, unsigned i) noexcept {
+    node **c = p->children;
+    if (c[i]->leaf) {
+      leaf_node *n = static_cast<leaf_node*>(c[i]);
+      leaf_node *r = static_cast<leaf_node*>(c[i + 1]);
+      n->items[n->size++] = r->items[0];
+      std::memmove(r->items, r->items + 1, (r->size - 1) * sizeof(pointer));
+      r->size--;
+      p->keys[i] = key_(r->items[0]);
+      return;
+    }
+    inner_node *n = static_cast<inner_node*>(c[i]);
+    inner_node *r = static_cast<inner_node*>(c[i + 1]);
+    node **rc = r->children;
+    n->keys[n->size] = p->keys[i];
+    n->children[n->size + 1] = rc[0];
+    n->size++;
+    p->keys[i] = r->keys[0];
+    std::memmove(r->keys, r->keys + 1, (r->size - 1) * sizeof(key_type));
+    std::memmove(rc, rc + 1, r->size * sizeof(node*));
+    r->size--;
+  }
+
+  // Merges child i + 1 into child i.
+  void merge_(inner_node *p, unsigned i) noexcept {
+    node **c = p->children;
+    if (c[i]->leaf) {
+      leaf_node *l = static_cast<leaf_node*>(c[i]);
+      leaf_node *r = static_cast<leaf_node*>(c[i + 1]);
+      std::memcpy(l->items + l->size, r->items, r->size * sizeof(pointer));
+      l->size = static_cast<uint16_t>(l->size + r->size);
+      l->next = r->next;
+      if (r->next) {
+        r->next->prev = l;
+      } else {
+        tail_ = l;
+      }
+      free_(r);
+    } else {
+      inner_node *l = static_cast<inner_node*>(c[i]);
+      inner_node *r = static_cast<inner_node*>(c[i + 1]);
+      l->keys[l->size] = p->keys[i];
+      std::memcpy(l->keys + l->size + 1, r->keys, r->size * sizeof(key_type));
+      std::memcpy(l->children + l->size + 1, r->children, (r->size + 1) * sizeof(node*));
+      l->size = static_cast<uint16_t>(l->size + r->size + 1);
+      free_(r);
+    }
+    inner_remove_(p, i);
+  }
+
+  // Callbacks can return void or bool (false stops iteration).
+  template<typename F>
+  static bool call_(F &f, reference o) {
+    return call_(f, o, std::is_same<decltype(f(o)), void>());
+  }
+
+  template<typename F>
+  static bool call_(F &f, reference o, std::true_type) {
+    f(o);
+    return true;
+  }
+
+  template<typename F>
+  static bool call_(F &f, reference o, std::false_type) {
+    return f(o);
+  }
+
+  node       *root_ = nullptr;
+  leaf_node  *head_ = nullptr;
+  leaf_node  *tail_ = nullptr;
+  size_type   size_ = 0;
+  unsigned    height_ = 0;
+};
+
+template<typename DMP, typename Compare, std::size_t NodeSize>
+constexpr unsigned btree<DMP, Compare, NodeSize>::leaf_capacity;
+
+template<typename DMP, typename Compare, std::size_t NodeSize>
+constexpr unsigned btree<DMP, Compare, NodeSize>::inner_capacity;
+
+}
+
+#endif
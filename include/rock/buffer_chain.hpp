@@ -0,0 +1,357 @@
+#ifndef _ROCK_BUFFER_CHAIN_HPP_
+#define _ROCK_BUFFER_CHAIN_HPP_
+
+/*
+  Zero-copy buffer chain
+
+  Chain:
+    segments -> Queue of segments
+    size     - total number of bytes
+
+  Segment (refcounted):
+    buffer     -> Buffer
+    data, size - view into the buffer
+    queue_node
+
+  Buffer (refcounted):
+    data, capacity - memory allocated with the header or wrapped user
+                     memory released through a delegate
+
+
+  notes:
+  - chain holds a reference to each linked segment, segment holds a
+    reference to its buffer, so slices of one buffer share the memory
+  - segment has one queue_node, so it is linked in one chain at most,
+    references to a linked segment can be held, but it can be appended
+    to another chain only after pop(), slice() shares the buffer instead
+  - append and prepend of a segment or a whole chain are O(1), slice()
+    creates new segments for the range and never copies data
+  - to_iovec() exports segments from the head for writev/sendmsg,
+    consume() drops written bytes, so a partial write continues from
+    the first unwritten byte
+  - consume() changes a segment in place only when the chain holds the
+    only reference to it, shared segment is replaced by a new one
+  - chain is not thread-safe, buffers and segments can be shared
+    between threads
+ */
+
+
+#include <cassert>
+#include <cerrno>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "delegate.hpp"
+#include "intrusive_ptr.hpp"
+#include "queue.hpp"
+#include "utils.hpp"
+
+
+namespace rock {
+
+class buffer;
+
+struct buffer_deleter {
+  void operator()(buffer *b) const noexcept;
+};
+
+class buffer : public ref_counted<buffer, refcount_atomic, buffer_deleter> {
+public:
+  using release_type = delegate<void (void*)>;
+
+  buffer(const buffer&) = delete;
+  buffer &operator=(const buffer&) = delete;
+
+  // Buffer with capacity bytes allocated together with the header.
+  static intrusive_ptr<buffer> create(std::size_t capacity) {
+    void *p = malloc(sizeof(buffer) + capacity);
+    if (!p) {
+      throw std::bad_alloc();
+    }
+    buffer *b = new (p) buffer(static_cast<char*>(p) + sizeof(buffer), capacity, release_type());
+    return intrusive_ptr<buffer>(b);
+  }
+
+  // Buffer over user memory, release is called with data when the last
+  // reference is dropped. Wrapped memory is not written by the chain.
+  static intrusive_ptr<buffer> wrap(const void *data, std::size_t size,
+                                    release_type release = release_type()) {
+    void *p = malloc(sizeof(buffer));
+    if (!p) {
+      throw std::bad_alloc();
+    }
+    buffer *b = new (p) buffer(const_cast<void*>(data), size, release);
+    return intrusive_ptr<buffer>(b);
+  }
+
+  char *data() const noexcept { return data_; }
+  std::size_t capacity() const noexcept { return capacity_; }
+
+private:
+  buffer(void *data, std::size_t capacity, release_type release) noexcept
+    : data_(static_cast<char*>(data)), capacity_(capacity), release_(release) {}
+
+  ~buffer() {
+    if (release_) {
+      release_(data_);
+    }
+  }
+
+  char         *data_;
+  std::size_t   capacity_;
+  release_type  release_;
+
+  friend struct buffer_deleter;
+};
+
+inline void buffer_deleter::operator()(buffer *b) const noexcept {
+  b->~buffer();
+  free(b);
+}
+
+
+class buffer_segment : public ref_counted<buffer_segment> {
+public:
+  buffer_segment(intrusive_ptr<buffer> b, std::size_t offset, std::size_t size) noexcept
+    : buffer_(std::move(b)), data_(buffer_->data() + offset), size_(size) {
+    assert(offset + size <= buffer_->capacity());
+  }
+
+  // Segment over the whole buffer.
+  explicit buffer_segment(intrusive_ptr<buffer> b) noexcept
+    : buffer_segment(b, 0, b->capacity()) {}
+
+  buffer_segment(const buffer_segment&) = delete;
+  buffer_segment &operator=(const buffer_segment&) = delete;
+
+  const char *data() const noexcept { return data_; }
+  std::size_t size() const noexcept { return size_; }
+  const intrusive_ptr<buffer> &get_buffer() const noexcept { return buffer_; }
+  bool is_linked() const noexcept { return linked_; }
+
+private:
+  intrusive_ptr<buffer>  buffer_;
+  const char            *data_;
+  std::size_t            size_;
+  bool                   linked_ = false;
+  queue_node             node_;
+
+  friend class buffer_chain;
+
+public:
+  using node_dmp = dmp<queue_node buffer_segment::*, &buffer_segment::node_>;
+};
+
+
+class buffer_chain {
+public:
+  typedef queue<buffer_segment::node_dmp>  queue_type;
+  typedef intrusive_ptr<buffer_segment>    segment_ptr;
+  typedef queue_type::const_iterator       const_iterator;
+  typedef std::size_t                      size_type;
+
+  // Number of iovecs write_to() passes to one writev call.
+  static constexpr unsigned iov_batch = 64;
+
+  buffer_chain() noexcept {}
+  buffer_chain(const buffer_chain&) = delete;
+  buffer_chain &operator=(const buffer_chain&) = delete;
+
+  buffer_chain(buffer_chain &&o) noexcept : size_(o.size_), count_(o.count_) {
+    segments_.splice(o.segments_);
+    o.size_ = 0;
+    o.count_ = 0;
+  }
+
+  buffer_chain &operator=(buffer_chain &&o) noexcept {
+    if (this != &o) {
+      clear();
+      append(std::move(o));
+    }
+    return *this;
+  }
+
+  ~buffer_chain() {
+    clear();
+  }
+
+  bool empty() const noexcept { return !size_; }
+  size_type size() const noexcept { return size_; }
+  size_type segments() const noexcept { return count_; }
+
+  const_iterator begin() const noexcept { return segments_.cbegin(); }
+  const_iterator end() const noexcept { return segments_.cend(); }
+
+
+  // Segment must not be linked in any chain.
+  void append(segment_ptr s) noexcept {
+    assert(!s->linked_);
+    s->linked_ = true;
+    size_ += s->size_;
+    count_++;
+    segments_.push(*s.detach());
+  }
+
+  // Segment must not be linked in any chain.
+  void prepend(segment_ptr s) noexcept {
+    assert(!s->linked_);
+    s->linked_ = true;
+    size_ += s->size_;
+    count_++;
+    segments_.push_front(*s.detach());
+  }
+
+  void append(intrusive_ptr<buffer> b, std::size_t offset, std::size_t size) {
+    append(make_intrusive<buffer_segment>(std::move(b), offset, size));
+  }
+
+  void prepend(intrusive_ptr<buffer> b, std::size_t offset, std::size_t size) {
+    prepend(make_intrusive<buffer_segment>(std::move(b), offset, size));
+  }
+
+  // Moves all segments of o to the end of this chain.
+  void append(buffer_chain &&o) noexcept {
+    segments_.splice(o.segments_);
+    size_ += o.size_;
+    count_ += o.count_;
+    o.size_ = 0;
+    o.count_ = 0;
+  }
+
+  segment_ptr pop() noexcept {
+    assert(count_);
+    buffer_segment &s = segments_.pop();
+    s.linked_ = false;
+    size_ -= s.size_;
+    count_--;
+    return segment_ptr(&s, adopt_ref);
+  }
+
+  void clear() noexcept {
+    while (count_) {
+      pop();
+    }
+  }
+
+  // New chain sharing the bytes [offset, offset + size) of this chain.
+  buffer_chain slice(size_type offset, size_type size) const {
+    assert(offset + size <= size_);
+    buffer_chain r;
+    for (const buffer_segment &s: *this) {
+      if (!size) {
+        break;
+      }
+      if (offset >= s.size_) {
+        offset -= s.size_;
+        continue;
+      }
+      std::size_t n = s.size_ - offset < size ? s.size_ - offset : size;
+      r.append(s.buffer_, s.data_ + offset - s.buffer_->data(), n);
+      offset = 0;
+      size -= n;
+    }
+    return r;
+  }
+
+  // Fills up to max iovecs from the head, returns number of filled ones.
+  std::size_t to_iovec(iovec *iov, std::size_t max) const noexcept {
+    std::size_t n = 0;
+    for (auto i = begin(); i != end() && n < max; ++i) {
+      if (!i->size_) {
+        continue;
+      }
+      iov[n].iov_base = const_cast<char*>(i->data_);
+      iov[n].iov_len = i->size_;
+      n++;
+    }
+    return n;
+  }
+
+  // Drops first n bytes, e.g. bytes accepted by writev.
+  void consume(size_type n) {
+    assert(n <= size_);
+    while (n) {
+      buffer_segment &s = segments_.front();
+      if (n >= s.size_) {
+        n -= s.size_;
+        pop();
+        continue;
+      }
+      if (s.use_count() == 1) {
+        s.data_ += n;
+        s.size_ -= n;
+        size_ -= n;
+      } else {
+        segment_ptr old = pop();
+        prepend(old->buffer_, old->data_ + n - old->buffer_->data(), old->size_ - n);
+      }
+      return;
+    }
+  }
+
+  // One writev of up to iov_batch segments, written bytes are consumed.
+  // Returns number of written bytes or -errno.
+  ssize_t write_to(int fd) {
+    iovec iov[iov_batch];
+    std::size_t n = to_iovec(iov, iov_batch);
+    if (!n) {
+      return 0;
+    }
+    ssize_t r = ::writev(fd, iov, static_cast<int>(n));
+    if (r < 0) {
+      return -errno;
+    }
+    consume(static_cast<size_type>(r));
+    return r;
+  }
+
+  // One readv of up to size bytes into new buffers of block bytes, read
+  // bytes are appended. Returns number of read bytes, 0 on end of file
+  // or -errno, -EINVAL when size is 0.
+  ssize_t read_from(int fd, std::size_t size, std::size_t block = 4096) {
+    assert(block);
+    if (!size) {
+      return -EINVAL;
+    }
+    std::size_t blocks = (size + block - 1) / block;
+    if (blocks > iov_batch) {
+      blocks = iov_batch;
+    }
+    intrusive_ptr<buffer> buffers[iov_batch];
+    iovec iov[iov_batch];
+    for (std::size_t i = 0; i < blocks; i++) {
+      std::size_t len = size < block ? size : block;
+      buffers[i] = buffer::create(len);
+      iov[i].iov_base = buffers[i]->data();
+      iov[i].iov_len = len;
+      size -= len;
+    }
+
+    ssize_t r = ::readv(fd, iov, static_cast<int>(blocks));
+    if (r < 0) {
+      return -errno;
+    }
+    std::size_t left = static_cast<std::size_t>(r);
+    for (std::size_t i = 0; i < blocks && left; i++) {
+      std::size_t len = left < iov[i].iov_len ? left : iov[i].iov_len;
+      append(std::move(buffers[i]), 0, len);
+      left -= len;
+    }
+    return r;
+  }
+
+private:
+  queue_type  segments_;
+  size_type   size_ = 0;
+  size_type   count_ = 0;
+};
+
+}
+
+#endif
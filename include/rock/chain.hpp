@@ -13,9 +13,13 @@
 
 */
 
+#include <cassert>
 #include <cinttypes>
 #include <iterator>
 
+#include "stats.hpp"
+#include "trace.hpp"
+
 namespace rock {
 
 class chain_node {
@@ -155,12 +159,12 @@ protected:
   chain_node *node_ = nullptr;
 
   explicit chain_iterator(chain_node *ptr) noexcept : node_(ptr) {}
-  template<typename> friend class chain;
+  template<typename, typename> friend class chain;
 };
 
 
-template<typename DMP>
-class chain : public chain_base {
+template<typename DMP, typename Stats = no_stats>
+class chain : public chain_base, private Stats {
 public:
   typedef typename DMP::container_type value_type;
   typedef value_type                  *pointer;
@@ -190,9 +194,14 @@ public:
 
   void push(reference o) noexcept {
     chain_base::push(*DMP::to_member(&o));
+    Stats::on_push(o);
+    ROCK_PROBE2(chain_push, this, &o);
   }
   reference pop() noexcept {
-    return *DMP::to_container(&chain_base::pop());
+    reference o = *DMP::to_container(&chain_base::pop());
+    Stats::on_pop(o);
+    ROCK_PROBE2(chain_pop, this, &o);
+    return o;
   }
 
   reference front() noexcept {
@@ -205,9 +214,16 @@ public:
 
   void erase(reference o) noexcept {
     DMP::to_member(&o)->unlink();
+    Stats::on_erase(o);
+    ROCK_PROBE2(chain_erase, this, &o);
   }
   void erase(iterator i) noexcept {
-    i.node_->unlink();
+    erase(*i);
+  }
+
+
+  const Stats &stats() const noexcept {
+    return *this;
   }
 };
 
@@ -0,0 +1,156 @@
+#ifndef _ROCK_COALESCER_HPP_
+#define _ROCK_COALESCER_HPP_
+
+/*
+  Batching coalescer
+
+  Coalescer:
+    pending -> Queue of accumulated items
+    sink    - delegate receiving flushed batch
+
+
+  notes:
+  - batch is flushed when it reaches item count or byte size limit, or
+    when the oldest item waited for max_delay
+  - deadline is checked by poll(), owner calls it from its event loop,
+    deadline() returns time to arm a timer for
+  - sink receives queue with the batch and has to pop all of its items
+  - in adaptive mode item count limit starts at min_items, it is doubled
+    when a batch fills up before the deadline (load) and halved when a
+    deadline flushes a batch smaller than half of the limit (idle)
+  - coalescer is not thread-safe
+ */
+
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cinttypes>
+#include <cstddef>
+
+#include "delegate.hpp"
+#include "queue.hpp"
+
+
+namespace rock {
+
+enum class flush_reason {
+  items,
+  bytes,
+  deadline,
+  manual
+};
+
+
+template<typename DMP, typename Clock = std::chrono::steady_clock>
+class coalescer {
+public:
+  typedef typename DMP::container_type value_type;
+  typedef value_type                  &reference;
+  typedef std::size_t                  size_type;
+  typedef queue<DMP>                   batch_type;
+  typedef typename Clock::time_point   time_point;
+  typedef typename Clock::duration     duration;
+  typedef delegate<void (batch_type&, flush_reason)> sink_type;
+
+  struct limits {
+    size_type max_items = 64;
+    size_type max_bytes = SIZE_MAX;
+    duration  max_delay = std::chrono::milliseconds(1);
+    bool      adaptive = false;
+    size_type min_items = 1;
+  };
+
+  coalescer(sink_type sink, const limits &l) noexcept
+    : sink_(sink),
+      limits_(l),
+      target_(l.adaptive ? l.min_items : l.max_items) {
+    assert(limits_.min_items && limits_.min_items <= limits_.max_items);
+  }
+  coalescer(const coalescer&) = delete;
+  coalescer &operator=(const coalescer&) = delete;
+
+
+  bool empty() const noexcept { return !items_; }
+  size_type size() const noexcept { return items_; }
+  size_type bytes() const noexcept { return bytes_; }
+
+  // Current item count limit, changes only in adaptive mode.
+  size_type batch_limit() const noexcept { return target_; }
+
+  // Time when pending batch has to be flushed, valid when not empty.
+  time_point deadline() const noexcept { return deadline_; }
+
+  uint64_t batches() const noexcept { return batches_; }
+  uint64_t flushed_items() const noexcept { return flushed_items_; }
+
+
+  void push(reference o, size_type bytes = 0) {
+    if (!items_) {
+      deadline_ = Clock::now() + limits_.max_delay;
+    }
+    pending_.push(o);
+    items_++;
+    bytes_ += bytes;
+    if (items_ >= target_) {
+      flush_(flush_reason::items);
+    } else if (bytes_ >= limits_.max_bytes) {
+      flush_(flush_reason::bytes);
+    }
+  }
+
+  // Flushes pending batch when its deadline passed, returns true if flushed.
+  bool poll(time_point now = Clock::now()) {
+    if (items_ && now >= deadline_) {
+      flush_(flush_reason::deadline);
+      return true;
+    }
+    return false;
+  }
+
+  void flush() {
+    if (items_) {
+      flush_(flush_reason::manual);
+    }
+  }
+
+private:
+  void flush_(flush_reason reason) {
+    size_type n = items_;
+    if (limits_.adaptive) {
+      adapt_(reason, n);
+    }
+    items_ = 0;
+    bytes_ = 0;
+    batches_++;
+    flushed_items_ += n;
+
+    // sink may push new items while it consumes the batch
+    batch_type batch;
+    batch.splice(pending_);
+    sink_(batch, reason);
+    assert(batch.is_empty());
+  }
+
+  void adapt_(flush_reason reason, size_type n) noexcept {
+    if (reason == flush_reason::items) {
+      target_ = std::min(target_ * 2, limits_.max_items);
+    } else if (reason == flush_reason::deadline && n * 2 < target_) {
+      target_ = std::max(target_ / 2, limits_.min_items);
+    }
+  }
+
+  sink_type   sink_;
+  limits      limits_;
+  size_type   target_;
+  size_type   items_ = 0;
+  size_type   bytes_ = 0;
+  time_point  deadline_;
+  uint64_t    batches_ = 0;
+  uint64_t    flushed_items_ = 0;
+  batch_type  pending_;
+};
+
+}
+
+#endif
@@ -0,0 +1,672 @@
+#ifndef _ROCK_CORO_HPP_
+#define _ROCK_CORO_HPP_
+
+/*
+  Coroutine primitives (C++20)
+
+  Scheduler:
+    ready -> Queue of operations
+
+  Operation (lives inside of an awaiter in the coroutine frame):
+    queue_node - scheduler ready queue
+    handle     - suspended coroutine
+
+  Waiter : Operation
+    list_node  - waiter list of a mutex, semaphore, event or channel
+
+
+  notes:
+  - waiters never allocate, they are linked intrusively from awaiters
+  - cancellation unlinks waiter from its list with O(1) complexity
+  - woken waiters are resumed through the scheduler queue, so releasing
+    a primitive never resumes another coroutine recursively
+  - primitives are bound to a single-threaded scheduler and are not
+    thread-safe
+  - task can be destroyed while it is suspended in a primitive, waiter
+    destructor unlinks it from the waiter list and the cancellation slot,
+    operation destructor removes it from the ready queue (O(n), rare)
+ */
+
+
+#if !defined(__cpp_impl_coroutine)
+#error "rock/coro.hpp requires C++20 coroutines"
+#endif
+
+#include <cassert>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include "list.hpp"
+#include "queue.hpp"
+#include "utils.hpp"
+
+
+namespace rock {
+namespace coro {
+
+class scheduler;
+
+class operation {
+public:
+  operation() noexcept {}
+  operation(const operation&) = delete;
+  operation &operator=(const operation&) = delete;
+
+  inline ~operation();
+
+protected:
+  std::coroutine_handle<> handle_;
+
+private:
+  scheduler  *posted_ = nullptr;
+  queue_node  queue_node_;
+
+public:
+  using queue_node_dmp = dmp<queue_node operation::*, &operation::queue_node_>;
+
+  friend class scheduler;
+};
+
+
+class scheduler {
+public:
+  class schedule_awaiter : public operation {
+  public:
+    explicit schedule_awaiter(scheduler &s) noexcept : scheduler_(s) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) noexcept {
+      handle_ = h;
+      scheduler_.post(*this);
+    }
+    void await_resume() const noexcept {}
+
+  private:
+    scheduler &scheduler_;
+  };
+
+  scheduler() noexcept {}
+  scheduler(const scheduler&) = delete;
+  scheduler &operator=(const scheduler&) = delete;
+
+  bool is_empty() const noexcept { return ready_.is_empty(); }
+
+  void post(operation &op) noexcept {
+    assert(!op.posted_);
+    op.posted_ = this;
+    ready_.push(op);
+  }
+
+  // Suspends current coroutine and puts it at the end of the ready queue.
+  schedule_awaiter schedule() noexcept {
+    return schedule_awaiter(*this);
+  }
+
+  bool run_one() {
+    if (ready_.is_empty()) {
+      return false;
+    }
+    operation &op = ready_.pop();
+    op.posted_ = nullptr;
+    op.handle_.resume();
+    return true;
+  }
+
+  std::size_t run() {
+    std::size_t n = 0;
+    while (run_one()) {
+      n++;
+    }
+    return n;
+  }
+
+private:
+  // Operation destroyed before it was resumed.
+  void remove_(operation &op) noexcept {
+    queue<operation::queue_node_dmp> rest;
+    while (!ready_.is_empty()) {
+      operation &o = ready_.pop();
+      if (&o != &op) {
+        rest.push(o);
+      }
+    }
+    ready_.splice(rest);
+  }
+
+  queue<operation::queue_node_dmp> ready_;
+
+  friend class operation;
+};
+
+operation::~operation() {
+  if (posted_) {
+    posted_->remove_(*this);
+  }
+}
+
+
+class waiter;
+
+/*
+  Cancellation slot
+
+  Waiter registers itself in the slot while it is suspended, cancel()
+  unlinks it and resumes the coroutine with a failed result.
+ */
+class cancellation {
+public:
+  cancellation() noexcept {}
+  cancellation(const cancellation&) = delete;
+  cancellation &operator=(const cancellation&) = delete;
+
+  bool is_waiting() const noexcept { return waiter_ != nullptr; }
+
+  inline void cancel() noexcept;
+
+private:
+  waiter *waiter_ = nullptr;
+
+  friend class waiter;
+};
+
+
+class waiter : public operation {
+public:
+  // Waiter of a destroyed coroutine frame leaves its list.
+  ~waiter() {
+    if (linked_) {
+      list_node_.unlink();
+      if (cancellation_) {
+        cancellation_->waiter_ = nullptr;
+      }
+    }
+  }
+
+  bool is_cancelled() const noexcept { return cancelled_; }
+
+protected:
+  waiter(scheduler &s, cancellation *c) noexcept
+    : scheduler_(s),
+      cancellation_(c) {}
+
+  template<typename List>
+  void suspend_(List &waiters, std::coroutine_handle<> h) noexcept {
+    handle_ = h;
+    waiters.push_back(*this);
+    linked_ = true;
+    if (cancellation_) {
+      assert(!cancellation_->waiter_);
+      cancellation_->waiter_ = this;
+    }
+  }
+
+  // Waiter should be already unlinked from its list.
+  void wake_() noexcept {
+    linked_ = false;
+    if (cancellation_) {
+      cancellation_->waiter_ = nullptr;
+    }
+    scheduler_.post(*this);
+  }
+
+  void cancel_() noexcept {
+    list_node_.unlink();
+    cancelled_ = true;
+    wake_();
+  }
+
+  scheduler    &scheduler_;
+  cancellation *cancellation_;
+  bool          cancelled_ = false;
+
+private:
+  // list pop leaves stale links, so membership is tracked here
+  bool      linked_ = false;
+  list_node list_node_;
+
+public:
+  using list_node_dmp = dmp<list_node waiter::*, &waiter::list_node_>;
+
+  friend class cancellation;
+};
+
+using waiter_list = list<waiter::list_node_dmp>;
+
+void cancellation::cancel() noexcept {
+  if (waiter_) {
+    waiter_->cancel_();
+  }
+}
+
+
+/*
+  Mutex with FIFO hand-off of ownership
+ */
+class async_mutex {
+public:
+  class lock_awaiter : public waiter {
+  public:
+    lock_awaiter(async_mutex &m, cancellation *c) noexcept
+      : waiter(m.scheduler_, c),
+        mutex_(m) {}
+
+    bool await_ready() noexcept { return mutex_.try_lock(); }
+    void await_suspend(std::coroutine_handle<> h) noexcept {
+      suspend_(mutex_.waiters_, h);
+    }
+    // Returns false when waiting was cancelled.
+    bool await_resume() const noexcept { return !cancelled_; }
+
+  private:
+    async_mutex &mutex_;
+
+    friend class async_mutex;
+  };
+
+  explicit async_mutex(scheduler &s) noexcept : scheduler_(s) {}
+  async_mutex(const async_mutex&) = delete;
+  async_mutex &operator=(const async_mutex&) = delete;
+
+  bool is_locked() const noexcept { return locked_; }
+
+  bool try_lock() noexcept {
+    if (locked_) {
+      return false;
+    }
+    locked_ = true;
+    return true;
+  }
+
+  lock_awaiter lock(cancellation *c = nullptr) noexcept {
+    return lock_awaiter(*this, c);
+  }
+
+  void unlock() noexcept {
+    assert(locked_);
+    if (waiters_.empty()) {
+      locked_ = false;
+    } else {
+      static_cast<lock_awaiter&>(waiters_.pop_front()).wake_();
+    }
+  }
+
+private:
+  scheduler   &scheduler_;
+  waiter_list  waiters_;
+  bool         locked_ = false;
+};
+
+
+/*
+  Counting semaphore, permits are handed to waiters in FIFO order
+ */
+class async_semaphore {
+public:
+  class acquire_awaiter : public waiter {
+  public:
+    acquire_awaiter(async_semaphore &s, cancellation *c) noexcept
+      : waiter(s.scheduler_, c),
+        semaphore_(s) {}
+
+    bool await_ready() noexcept { return semaphore_.try_acquire(); }
+    void await_suspend(std::coroutine_handle<> h) noexcept {
+      suspend_(semaphore_.waiters_, h);
+    }
+    bool await_resume() const noexcept { return !cancelled_; }
+
+  private:
+    async_semaphore &semaphore_;
+
+    friend class async_semaphore;
+  };
+
+  async_semaphore(scheduler &s, std::size_t count) noexcept
+    : scheduler_(s),
+      count_(count) {}
+  async_semaphore(const async_semaphore&) = delete;
+  async_semaphore &operator=(const async_semaphore&) = delete;
+
+  std::size_t count() const noexcept { return count_; }
+
+  bool try_acquire() noexcept {
+    if (!count_) {
+      return false;
+    }
+    count_--;
+    return true;
+  }
+
+  acquire_awaiter acquire(cancellation *c = nullptr) noexcept {
+    return acquire_awaiter(*this, c);
+  }
+
+  void release() noexcept {
+    if (waiters_.empty()) {
+      count_++;
+    } else {
+      static_cast<acquire_awaiter&>(waiters_.pop_front()).wake_();
+    }
+  }
+
+private:
+  scheduler   &scheduler_;
+  waiter_list  waiters_;
+  std::size_t  count_;
+};
+
+
+/*
+  Manual-reset event
+ */
+class async_event {
+public:
+  class wait_awaiter : public waiter {
+  public:
+    wait_awaiter(async_event &e, cancellation *c) noexcept
+      : waiter(e.scheduler_, c),
+        event_(e) {}
+
+    bool await_ready() const noexcept { return event_.is_set(); }
+    void await_suspend(std::coroutine_handle<> h) noexcept {
+      suspend_(event_.waiters_, h);
+    }
+    bool await_resume() const noexcept { return !cancelled_; }
+
+  private:
+    async_event &event_;
+
+    friend class async_event;
+  };
+
+  explicit async_event(scheduler &s) noexcept : scheduler_(s) {}
+  async_event(const async_event&) = delete;
+  async_event &operator=(const async_event&) = delete;
+
+  bool is_set() const noexcept { return set_; }
+
+  wait_awaiter wait(cancellation *c = nullptr) noexcept {
+    return wait_awaiter(*this, c);
+  }
+
+  void set() noexcept {
+    set_ = true;
+    while (!waiters_.empty()) {
+      static_cast<wait_awaiter&>(waiters_.pop_front()).wake_();
+    }
+  }
+
+  void reset() noexcept {
+    set_ = false;
+  }
+
+private:
+  scheduler   &scheduler_;
+  waiter_list  waiters_;
+  bool         set_ = false;
+};
+
+
+/*
+  Unbuffered channel
+
+  Values are moved directly from the sender awaiter into the receiver
+  awaiter, so no buffer is needed.
+ */
+template<typename T>
+class channel {
+public:
+  class send_awaiter : public waiter {
+  public:
+    send_awaiter(channel &ch, T &&value, cancellation *c)
+      : waiter(ch.scheduler_, c),
+        channel_(ch),
+        value_(std::move(value)) {}
+
+    bool await_ready() {
+      if (channel_.closed_) {
+        return true;
+      }
+      if (channel_.receivers_.empty()) {
+        return false;
+      }
+      auto &r = static_cast<receive_awaiter&>(channel_.receivers_.pop_front());
+      r.value_.emplace(std::move(value_));
+      r.wake_();
+      sent_ = true;
+      return true;
+    }
+    void await_suspend(std::coroutine_handle<> h) noexcept {
+      suspend_(channel_.senders_, h);
+    }
+    // Returns false when channel was closed or sending was cancelled.
+    bool await_resume() const noexcept { return sent_; }
+
+  private:
+    channel &channel_;
+    T        value_;
+    bool     sent_ = false;
+
+    friend class channel;
+    friend class receive_awaiter;
+  };
+
+  class receive_awaiter : public waiter {
+  public:
+    receive_awaiter(channel &ch, cancellation *c) noexcept
+      : waiter(ch.scheduler_, c),
+        channel_(ch) {}
+
+    bool await_ready() {
+      if (!channel_.senders_.empty()) {
+        auto &s = static_cast<send_awaiter&>(channel_.senders_.pop_front());
+        value_.emplace(std::move(s.value_));
+        s.sent_ = true;
+        s.wake_();
+        return true;
+      }
+      return channel_.closed_;
+    }
+    void await_suspend(std::coroutine_handle<> h) noexcept {
+      suspend_(channel_.receivers_, h);
+    }
+    // Returns empty value when channel was closed or receiving was cancelled.
+    std::optional<T> await_resume() {
+      return std::move(value_);
+    }
+
+  private:
+    channel          &channel_;
+    std::optional<T>  value_;
+
+    friend class channel;
+    friend class send_awaiter;
+  };
+
+  explicit channel(scheduler &s) noexcept : scheduler_(s) {}
+  channel(const channel&) = delete;
+  channel &operator=(const channel&) = delete;
+
+  bool is_closed() const noexcept { return closed_; }
+
+  send_awaiter send(T value, cancellation *c = nullptr) {
+    return send_awaiter(*this, std::move(value), c);
+  }
+
+  receive_awaiter receive(cancellation *c = nullptr) noexcept {
+    return receive_awaiter(*this, c);
+  }
+
+  // Wakes all suspended senders and receivers with a failed result.
+  void close() noexcept {
+    closed_ = true;
+    while (!senders_.empty()) {
+      static_cast<send_awaiter&>(senders_.pop_front()).wake_();
+    }
+    while (!receivers_.empty()) {
+      static_cast<receive_awaiter&>(receivers_.pop_front()).wake_();
+    }
+  }
+
+private:
+  scheduler   &scheduler_;
+  waiter_list  senders_;
+  waiter_list  receivers_;
+  bool         closed_ = false;
+};
+
+
+/*
+  Lazily started task
+
+  Awaiting coroutine is resumed from the final suspend point with
+  symmetric transfer, so chains of tasks don't grow the stack.
+ */
+template<typename T = void>
+class task;
+
+class task_promise_base {
+public:
+  class final_awaiter {
+  public:
+    bool await_ready() const noexcept { return false; }
+    template<typename P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+      std::coroutine_handle<> c = h.promise().continuation_;
+      return c ? c : std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  final_awaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() const noexcept { std::terminate(); }
+
+  std::coroutine_handle<> continuation_;
+};
+
+template<typename T>
+class task_promise : public task_promise_base {
+public:
+  task<T> get_return_object() noexcept;
+
+  template<typename U>
+  void return_value(U &&v) {
+    value_.emplace(std::forward<U>(v));
+  }
+
+  T result() {
+    return std::move(*value_);
+  }
+
+private:
+  std::optional<T> value_;
+};
+
+template<>
+class task_promise<void> : public task_promise_base {
+public:
+  task<void> get_return_object() noexcept;
+
+  void return_void() const noexcept {}
+  void result() const noexcept {}
+};
+
+template<typename T>
+class task {
+public:
+  using promise_type = task_promise<T>;
+  using handle_type  = std::coroutine_handle<promise_type>;
+
+  class awaiter {
+  public:
+    explicit awaiter(handle_type h) noexcept : handle_(h) {
+      assert(handle_);
+    }
+
+    bool await_ready() const noexcept { return handle_.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept {
+      handle_.promise().continuation_ = h;
+      return handle_;
+    }
+    T await_resume() {
+      return handle_.promise().result();
+    }
+
+  private:
+    handle_type handle_;
+  };
+
+  task() noexcept {}
+  explicit task(handle_type h) noexcept : handle_(h) {}
+  task(const task&) = delete;
+  task &operator=(const task&) = delete;
+  task(task &&o) noexcept : handle_(std::exchange(o.handle_, nullptr)) {}
+  task &operator=(task &&o) noexcept {
+    if (this != &o) {
+      if (handle_) {
+        handle_.destroy();
+      }
+      handle_ = std::exchange(o.handle_, nullptr);
+    }
+    return *this;
+  }
+  ~task() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  bool is_done() const noexcept { return !handle_ || handle_.done(); }
+
+  // Task must not be empty or moved-from.
+  awaiter operator co_await() && noexcept {
+    assert(handle_);
+    return awaiter(handle_);
+  }
+
+private:
+  handle_type handle_;
+};
+
+template<typename T>
+task<T> task_promise<T>::get_return_object() noexcept {
+  return task<T>(task<T>::handle_type::from_promise(*this));
+}
+
+inline task<void> task_promise<void>::get_return_object() noexcept {
+  return task<void>(task<void>::handle_type::from_promise(*this));
+}
+
+
+namespace detail {
+
+class detached_task {
+public:
+  class promise_type {
+  public:
+    detached_task get_return_object() const noexcept { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+inline detached_task run_detached(scheduler &s, task<void> t) {
+  co_await s.schedule();
+  co_await std::move(t);
+}
+
+}
+
+// Starts task on the scheduler, task frame is destroyed when it completes.
+inline void spawn(scheduler &s, task<void> t) {
+  detail::run_detached(s, std::move(t));
+}
+
+}
+}
+
+#endif
@@ -3,19 +3,41 @@
 
 /*
   Lightweight delegates (size of 2 pointers)
+
+  Layout:
+    object   -> bound object
+    function -> R (*)(void *object, Args ...)
+
+
+  notes:
+  - compile-time bound delegates call a static stub generated for the
+    target, the target itself can be inlined into the stub
+  - runtime binding of member function pointers relies on GCC bound
+    member function extension and isn't available on other compilers
  */
 
+
+#include <utility>
+
+#include "trace.hpp"
+
+
 namespace rock {
 
+template<typename F>
 class delegate_base {
 public:
-  delegate_base() {}
+  constexpr delegate_base() noexcept {}
+
+  constexpr delegate_base(void *object, F function) noexcept
+    : object_(object),
+      function_(function) {}
 
-  delegate_base(const delegate_base &r)
+  constexpr delegate_base(const delegate_base &r) noexcept
     : object_(r.object_),
       function_(r.function_) {}
 
-  delegate_base &operator=(const delegate_base &r) {
+  delegate_base &operator=(const delegate_base &r) noexcept {
     object_ = r.object_;
     function_ = r.function_;
     return *this;
@@ -27,10 +49,16 @@ public:
     function_ = nullptr;
   }
 
-  explicit operator bool() const noexcept {
-    return function_ == nullptr;
+  constexpr explicit operator bool() const noexcept {
+    return function_ != nullptr;
   }
 
+  bool operator==(const delegate_base &r) const noexcept {
+    return is_equal(r);
+  }
+  bool operator!=(const delegate_base &r) const noexcept {
+    return !is_equal(r);
+  }
   bool operator<(const delegate_base &r) const noexcept {
     return is_less(r);
   }
@@ -50,10 +78,8 @@ protected:
   }
 
 protected:
-  typedef void (*generic_function)(void *);
-
-  void             *object_   = nullptr;
-  generic_function  function_ = nullptr;
+  void *object_   = nullptr;
+  F     function_ = nullptr;
 };
 
 
@@ -61,23 +87,115 @@ template<typename R, typename ... Args>
 class delegate;
 
 template<typename R, typename ... Args>
-class delegate<R (Args ...)> : public delegate_base {
+class delegate<R (Args ...)> : public delegate_base<R (*)(void*, Args ...)> {
+  using base = delegate_base<R (*)(void*, Args ...)>;
+
 public:
+  using stub_type = R (*)(void*, Args ...);
+
+  constexpr delegate() noexcept : base() {}
+  constexpr delegate(void *object, stub_type stub) noexcept : base(object, stub) {}
+
+
+  /*
+    Compile-time binding
+
+      auto d = delegate<void (int)>::from<Item, &Item::on_event>(&item);
+      auto f = delegate<void (int)>::from<&on_event>();
+   */
+  template<typename X, R (X::*M)(Args ...)>
+  static constexpr delegate from(X *object) noexcept {
+    return delegate(object, &method_stub_<X, M>);
+  }
+
+  template<typename X, R (X::*M)(Args ...) const>
+  static constexpr delegate from(const X *object) noexcept {
+    return delegate(const_cast<X*>(object), &const_method_stub_<X, M>);
+  }
+
+  template<R (*F)(Args ...)>
+  static constexpr delegate from() noexcept {
+    return delegate(nullptr, &function_stub_<F>);
+  }
+
+  template<typename X, R (X::*M)(Args ...)>
+  void bind(X *object) noexcept {
+    *this = from<X, M>(object);
+  }
+
+  template<typename X, R (X::*M)(Args ...) const>
+  void bind(const X *object) noexcept {
+    *this = from<X, M>(object);
+  }
+
+  template<R (*F)(Args ...)>
+  void bind() noexcept {
+    *this = from<F>();
+  }
+
+#if __cplusplus >= 201703L
+  template<auto M, typename X>
+  static constexpr delegate from(X *object) noexcept {
+    return from_<M>(object, M);
+  }
+
+  template<auto M, typename X>
+  void bind(X *object) noexcept {
+    *this = from<M>(object);
+  }
+#endif
+
+
+#if defined(__GNUC__) && !defined(__clang__)
+  /*
+    Runtime binding through GCC bound member function extension
+   */
   template<typename X, typename Y>
   void bind(Y *object, R (X::*method)(Args ...)) noexcept {
-    object_ = reinterpret_cast<void*>(object);
-    function_ = reinterpret_cast<generic_function>(object->*method);
+    this->object_ = reinterpret_cast<void*>(object);
+    this->function_ = reinterpret_cast<stub_type>(object->*method);
   }
 
   template<typename X, typename Y>
   void bind(Y *object, X function) noexcept {
-    object_ = reinterpret_cast<void*>(object);
-    function_ = reinterpret_cast<generic_function>(function);
+    this->object_ = reinterpret_cast<void*>(object);
+    this->function_ = reinterpret_cast<stub_type>(function);
   }
+#endif
+
 
-  R operator()(Args ... args) const noexcept {
-    return reinterpret_cast<__attribute__(thiscall) R (*)(void*, Args...)>(function)(object_, args...);
+  R operator()(Args ... args) const {
+    ROCK_PROBE2(delegate_call, this->object_, reinterpret_cast<void*>(this->function_));
+    return this->function_(this->object_, std::forward<Args>(args)...);
   }
+
+private:
+  template<typename X, R (X::*M)(Args ...)>
+  static R method_stub_(void *object, Args ... args) {
+    return (static_cast<X*>(object)->*M)(std::forward<Args>(args)...);
+  }
+
+  template<typename X, R (X::*M)(Args ...) const>
+  static R const_method_stub_(void *object, Args ... args) {
+    return (static_cast<const X*>(object)->*M)(std::forward<Args>(args)...);
+  }
+
+  template<R (*F)(Args ...)>
+  static R function_stub_(void*, Args ... args) {
+    return F(std::forward<Args>(args)...);
+  }
+
+#if __cplusplus >= 201703L
+  template<auto M, typename X, typename Y>
+  static constexpr delegate from_(X *object, R (Y::*)(Args ...)) noexcept {
+    return from<Y, M>(object);
+  }
+
+  template<auto M, typename X, typename Y>
+  static constexpr delegate from_(const X *object, R (Y::*)(Args ...) const) noexcept {
+    return from<Y, M>(object);
+  }
+#endif
 };
 
 }
@@ -0,0 +1,165 @@
+#ifndef _ROCK_DRR_HPP_
+#define _ROCK_DRR_HPP_
+
+/*
+  Deficit round-robin scheduler (Shreedhar, Varghese)
+
+  Scheduler:
+    active -> List of flows with packets
+
+  Flow:
+    packets     -> Queue of packets
+    quantum     - credit added on each round (bytes or packets)
+    deficit     - credit left in the current round
+    active_node - link in active list
+
+
+  notes:
+  - flows and packets are owned by the user, scheduler never allocates
+  - flow is in the active list while it has packets, head flow sends
+    while its head packet fits into the deficit, then it moves to the
+    end of the list and gets another quantum
+  - packet cost is read through SizeDMP, without SizeDMP each packet
+    costs 1 and the scheduler is a weighted round-robin over packets
+  - dequeue is O(1) when quantum is not smaller than the largest packet,
+    flows with different quanta share the link in the quanta ratio
+  - deficit is reset when the flow runs out of packets, so idle flows
+    don't accumulate credit
+ */
+
+
+#include <cassert>
+#include <cinttypes>
+#include <type_traits>
+
+#include "list.hpp"
+#include "queue.hpp"
+#include "utils.hpp"
+
+
+namespace rock {
+
+template<typename DMP>
+class drr_flow {
+public:
+  typedef queue<DMP> queue_type;
+
+  explicit drr_flow(uint32_t quantum = 1500) noexcept : quantum_(quantum) {
+    assert(quantum_);
+  }
+  drr_flow(const drr_flow&) = delete;
+  drr_flow &operator=(const drr_flow&) = delete;
+
+  bool active() const noexcept { return !packets_.is_empty(); }
+  uint32_t quantum() const noexcept { return quantum_; }
+  uint64_t deficit() const noexcept { return deficit_; }
+  uint64_t backlog() const noexcept { return backlog_; }
+  std::size_t size() const noexcept { return size_; }
+
+  // New quantum is used from the next round.
+  void set_quantum(uint32_t quantum) noexcept {
+    assert(quantum);
+    quantum_ = quantum;
+  }
+
+private:
+  queue_type  packets_;
+  uint64_t    deficit_ = 0;
+  uint64_t    backlog_ = 0;
+  std::size_t size_ = 0;
+  uint32_t    quantum_;
+  list_node   active_node_;
+
+  template<typename, typename> friend class drr_scheduler;
+
+public:
+  using active_node_dmp = dmp<list_node drr_flow::*, &drr_flow::active_node_>;
+};
+
+
+template<typename DMP, typename SizeDMP = void>
+class drr_scheduler {
+public:
+  typedef typename DMP::container_type value_type;
+  typedef value_type                  *pointer;
+  typedef value_type                  &reference;
+  typedef drr_flow<DMP>                flow_type;
+  typedef std::size_t                  size_type;
+
+  drr_scheduler() noexcept {}
+  drr_scheduler(const drr_scheduler&) = delete;
+  drr_scheduler &operator=(const drr_scheduler&) = delete;
+
+  bool empty() const noexcept { return active_.empty(); }
+  size_type size() const noexcept { return size_; }
+
+
+  void enqueue(flow_type &f, reference p) noexcept {
+    if (f.packets_.is_empty()) {
+      f.deficit_ = f.quantum_;
+      active_.push_back(f);
+    }
+    f.packets_.push(p);
+    f.backlog_ += cost_(p);
+    f.size_++;
+    size_++;
+  }
+
+  // Next packet in fair order, nullptr when all flows are empty.
+  pointer dequeue() noexcept {
+    while (!active_.empty()) {
+      flow_type &f = active_.front();
+      reference p = f.packets_.front();
+      uint64_t c = cost_(p);
+      if (c > f.deficit_) {
+        f.deficit_ += f.quantum_;
+        active_.pop_front();
+        active_.push_back(f);
+        continue;
+      }
+
+      f.packets_.pop();
+      f.deficit_ -= c;
+      f.backlog_ -= c;
+      f.size_--;
+      size_--;
+      if (f.packets_.is_empty()) {
+        f.deficit_ = 0;
+        active_.pop_front();
+      }
+      return &p;
+    }
+    return nullptr;
+  }
+
+  // Unlinks flow and moves its packets to out.
+  void remove(flow_type &f, queue<DMP> &out) noexcept {
+    if (f.packets_.is_empty()) {
+      return;
+    }
+    size_ -= f.size_;
+    active_.erase(f);
+    out.splice(f.packets_);
+    f.deficit_ = 0;
+    f.backlog_ = 0;
+    f.size_ = 0;
+  }
+
+private:
+  template<typename S = SizeDMP>
+  static uint64_t cost_(reference p, typename std::enable_if<!std::is_void<S>::value>::type* = nullptr) noexcept {
+    return static_cast<uint64_t>(*S::to_member(&p));
+  }
+
+  template<typename S = SizeDMP>
+  static uint64_t cost_(reference, typename std::enable_if<std::is_void<S>::value>::type* = nullptr) noexcept {
+    return 1;
+  }
+
+  list<typename flow_type::active_node_dmp> active_;
+  size_type                                 size_ = 0;
+};
+
+}
+
+#endif
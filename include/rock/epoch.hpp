@@ -0,0 +1,215 @@
+#ifndef _ROCK_EPOCH_HPP_
+#define _ROCK_EPOCH_HPP_
+
+/*
+  Epoch-based reclamation
+
+  Global:
+    epoch   - global epoch counter
+    records -> Stack of thread records (never freed, reused)
+    retired -> Stack of retired nodes
+
+  Thread record:
+    active  - epoch observed when the thread entered, 0 when outside
+    nesting - depth of nested guards
+
+
+  notes:
+  - readers enter a critical section with epoch_guard, objects unlinked
+    from shared structures are retired and reclaimed when every thread
+    left the critical sections it could have observed them in
+  - node retired in epoch e is reclaimed when global epoch reaches e + 2,
+    epoch advances only when all active threads observed it
+  - retired node is reclaimed through its delegate by whichever thread
+    runs epoch::reclaim(), retire() runs it after every 64 retired nodes
+  - thread pinned forever blocks reclamation, not the readers or writers
+ */
+
+
+#include <atomic>
+#include <cassert>
+#include <cinttypes>
+#include <cstddef>
+
+#include "delegate.hpp"
+
+
+namespace rock {
+
+class epoch_node {
+public:
+  using reclaim_type = delegate<void (epoch_node&)>;
+
+  epoch_node() noexcept {}
+  epoch_node(const epoch_node&) = delete;
+  epoch_node &operator=(const epoch_node&) = delete;
+
+private:
+  epoch_node   *next_ = nullptr;
+  uint64_t      epoch_ = 0;
+  reclaim_type  reclaim_;
+
+  friend class epoch;
+};
+
+
+class epoch {
+public:
+  static constexpr unsigned reclaim_batch = 64;
+
+  static void enter() noexcept {
+    record *r = current_();
+    if (!r->nesting++) {
+      r->active.store(global_().load(std::memory_order_relaxed), std::memory_order_relaxed);
+      // publish the epoch before reading shared pointers
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+  }
+
+  static void leave() noexcept {
+    record *r = current_();
+    assert(r->nesting);
+    if (!--r->nesting) {
+      r->active.store(0, std::memory_order_release);
+    }
+  }
+
+  static bool pinned() noexcept {
+    return current_()->nesting;
+  }
+
+  // Node has to be unlinked already, reclaim is called after grace period.
+  static void retire(epoch_node &n, epoch_node::reclaim_type reclaim) noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    n.epoch_ = global_().load(std::memory_order_relaxed);
+    n.reclaim_ = reclaim;
+    push_(&n, &n);
+
+    record *r = current_();
+    if (++r->retired >= reclaim_batch) {
+      r->retired = 0;
+      epoch::reclaim();
+    }
+  }
+
+  // Advances global epoch when possible and reclaims nodes whose grace
+  // period ended, returns number of reclaimed nodes.
+  static std::size_t reclaim() noexcept {
+    try_advance_();
+    uint64_t safe = global_().load(std::memory_order_acquire);
+
+    epoch_node *n = retired_().exchange(nullptr, std::memory_order_acquire);
+    epoch_node *keep = nullptr;
+    epoch_node *keep_last = nullptr;
+    std::size_t count = 0;
+    while (n) {
+      epoch_node *next = n->next_;
+      if (n->epoch_ + 2 <= safe) {
+        n->reclaim_(*n);
+        count++;
+      } else {
+        n->next_ = keep;
+        keep = n;
+        if (!keep_last) {
+          keep_last = n;
+        }
+      }
+      n = next;
+    }
+    if (keep) {
+      push_(keep, keep_last);
+    }
+    return count;
+  }
+
+private:
+  struct record {
+    std::atomic<uint64_t>  active{0};
+    std::atomic<bool>      used{true};
+    uint32_t               nesting = 0;
+    unsigned               retired = 0;
+    record                *next = nullptr;
+  };
+
+  struct record_holder {
+    record *r = acquire_();
+
+    ~record_holder() {
+      assert(!r->nesting);
+      r->used.store(false, std::memory_order_release);
+    }
+  };
+
+  static std::atomic<uint64_t> &global_() noexcept {
+    static std::atomic<uint64_t> e{1};
+    return e;
+  }
+
+  static std::atomic<record*> &records_() noexcept {
+    static std::atomic<record*> head{nullptr};
+    return head;
+  }
+
+  static std::atomic<epoch_node*> &retired_() noexcept {
+    static std::atomic<epoch_node*> head{nullptr};
+    return head;
+  }
+
+  static record *current_() noexcept {
+    static thread_local record_holder h;
+    return h.r;
+  }
+
+  // Reuses record of an exited thread or adds a new one.
+  static record *acquire_() {
+    for (record *r = records_().load(std::memory_order_acquire); r; r = r->next) {
+      bool used = false;
+      if (!r->used.load(std::memory_order_relaxed) &&
+          r->used.compare_exchange_strong(used, true, std::memory_order_acquire)) {
+        return r;
+      }
+    }
+
+    record *r = new record;
+    r->next = records_().load(std::memory_order_relaxed);
+    while (!records_().compare_exchange_weak(r->next, r, std::memory_order_release)) {
+    }
+    return r;
+  }
+
+  static bool try_advance_() noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t e = global_().load(std::memory_order_relaxed);
+    for (record *r = records_().load(std::memory_order_acquire); r; r = r->next) {
+      uint64_t a = r->active.load(std::memory_order_acquire);
+      if (a && a != e) {
+        return false;
+      }
+    }
+    return global_().compare_exchange_strong(e, e + 1, std::memory_order_acq_rel);
+  }
+
+  static void push_(epoch_node *first, epoch_node *last) noexcept {
+    epoch_node *head = retired_().load(std::memory_order_relaxed);
+    do {
+      last->next_ = head;
+    } while (!retired_().compare_exchange_weak(head, first, std::memory_order_release));
+  }
+};
+
+
+class epoch_guard {
+public:
+  epoch_guard() noexcept {
+    epoch::enter();
+  }
+  ~epoch_guard() {
+    epoch::leave();
+  }
+  epoch_guard(const epoch_guard&) = delete;
+  epoch_guard &operator=(const epoch_guard&) = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef _ROCK_INPLACE_FUNCTION_HPP_
+#define _ROCK_INPLACE_FUNCTION_HPP_
+
+/*
+  Owning callable with fixed inline storage
+
+  Layout:
+    invoke -> R (*)(void*, Args&&...)
+    manage -> void (*)(void *dst, void *src)
+    storage[Capacity]
+
+
+  notes:
+  - callables never allocate, callable that doesn't fit into Capacity
+    is rejected at compile time
+  - move-only, so callables with move-only captures are supported
+  - calling goes through a single indirect call
+ */
+
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace rock {
+
+template<typename Signature, std::size_t Capacity = 4 * sizeof(void*)>
+class inplace_function;
+
+template<typename R, typename ... Args, std::size_t Capacity>
+class inplace_function<R (Args ...), Capacity> {
+  using invoke_function = R (*)(void*, Args&& ...);
+  // moves src into dst and destroys src, destroys src when dst is null
+  using manage_function = void (*)(void*, void*);
+
+  template<typename F>
+  using is_self = std::is_same<typename std::decay<F>::type, inplace_function>;
+
+public:
+  static constexpr std::size_t capacity = Capacity;
+
+  inplace_function() noexcept {}
+  inplace_function(std::nullptr_t) noexcept {}
+
+  template<typename F, typename = typename std::enable_if<!is_self<F>::value>::type>
+  inplace_function(F &&f) noexcept {
+    using T = typename std::decay<F>::type;
+    static_assert(sizeof(T) <= Capacity, "callable is too large for inplace_function storage");
+    static_assert(alignof(T) <= alignof(storage_type), "callable is overaligned for inplace_function storage");
+    static_assert(std::is_nothrow_move_constructible<T>::value, "callable should be nothrow move constructible");
+
+    new (&storage_) T(std::forward<F>(f));
+    invoke_ = &invoke_impl_<T>;
+    manage_ = &manage_impl_<T>;
+  }
+
+  inplace_function(const inplace_function&) = delete;
+  inplace_function &operator=(const inplace_function&) = delete;
+
+  inplace_function(inplace_function &&o) noexcept {
+    move_(o);
+  }
+
+  inplace_function &operator=(inplace_function &&o) noexcept {
+    if (this != &o) {
+      clear();
+      move_(o);
+    }
+    return *this;
+  }
+
+  inplace_function &operator=(std::nullptr_t) noexcept {
+    clear();
+    return *this;
+  }
+
+  template<typename F, typename = typename std::enable_if<!is_self<F>::value>::type>
+  inplace_function &operator=(F &&f) noexcept {
+    return *this = inplace_function(std::forward<F>(f));
+  }
+
+  ~inplace_function() {
+    clear();
+  }
+
+
+  void clear() noexcept {
+    if (manage_) {
+      manage_(nullptr, &storage_);
+      invoke_ = nullptr;
+      manage_ = nullptr;
+    }
+  }
+
+  explicit operator bool() const noexcept {
+    return invoke_ != nullptr;
+  }
+
+  R operator()(Args ... args) const {
+    assert(invoke_);
+    return invoke_(const_cast<storage_type*>(&storage_), std::forward<Args>(args)...);
+  }
+
+private:
+  using storage_type = typename std::aligned_storage<Capacity>::type;
+
+  template<typename T>
+  static R invoke_impl_(void *s, Args&& ... args) {
+    return (*static_cast<T*>(s))(std::forward<Args>(args)...);
+  }
+
+  template<typename T>
+  static void manage_impl_(void *dst, void *src) noexcept {
+    T *o = static_cast<T*>(src);
+    if (dst) {
+      new (dst) T(std::move(*o));
+    }
+    o->~T();
+  }
+
+  void move_(inplace_function &o) noexcept {
+    if (o.manage_) {
+      o.manage_(&storage_, &o.storage_);
+      invoke_ = o.invoke_;
+      manage_ = o.manage_;
+      o.invoke_ = nullptr;
+      o.manage_ = nullptr;
+    }
+  }
+
+  invoke_function invoke_ = nullptr;
+  manage_function manage_ = nullptr;
+  storage_type    storage_;
+};
+
+}
+
+#endif
@@ -0,0 +1,457 @@
+#ifndef _ROCK_INTERVAL_TREE_HPP_
+#define _ROCK_INTERVAL_TREE_HPP_
+
+/*
+  Intrusive interval tree
+
+  Root:
+    root -> Node
+
+  Node:
+    parent -> Node (itself when not linked)
+    left   -> Node
+    right  -> Node
+    red    - red-black tree color
+    max    - maximum end of intervals in the subtree
+
+
+  notes:
+  - red-black tree ordered by interval begin, augmented with subtree
+    maximum end, begin and end are read through DMPs
+  - intervals are half-open [begin, end), empty intervals are never
+    returned by queries
+  - equal intervals are allowed
+ */
+
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+
+namespace rock {
+
+template<typename K>
+class interval_node {
+public:
+  interval_node() noexcept {}
+  interval_node(const interval_node&) = delete;
+  interval_node &operator=(const interval_node&) = delete;
+
+  bool is_linked() const noexcept {
+    return parent_ != this;
+  }
+
+private:
+  interval_node *parent_ = this;
+  interval_node *left_   = nullptr;
+  interval_node *right_  = nullptr;
+  bool           red_    = false;
+  K              max_    = K();
+
+  template<typename, typename, typename> friend class interval_tree;
+};
+
+
+template<typename NodeDMP, typename BeginDMP, typename EndDMP>
+class interval_tree {
+public:
+  using value_type      = typename NodeDMP::container_type;
+  using key_type        = typename BeginDMP::member_type;
+  using node_type       = interval_node<key_type>;
+  using pointer         = value_type*;
+  using const_pointer   = const value_type*;
+  using reference       = value_type&;
+  using const_reference = const value_type&;
+  using size_type       = std::size_t;
+
+  static_assert(std::is_same<typename NodeDMP::member_type, node_type>::value,
+                "node has to be interval_node of the key type");
+  static_assert(std::is_same<typename EndDMP::member_type, key_type>::value,
+                "begin and end have to be of the same type");
+
+
+  interval_tree() noexcept {}
+  interval_tree(const interval_tree&) = delete;
+  interval_tree &operator=(const interval_tree&) = delete;
+
+  bool empty() const noexcept { return !root_; }
+  size_type size() const noexcept { return size_; }
+
+  void clear() noexcept {
+    clear_(root_);
+    root_ = nullptr;
+    size_ = 0;
+  }
+
+
+  void insert(reference o) noexcept {
+    node_type *n = NodeDMP::to_member(&o);
+    assert(!n->is_linked());
+    const key_type &b = begin_(n);
+    n->left_ = n->right_ = nullptr;
+    n->max_ = end_(n);
+    n->red_ = true;
+
+    node_type *p = nullptr;
+    node_type **link = &root_;
+    while (*link) {
+      p = *link;
+      if (p->max_ < n->max_) {
+        p->max_ = n->max_;
+      }
+      link = b < begin_(p) ? &p->left_ : &p->right_;
+    }
+    n->parent_ = p;
+    *link = n;
+    size_++;
+    insert_fixup_(n);
+  }
+
+  void erase(reference o) noexcept {
+    node_type *z = NodeDMP::to_member(&o);
+    assert(z->is_linked());
+    node_type *x;
+    node_type *xp;
+    bool red = z->red_;
+
+    if (!z->left_) {
+      x = z->right_;
+      xp = z->parent_;
+      transplant_(z, x);
+    } else if (!z->right_) {
+      x = z->left_;
+      xp = z->parent_;
+      transplant_(z, x);
+    } else {
+      node_type *y = z->right_;
+      while (y->left_) {
+        y = y->left_;
+      }
+      red = y->red_;
+      x = y->right_;
+      if (y->parent_ == z) {
+        xp = y;
+      } else {
+        xp = y->parent_;
+        transplant_(y, x);
+        y->right_ = z->right_;
+        y->right_->parent_ = y;
+      }
+      transplant_(z, y);
+      y->left_ = z->left_;
+      y->left_->parent_ = y;
+      y->red_ = z->red_;
+    }
+
+    // rotations below rely on correct maximums of the children
+    for (node_type *n = xp; n; n = n->parent_) {
+      update_(n);
+    }
+    if (!red) {
+      erase_fixup_(x, xp);
+    }
+
+    z->parent_ = z;
+    z->left_ = z->right_ = nullptr;
+    size_--;
+  }
+
+
+  /*
+    Visits intervals overlapping [lo, hi) in begin order, callbacks can
+    return void or bool (false stops iteration).
+   */
+  template<typename F>
+  void overlap(const key_type &lo, const key_type &hi, F &&f) const {
+    overlap_(root_, lo, hi, f);
+  }
+
+  // Visits intervals containing point p in begin order.
+  template<typename F>
+  void stab(const key_type &p, F &&f) const {
+    stab_(root_, p, f);
+  }
+
+  // Returns interval with the lowest begin overlapping [lo, hi).
+  pointer find_overlap(const key_type &lo, const key_type &hi) const noexcept {
+    pointer r = nullptr;
+    auto first = [&r](reference o) { r = &o; return false; };
+    overlap_(root_, lo, hi, first);
+    return r;
+  }
+
+  bool overlaps(const key_type &lo, const key_type &hi) const noexcept {
+    return find_overlap(lo, hi) != nullptr;
+  }
+
+  // Visits all intervals in begin order.
+  template<typename F>
+  void for_each(F &&f) const {
+    walk_(root_, f);
+  }
+
+  pointer minimum() const noexcept {
+    node_type *n = root_;
+    if (!n) {
+      return nullptr;
+    }
+    while (n->left_) {
+      n = n->left_;
+    }
+    return NodeDMP::to_container(n);
+  }
+
+  // Maximum end of all intervals.
+  const key_type &max_end() const noexcept {
+    assert(root_);
+    return root_->max_;
+  }
+
+private:
+  static const key_type &begin_(const node_type *n) noexcept {
+    return *BeginDMP::to_member(NodeDMP::to_container(n));
+  }
+
+  static const key_type &end_(const node_type *n) noexcept {
+    return *EndDMP::to_member(NodeDMP::to_container(n));
+  }
+
+  static void update_(node_type *n) noexcept {
+    const key_type *m = &end_(n);
+    if (n->left_ && *m < n->left_->max_) {
+      m = &n->left_->max_;
+    }
+    if (n->right_ && *m < n->right_->max_) {
+      m = &n->right_->max_;
+    }
+    n->max_ = *m;
+  }
+
+  static bool is_red_(const node_type *n) noexcept {
+    return n && n->red_;
+  }
+
+  void replace_child_(node_type *p, node_type *old, node_type *n) noexcept {
+    if (!p) {
+      root_ = n;
+    } else if (p->left_ == old) {
+      p->left_ = n;
+    } else {
+      p->right_ = n;
+    }
+  }
+
+  void transplant_(node_type *u, node_type *v) noexcept {
+    replace_child_(u->parent_, u, v);
+    if (v) {
+      v->parent_ = u->parent_;
+    }
+  }
+
+  void rotate_left_(node_type *x) noexcept {
+    node_type *y = x->right_;
+    x->right_ = y->left_;
+    if (y->left_) {
+      y->left_->parent_ = x;
+    }
+    y->parent_ = x->parent_;
+    replace_child_(x->parent_, x, y);
+    y->left_ = x;
+    x->parent_ = y;
+    y->max_ = x->max_;
+    update_(x);
+  }
+
+  void rotate_right_(node_type *x) noexcept {
+    node_type *y = x->left_;
+    x->left_ = y->right_;
+    if (y->right_) {
+      y->right_->parent_ = x;
+    }
+    y->parent_ = x->parent_;
+    replace_child_(x->parent_, x, y);
+    y->right_ = x;
+    x->parent_ = y;
+    y->max_ = x->max_;
+    update_(x);
+  }
+
+  void insert_fixup_(node_type *n) noexcept {
+    while (is_red_(n->parent_)) {
+      node_type *p = n->parent_;
+      node_type *g = p->parent_;
+      if (p == g->left_) {
+        node_type *u = g->right_;
+        if (is_red_(u)) {
+          p->red_ = u->red_ = false;
+          g->red_ = true;
+          n = g;
+          continue;
+        }
+        if (n == p->right_) {
+          rotate_left_(p);
+          n = p;
+          p = n->parent_;
+        }
+        p->red_ = false;
+        g->red_ = true;
+        rotate_right_(g);
+      } else {
+        node_type *u = g->left_;
+        if (is_red_(u)) {
+          p->red_ = u->red_ = false;
+          g->red_ = true;
+          n = g;
+          continue;
+        }
+        if (n == p->left_) {
+          rotate_right_(p);
+          n = p;
+          p = n->parent_;
+        }
+        p->red_ = false;
+        g->red_ = true;
+        rotate_left_(g);
+      }
+    }
+    root_->red_ = false;
+  }
+
+  void erase_fixup_(node_type *x, node_type *p) noexcept {
+    while (x != root_ && !is_red_(x)) {
+      if (x == p->left_) {
+        node_type *w = p->right_;
+        if (w->red_) {
+          w->red_ = false;
+          p->red_ = true;
+          rotate_left_(p);
+          w = p->right_;
+        }
+        if (!is_red_(w->left_) && !is_red_(w->right_)) {
+          w->red_ = true;
+          x = p;
+          p = x->parent_;
+          continue;
+        }
+        if (!is_red_(w->right_)) {
+          w->left_->red_ = false;
+          w->red_ = true;
+          rotate_right_(w);
+          w = p->right_;
+        }
+        w->red_ = p->red_;
+        p->red_ = false;
+        w->right_->red_ = false;
+        rotate_left_(p);
+      } else {
+        node_type *w = p->left_;
+        if (w->red_) {
+          w->red_ = false;
+          p->red_ = true;
+          rotate_right_(p);
+          w = p->left_;
+        }
+        if (!is_red_(w->left_) && !is_red_(w->right_)) {
+          w->red_ = true;
+          x = p;
+          p = x->parent_;
+          continue;
+        }
+        if (!is_red_(w->left_)) {
+          w->right_->red_ = false;
+          w->red_ = true;
+          rotate_left_(w);
+          w = p->left_;
+        }
+        w->red_ = p->red_;
+        p->red_ = false;
+        w->left_->red_ = false;
+        rotate_right_(p);
+      }
+      x = root_;
+    }
+    if (x) {
+      x->red_ = false;
+    }
+  }
+
+  static void clear_(node_type *n) noexcept {
+    while (n) {
+      clear_(n->left_);
+      node_type *r = n->right_;
+      n->parent_ = n;
+      n->left_ = n->right_ = nullptr;
+      n = r;
+    }
+  }
+
+  template<typename F>
+  static bool overlap_(node_type *n, const key_type &lo, const key_type &hi, F &f) {
+    // subtree has no interval ending after lo
+    if (!n || !(lo < n->max_)) {
+      return true;
+    }
+    if (!overlap_(n->left_, lo, hi, f)) {
+      return false;
+    }
+    // node and its right subtree begin at or after hi
+    if (!(begin_(n) < hi)) {
+      return true;
+    }
+    if (lo < end_(n) && begin_(n) < end_(n) && !visit_(f, n)) {
+      return false;
+    }
+    return overlap_(n->right_, lo, hi, f);
+  }
+
+  template<typename F>
+  static bool stab_(node_type *n, const key_type &p, F &f) {
+    if (!n || !(p < n->max_)) {
+      return true;
+    }
+    if (!stab_(n->left_, p, f)) {
+      return false;
+    }
+    if (p < begin_(n)) {
+      return true;
+    }
+    if (p < end_(n) && !visit_(f, n)) {
+      return false;
+    }
+    return stab_(n->right_, p, f);
+  }
+
+  template<typename F>
+  static bool walk_(node_type *n, F &f) {
+    while (n) {
+      if (!walk_(n->left_, f) || !visit_(f, n)) {
+        return false;
+      }
+      n = n->right_;
+    }
+    return true;
+  }
+
+  template<typename F>
+  static bool visit_(F &f, node_type *n) {
+    reference o = *NodeDMP::to_container(n);
+    return call_(f, o, std::is_same<decltype(f(o)), void>());
+  }
+  template<typename F>
+  static bool call_(F &f, reference o, std::true_type) {
+    f(o);
+    return true;
+  }
+  template<typename F>
+  static bool call_(F &f, reference o, std::false_type) {
+    return f(o);
+  }
+
+  node_type *root_ = nullptr;
+  size_type  size_ = 0;
+};
+
+}
+
+#endif
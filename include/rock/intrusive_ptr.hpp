@@ -0,0 +1,444 @@
+#ifndef _ROCK_INTRUSIVE_PTR_HPP_
+#define _ROCK_INTRUSIVE_PTR_HPP_
+
+/*
+  Intrusive reference counting
+
+  Object:
+    ref_counted<Derived, Policy> base with the counter
+
+  Policies:
+    refcount_plain  - non-atomic counter, single thread only
+    refcount_atomic - atomic counter
+    refcount_biased - owner thread (creator) uses non-atomic counter,
+                      other threads use atomic counter, owner merges
+                      the counters in refcount_biased::collect()
+
+
+  notes:
+  - counter lives in the object, so there is no separate control block
+  - owning<Container> wraps an intrusive container, container holds a
+    reference to each linked element, pop returns intrusive_ptr
+ */
+
+
+#include <atomic>
+#include <cassert>
+#include <cinttypes>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "utils.hpp"
+
+
+namespace rock {
+
+class refcount_plain {
+public:
+  void add_ref() noexcept {
+    count_++;
+  }
+
+  // Returns true when the last reference was released.
+  bool release() noexcept {
+    assert(count_);
+    return !--count_;
+  }
+
+  uint32_t use_count() const noexcept { return count_; }
+
+private:
+  uint32_t count_ = 0;
+};
+
+
+class refcount_atomic {
+public:
+  void add_ref() noexcept {
+    count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  bool release() noexcept {
+    if (count_.fetch_sub(1, std::memory_order_release) == 1) {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return true;
+    }
+    return false;
+  }
+
+  uint32_t use_count() const noexcept {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<uint32_t> count_{0};
+};
+
+
+/*
+  Biased reference counting
+
+  Owner thread counts its references in a plain counter, other threads
+  in the shared atomic counter (count << 2 | queued | merged). A
+  reference taken by the owner can be released by another thread, so
+  shared count can go negative, such object is queued to the owner,
+  which merges its counter into the shared one in collect(). Owner
+  merges the counter by itself when its count drops to zero.
+
+  notes:
+  - owner has to call collect() periodically, otherwise objects released
+    by other threads are freed only when the owner thread exits
+  - owner record of an exited thread lives until its last object is
+    freed, objects released after the owner exited are merged by the
+    releasing thread
+ */
+class refcount_biased {
+public:
+  refcount_biased() noexcept : owner_(current_owner_()) {
+    owner_->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  refcount_biased(const refcount_biased&) = delete;
+  refcount_biased &operator=(const refcount_biased&) = delete;
+
+  ~refcount_biased() {
+    owner_->unref();
+  }
+
+  void add_ref() noexcept {
+    if (is_owner_() && !merged_) {
+      biased_++;
+    } else {
+      shared_.fetch_add(one_, std::memory_order_relaxed);
+    }
+  }
+
+  bool release() noexcept {
+    if (is_owner_() && !merged_) {
+      assert(biased_);
+      if (--biased_) {
+        return false;
+      }
+      merged_ = true;
+      int32_t v = shared_.fetch_or(merged_bit_, std::memory_order_acq_rel);
+      // queued object is freed by collect()
+      return !(v & queued_bit_) && !(v >> 2);
+    }
+
+    int32_t v = shared_.fetch_sub(one_, std::memory_order_acq_rel) - one_;
+    if (v & merged_bit_) {
+      return !(v & queued_bit_) && !(v >> 2);
+    }
+    if ((v >> 2) < 0) {
+      queue_();
+    }
+    return false;
+  }
+
+  // Approximate, owner part is exact only on the owner thread.
+  uint32_t use_count() const noexcept {
+    return static_cast<uint32_t>(static_cast<int32_t>(biased_) + (shared_.load(std::memory_order_relaxed) >> 2));
+  }
+
+  // Merges objects queued to the current thread, returns their number.
+  static std::size_t collect() noexcept {
+    refcount_biased *c = current_owner_()->queue.exchange(nullptr, std::memory_order_acquire);
+    return merge_list_(c);
+  }
+
+  void set_dispose(void (*dispose)(refcount_biased*)) noexcept {
+    dispose_ = dispose;
+  }
+
+private:
+  static constexpr int32_t merged_bit_ = 1;
+  static constexpr int32_t queued_bit_ = 2;
+  static constexpr int32_t one_ = 4;
+
+  struct owner {
+    std::atomic<refcount_biased*> queue{nullptr};
+    std::atomic<uint32_t>         refs{1};
+
+    void unref() noexcept {
+      if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete this;
+      }
+    }
+  };
+
+  // Marks owner queue of exited thread, objects are merged by the pushing thread.
+  static refcount_biased *closed_() noexcept {
+    return reinterpret_cast<refcount_biased*>(uintptr_t(1));
+  }
+
+  struct owner_holder {
+    owner *o = new owner;
+
+    ~owner_holder() {
+      merge_list_(o->queue.exchange(closed_(), std::memory_order_acq_rel));
+      o->unref();
+    }
+  };
+
+  static owner *current_owner_() noexcept {
+    static thread_local owner_holder h;
+    return h.o;
+  }
+
+  bool is_owner_() const noexcept {
+    return owner_ == current_owner_();
+  }
+
+  void queue_() noexcept {
+    int32_t v = shared_.load(std::memory_order_relaxed);
+    while (!(v & (merged_bit_ | queued_bit_)) && (v >> 2) < 0) {
+      if (shared_.compare_exchange_weak(v, v | queued_bit_, std::memory_order_acq_rel)) {
+        refcount_biased *head = owner_->queue.load(std::memory_order_relaxed);
+        do {
+          if (head == closed_()) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            merge_();
+            return;
+          }
+          next_ = head;
+        } while (!owner_->queue.compare_exchange_weak(head, this, std::memory_order_acq_rel));
+        return;
+      }
+    }
+  }
+
+  static std::size_t merge_list_(refcount_biased *c) noexcept {
+    std::size_t n = 0;
+    while (c && c != closed_()) {
+      refcount_biased *next = c->next_;
+      c->merge_();
+      c = next;
+      n++;
+    }
+    return n;
+  }
+
+  // Moves owner count into shared counter and clears queued bit.
+  void merge_() noexcept {
+    int32_t delta = static_cast<int32_t>(biased_) * one_ + (merged_ ? 0 : merged_bit_) - queued_bit_;
+    biased_ = 0;
+    merged_ = true;
+    int32_t v = shared_.fetch_add(delta, std::memory_order_acq_rel) + delta;
+    if (!(v >> 2)) {
+      dispose_(this);
+    }
+  }
+
+  owner                  *owner_;
+  uint32_t                biased_ = 0;
+  bool                    merged_ = false;
+  std::atomic<int32_t>    shared_{0};
+  refcount_biased        *next_ = nullptr;
+  void                  (*dispose_)(refcount_biased*) = nullptr;
+};
+
+
+template<typename Derived, typename Policy = refcount_atomic,
+         typename Deleter = std::default_delete<Derived>>
+class ref_counted {
+public:
+  ref_counted() noexcept {
+    init_(counter_);
+  }
+  ref_counted(const ref_counted&) noexcept {
+    init_(counter_);
+  }
+  ref_counted &operator=(const ref_counted&) noexcept { return *this; }
+
+  void add_ref() const noexcept {
+    counter_.add_ref();
+  }
+
+  void release() const noexcept {
+    if (counter_.release()) {
+      Deleter()(static_cast<Derived*>(const_cast<ref_counted*>(this)));
+    }
+  }
+
+  uint32_t use_count() const noexcept {
+    return counter_.use_count();
+  }
+
+protected:
+  ~ref_counted() {}
+
+private:
+  template<typename P>
+  static void init_(P&) noexcept {}
+
+  // biased counter frees objects merged by collect()
+  static void init_(refcount_biased &c) noexcept {
+    c.set_dispose(&dispose_);
+  }
+
+  static void dispose_(refcount_biased *c) noexcept {
+    const ref_counted *r = container_of(const_cast<const Policy*>(c), &ref_counted::counter_);
+    Deleter()(static_cast<Derived*>(const_cast<ref_counted*>(r)));
+  }
+
+  mutable Policy counter_;
+};
+
+
+struct adopt_ref_t {};
+constexpr adopt_ref_t adopt_ref{};
+
+template<typename T>
+class intrusive_ptr {
+public:
+  typedef T element_type;
+
+  constexpr intrusive_ptr() noexcept {}
+  constexpr intrusive_ptr(std::nullptr_t) noexcept {}
+
+  explicit intrusive_ptr(T *p) noexcept : ptr_(p) {
+    if (ptr_) {
+      ptr_->add_ref();
+    }
+  }
+
+  // Takes over reference already owned by the caller.
+  intrusive_ptr(T *p, adopt_ref_t) noexcept : ptr_(p) {}
+
+  intrusive_ptr(const intrusive_ptr &o) noexcept : intrusive_ptr(o.ptr_) {}
+
+  intrusive_ptr(intrusive_ptr &&o) noexcept : ptr_(o.ptr_) {
+    o.ptr_ = nullptr;
+  }
+
+  template<typename U>
+  intrusive_ptr(const intrusive_ptr<U> &o) noexcept : intrusive_ptr(o.get()) {}
+
+  template<typename U>
+  intrusive_ptr(intrusive_ptr<U> &&o) noexcept : ptr_(o.detach()) {}
+
+  ~intrusive_ptr() {
+    if (ptr_) {
+      ptr_->release();
+    }
+  }
+
+  intrusive_ptr &operator=(const intrusive_ptr &o) noexcept {
+    intrusive_ptr(o).swap(*this);
+    return *this;
+  }
+
+  intrusive_ptr &operator=(intrusive_ptr &&o) noexcept {
+    intrusive_ptr(std::move(o)).swap(*this);
+    return *this;
+  }
+
+  void reset() noexcept {
+    intrusive_ptr().swap(*this);
+  }
+
+  void reset(T *p) noexcept {
+    intrusive_ptr(p).swap(*this);
+  }
+
+  // Returns pointer without releasing the reference.
+  T *detach() noexcept {
+    T *p = ptr_;
+    ptr_ = nullptr;
+    return p;
+  }
+
+  void swap(intrusive_ptr &o) noexcept {
+    std::swap(ptr_, o.ptr_);
+  }
+
+  T *get() const noexcept { return ptr_; }
+  T &operator*() const noexcept { return *ptr_; }
+  T *operator->() const noexcept { return ptr_; }
+  explicit operator bool() const noexcept { return ptr_ != nullptr; }
+
+  bool operator==(const intrusive_ptr &o) const noexcept { return ptr_ == o.ptr_; }
+  bool operator!=(const intrusive_ptr &o) const noexcept { return ptr_ != o.ptr_; }
+
+private:
+  T *ptr_ = nullptr;
+};
+
+template<typename T, typename ... Args>
+intrusive_ptr<T> make_intrusive(Args && ... args) {
+  return intrusive_ptr<T>(new T(std::forward<Args>(args)...));
+}
+
+
+/*
+  Container holding a reference to each linked element
+
+    owning<list<Item::item_idx_dmp>> items;
+    items.push_back(make_intrusive<Item>());
+    intrusive_ptr<Item> i = items.pop_front();
+
+  Only operations of the wrapped container are available, elements
+  are released when the wrapper is destroyed.
+ */
+template<typename Container>
+class owning : private Container {
+public:
+  typedef typename Container::value_type value_type;
+  typedef intrusive_ptr<value_type>      pointer_type;
+
+  owning() {}
+
+  ~owning() {
+    for (auto i = Container::begin(); i != Container::end();) {
+      value_type &o = *i++;
+      o.release();
+    }
+  }
+
+  using Container::begin;
+  using Container::end;
+
+  const Container &container() const noexcept { return *this; }
+
+  value_type &front() noexcept {
+    return Container::front();
+  }
+
+  value_type &back() noexcept {
+    return Container::back();
+  }
+
+  void push(pointer_type p) noexcept {
+    Container::push(*p.detach());
+  }
+
+  void push_back(pointer_type p) noexcept {
+    Container::push_back(*p.detach());
+  }
+
+  void push_front(pointer_type p) noexcept {
+    Container::push_front(*p.detach());
+  }
+
+  pointer_type pop() noexcept {
+    return pointer_type(&Container::pop(), adopt_ref);
+  }
+
+  pointer_type pop_front() noexcept {
+    return pointer_type(&Container::pop_front(), adopt_ref);
+  }
+
+  pointer_type pop_back() noexcept {
+    return pointer_type(&Container::pop_back(), adopt_ref);
+  }
+
+  // Unlinks element and drops reference of the container.
+  void erase(value_type &o) noexcept {
+    Container::erase(o);
+    o.release();
+  }
+};
+
+}
+
+#endif
@@ -7,11 +7,24 @@
   Root same as Node:
     prev -> Node
     next -> Node
+
+
+  notes:
+  - nodes are not movable, relocate_from() is the explicit relocation
+    hook used by compaction: the new node takes place of the old one in
+    its list and the old one is left unlinked
+  - relocated node has to be linked or never linked, unlink() leaves
+    stale links, so a node unlinked that way cannot be relocated
  */
 
 
+#include <cassert>
+#include <functional>
 #include <iterator>
 
+#include "stats.hpp"
+#include "trace.hpp"
+
 
 namespace rock {
 
@@ -22,6 +35,18 @@ public:
 
   list_node() noexcept {}
 
+  // Takes place of o in its list, o is left unlinked. This node must not
+  // be linked, never linked o is a no-op.
+  void relocate_from(list_node &o) noexcept {
+    assert(next_ == this && prev_ == this);
+    if (o.next_ == &o) {
+      return;
+    }
+    o.replace_(*this);
+    o.next_ = &o;
+    o.prev_ = &o;
+  }
+
   void unlink() noexcept {
     next_->prev_ = prev_;
     prev_->next_ = next_;
@@ -43,7 +68,7 @@ protected:
     add_(n, *this->prev_, *this);
   }
 
-  void replace_(list_node &n) {
+  void replace_(list_node &n) noexcept {
     n.next_ = next_;
     n.next_->prev_ = &n;
     n.prev_ = prev_;
@@ -55,6 +80,7 @@ protected:
   list_node *prev_ = this;
 
   template<typename, typename> friend class ListIterator;
+  friend class list_base;
 };
 
 
@@ -99,6 +125,160 @@ protected:
   list_node &back() const noexcept {
     return *prev_;
   }
+
+  /*
+    Sorting and merging work on the next links only: the list is cut
+    into a null-terminated chain, chains are merged, and prev links are
+    restored by a final pass.
+   */
+  template<typename Less>
+  void sort(Less less) {
+    if (next_ == prev_) {
+      return;
+    }
+
+    // bins[i] holds a sorted run of 2^i nodes, earlier runs in higher bins
+    list_node *bins[64];
+    std::size_t used = 0;
+    list_node *n = detach_();
+    while (n) {
+      list_node *carry = n;
+      n = n->next_;
+      carry->next_ = nullptr;
+
+      std::size_t i = 0;
+      for (; i < used && bins[i]; i++) {
+        carry = merge_(bins[i], carry, less);
+        bins[i] = nullptr;
+      }
+      if (i == used) {
+        used++;
+      }
+      bins[i] = carry;
+    }
+
+    list_node *r = nullptr;
+    for (std::size_t i = 0; i < used; i++) {
+      if (bins[i]) {
+        r = r ? merge_(bins[i], r, less) : bins[i];
+      }
+    }
+    relink_(r);
+  }
+
+  template<typename Less>
+  void merge(list_base &o, Less less) {
+    if (this == &o || o.empty()) {
+      return;
+    }
+    list_node *a = detach_();
+    list_node *b = o.detach_();
+    o.next_ = &o;
+    o.prev_ = &o;
+    relink_(merge_(a, b, less));
+  }
+
+  // Unlinks consecutive nodes that are equal to the previous one.
+  template<typename Equal, typename Dispose>
+  std::size_t unique(Equal equal, Dispose dispose) {
+    std::size_t removed = 0;
+    list_node *n = next_;
+    while (n != this && n->next_ != this) {
+      list_node *m = n->next_;
+      if (equal(n, m)) {
+        m->unlink();
+        dispose(m);
+        removed++;
+      } else {
+        n = m;
+      }
+    }
+    return removed;
+  }
+
+  void reverse() noexcept {
+    list_node *n = this;
+    do {
+      list_node *next = n->next_;
+      n->next_ = n->prev_;
+      n->prev_ = next;
+      n = next;
+    } while (n != this);
+  }
+
+  // Orders nodes by address, so traversal follows memory.
+  void relink_by_address() noexcept {
+    sort(std::less<list_node*>());
+  }
+
+  // Calls move for each node, the returned node takes its place, then
+  // the old node is passed to dispose.
+  template<typename Move, typename Dispose>
+  void relocate(Move move, Dispose dispose) {
+    list_node *n = next_;
+    while (n != this) {
+      list_node *next = n->next_;
+      list_node *m = move(n);
+      m->relocate_from(*n);
+      dispose(n);
+      n = next;
+    }
+  }
+
+  void splice(list_base &o) noexcept {
+    if (o.empty()) {
+      return;
+    }
+    list_node *first = o.next_;
+    list_node *last = o.prev_;
+    first->prev_ = prev_;
+    prev_->next_ = first;
+    last->next_ = this;
+    prev_ = last;
+    o.next_ = &o;
+    o.prev_ = &o;
+  }
+
+private:
+  // Returns null-terminated chain of nodes, the root is left dangling.
+  list_node *detach_() noexcept {
+    if (empty()) {
+      return nullptr;
+    }
+    prev_->next_ = nullptr;
+    return next_;
+  }
+
+  void relink_(list_node *first) noexcept {
+    list_node *prev = this;
+    for (list_node *n = first; n; n = n->next_) {
+      n->prev_ = prev;
+      prev->next_ = n;
+      prev = n;
+    }
+    prev->next_ = this;
+    prev_ = prev;
+  }
+
+  // Stable merge, nodes from a go first on equal keys.
+  template<typename Less>
+  static list_node *merge_(list_node *a, list_node *b, Less &less) {
+    list_node *r;
+    list_node **tail = &r;
+    while (a && b) {
+      if (less(b, a)) {
+        *tail = b;
+        tail = &b->next_;
+        b = b->next_;
+      } else {
+        *tail = a;
+        tail = &a->next_;
+        a = a->next_;
+      }
+    }
+    *tail = a ? a : b;
+    return r;
+  }
 };
 
 
@@ -153,12 +333,12 @@ private:
   list_node *node_;
 
   explicit ListIterator(list_node *ptr) noexcept : node_(ptr) {}
-  template<typename> friend class List;
+  template<typename, typename> friend class list;
 };
 
 
-template<typename DMP>
-class list : public list_base {
+template<typename DMP, typename Stats = no_stats>
+class list : public list_base, private Stats {
 public:
   using value_type      = typename DMP::container_type;
   using pointer         = value_type*;
@@ -191,20 +371,20 @@ public:
     return const_iterator(next_);
   }
   const_iterator cend() const noexcept {
-    return const_iterator(this);
+    return const_iterator(const_cast<list*>(this));
   }
 
-  iterator rbegin() noexcept {
-    return reverse_iterator(prev_);
+  reverse_iterator rbegin() noexcept {
+    return reverse_iterator(end());
   }
-  iterator rend() -> iterator noexcept {
-    return reverse_iterator(this);
+  reverse_iterator rend() noexcept {
+    return reverse_iterator(begin());
   }
-  const_iterator crbegin() const noexcept {
-    return const_reverse_iterator(prev_);
+  const_reverse_iterator crbegin() const noexcept {
+    return const_reverse_iterator(cend());
   }
-  const_iterator crend() const noexcept {
-    return const_reverse_iterator(this);
+  const_reverse_iterator crend() const noexcept {
+    return const_reverse_iterator(cbegin());
   }
 
 
@@ -224,24 +404,122 @@ public:
 
   void push_front(reference o) noexcept {
     list_base::push_front(*DMP::to_member(&o));
+    Stats::on_push(o);
+    ROCK_PROBE2(list_push, this, &o);
   }
   void push_back(reference o) noexcept {
     list_base::push_back(*DMP::to_member(&o));
+    Stats::on_push(o);
+    ROCK_PROBE2(list_push, this, &o);
   }
   reference pop_front() noexcept {
-    return *DMP::to_container(&list_base::pop_front());
+    reference o = *DMP::to_container(&list_base::pop_front());
+    Stats::on_pop(o);
+    ROCK_PROBE2(list_pop, this, &o);
+    return o;
   }
   reference pop_back() noexcept {
-    return *DMP::to_container(&list_base::pop_back());
+    reference o = *DMP::to_container(&list_base::pop_back());
+    Stats::on_pop(o);
+    ROCK_PROBE2(list_pop, this, &o);
+    return o;
   }
 
 
   void erase(reference o) noexcept {
     DMP::to_member(&o)->unlink();
+    Stats::on_erase(o);
+    ROCK_PROBE2(list_erase, this, &o);
   }
   void erase(iterator i) noexcept {
-    i.node_->unlink();
+    erase(*i);
+  }
+
+
+  /*
+    Reordering operations relink nodes in place and never allocate.
+   */
+  template<typename Compare>
+  void sort(Compare cmp) {
+    list_base::sort(node_compare<Compare>(cmp));
+  }
+  void sort() {
+    sort(std::less<value_type>());
   }
+
+  // Merges sorted list o into this sorted list, o becomes empty.
+  template<typename Compare>
+  void merge(list &o, Compare cmp) {
+    list_base::merge(o, node_compare<Compare>(cmp));
+    Stats::on_splice(o);
+  }
+  void merge(list &o) {
+    merge(o, std::less<value_type>());
+  }
+
+  // Unlinks consecutive equal elements, dispose is called for each of them.
+  template<typename Equal, typename Dispose>
+  size_type unique(Equal equal, Dispose dispose) {
+    return list_base::unique(node_compare<Equal>(equal), [this, &dispose](list_node *n) {
+        reference o = *DMP::to_container(n);
+        Stats::on_erase(o);
+        dispose(o);
+      });
+  }
+  template<typename Equal>
+  size_type unique(Equal equal) {
+    return unique(equal, [](reference) {});
+  }
+  size_type unique() {
+    return unique(std::equal_to<value_type>());
+  }
+
+  void reverse() noexcept {
+    list_base::reverse();
+  }
+
+  // Reorders elements by address where the order doesn't matter, sequential
+  // traversal of a long-lived list becomes sequential in memory.
+  void relink_by_address() noexcept {
+    list_base::relink_by_address();
+  }
+
+  // Calls move for each element in order, move returns a new unlinked
+  // element which takes place of the old one, then the old element is
+  // passed to dispose. See compact().
+  template<typename Move, typename Dispose>
+  void relocate(Move move, Dispose dispose) {
+    list_base::relocate([&move](list_node *n) {
+        return DMP::to_member(&move(*DMP::to_container(n)));
+      }, [&dispose](list_node *n) {
+        dispose(*DMP::to_container(n));
+      });
+  }
+
+  // Moves all elements of o to the end of this list.
+  void splice(list &o) noexcept {
+    list_base::splice(o);
+    Stats::on_splice(o);
+  }
+
+
+  const Stats &stats() const noexcept {
+    return *this;
+  }
+
+private:
+  template<typename Compare>
+  class node_compare {
+  public:
+    explicit node_compare(Compare &cmp) : cmp_(cmp) {}
+
+    bool operator()(list_node *a, list_node *b) {
+      return cmp_(*DMP::to_container(a), *DMP::to_container(b));
+    }
+
+  private:
+    Compare &cmp_;
+  };
 };
 
 
@@ -0,0 +1,230 @@
+#ifndef _ROCK_MULTI_INDEX_HPP_
+#define _ROCK_MULTI_INDEX_HPP_
+
+/*
+  Intrusive multi-index container
+
+  Root:
+    indexes -> tuple<Index1, Index2, ...>
+
+  Object:
+    node of Index1
+    node of Index2
+    ...
+
+
+  notes:
+  - object is linked into all indexes with one call, nothing is
+    allocated by the container itself (tree and hash indexes may
+    allocate their inner nodes)
+  - insert is rolled back from all indexes when a unique index rejects
+    the object
+  - modify() relinks the object only in keyed indexes, object is
+    removed from all indexes when its new key collides
+  - indexes are accessed with get<I>() for lookups and iteration
+ */
+
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+
+#include "art.hpp"
+#include "chain.hpp"
+#include "list.hpp"
+#include "swiss_index.hpp"
+
+
+namespace rock {
+
+/*
+  Index adaptor
+
+    keyed              - position depends on object contents
+    insert(index, o)   - returns false when object is rejected
+    erase(index, o)
+ */
+template<typename Index>
+struct multi_index_traits {
+  static_assert(sizeof(Index) == 0, "index doesn't support removal of random elements");
+};
+
+template<typename DMP, typename Stats>
+struct multi_index_traits<list<DMP, Stats>> {
+  static constexpr bool keyed = false;
+
+  template<typename T>
+  static bool insert(list<DMP, Stats> &l, T &o) noexcept {
+    l.push_back(o);
+    return true;
+  }
+
+  template<typename T>
+  static void erase(list<DMP, Stats> &l, T &o) noexcept {
+    l.erase(o);
+  }
+};
+
+template<typename DMP, typename Stats>
+struct multi_index_traits<chain<DMP, Stats>> {
+  static constexpr bool keyed = false;
+
+  template<typename T>
+  static bool insert(chain<DMP, Stats> &c, T &o) noexcept {
+    c.push(o);
+    return true;
+  }
+
+  template<typename T>
+  static void erase(chain<DMP, Stats> &c, T &o) noexcept {
+    c.erase(o);
+  }
+};
+
+template<typename DMP>
+struct multi_index_traits<art<DMP>> {
+  static constexpr bool keyed = true;
+
+  template<typename T>
+  static bool insert(art<DMP> &a, T &o) {
+    return a.insert(o);
+  }
+
+  template<typename T>
+  static void erase(art<DMP> &a, T &o) {
+    a.erase(o);
+  }
+};
+
+template<typename DMP, typename Hash, typename Equal>
+struct multi_index_traits<swiss_index<DMP, Hash, Equal>> {
+  static constexpr bool keyed = true;
+
+  template<typename T>
+  static bool insert(swiss_index<DMP, Hash, Equal> &s, T &o) {
+    return s.insert(o);
+  }
+
+  template<typename T>
+  static void erase(swiss_index<DMP, Hash, Equal> &s, T &o) noexcept {
+    s.erase(o);
+  }
+};
+
+
+template<typename T, typename ... Indexes>
+class multi_index {
+  template<typename ... I>
+  struct same_value_ : std::true_type {};
+
+  template<typename I, typename ... Rest>
+  struct same_value_<I, Rest...>
+    : std::integral_constant<bool, std::is_same<typename I::value_type, T>::value &&
+                                   same_value_<Rest...>::value> {};
+
+  static_assert(same_value_<Indexes...>::value, "all indexes have to hold T");
+
+public:
+  typedef T            value_type;
+  typedef T           *pointer;
+  typedef T           &reference;
+  typedef std::size_t  size_type;
+
+  static constexpr size_type index_count = sizeof...(Indexes);
+
+  template<size_type I>
+  using index_type = typename std::tuple_element<I, std::tuple<Indexes...>>::type;
+
+  multi_index() {}
+  multi_index(const multi_index&) = delete;
+  multi_index &operator=(const multi_index&) = delete;
+
+  bool empty() const noexcept { return !size_; }
+  size_type size() const noexcept { return size_; }
+
+  template<size_type I>
+  index_type<I> &get() noexcept {
+    return std::get<I>(indexes_);
+  }
+
+  template<size_type I>
+  const index_type<I> &get() const noexcept {
+    return std::get<I>(indexes_);
+  }
+
+  // Returns false when one of unique indexes already has the key.
+  bool insert(reference o) {
+    if (!insert_<0, false>(o)) {
+      return false;
+    }
+    size_++;
+    return true;
+  }
+
+  void erase(reference o) {
+    erase_<0, false>(o, index_count);
+    size_--;
+  }
+
+  /*
+    Calls f(o) and relinks o in keyed indexes. Returns false when new
+    key collides with other object, o is removed from all indexes then.
+   */
+  template<typename F>
+  bool modify(reference o, F f) {
+    erase_<0, true>(o, index_count);
+    f(o);
+    if (!insert_<0, true>(o)) {
+      erase_<0, false>(o, index_count, true);
+      size_--;
+      return false;
+    }
+    return true;
+  }
+
+private:
+  template<size_type I>
+  using traits_ = multi_index_traits<index_type<I>>;
+
+  template<size_type I, bool KeyedOnly>
+  typename std::enable_if<I == index_count, bool>::type insert_(reference) {
+    return true;
+  }
+
+  template<size_type I, bool KeyedOnly>
+  typename std::enable_if<I != index_count, bool>::type insert_(reference o) {
+    if (!KeyedOnly || traits_<I>::keyed) {
+      if (!traits_<I>::insert(std::get<I>(indexes_), o)) {
+        erase_<0, KeyedOnly>(o, I);
+        return false;
+      }
+    }
+    return insert_<I + 1, KeyedOnly>(o);
+  }
+
+  /*
+    Erases o from indexes before limit. With skip_keyed only non keyed
+    indexes are processed, they are the ones left after failed modify.
+   */
+  template<size_type I, bool KeyedOnly>
+  typename std::enable_if<I == index_count>::type erase_(reference, size_type, bool = false) {}
+
+  template<size_type I, bool KeyedOnly>
+  typename std::enable_if<I != index_count>::type erase_(reference o, size_type limit, bool skip_keyed = false) {
+    if (I >= limit) {
+      return;
+    }
+    bool keyed = traits_<I>::keyed;
+    if ((!KeyedOnly || keyed) && !(skip_keyed && keyed)) {
+      traits_<I>::erase(std::get<I>(indexes_), o);
+    }
+    erase_<I + 1, KeyedOnly>(o, limit, skip_keyed);
+  }
+
+  std::tuple<Indexes...> indexes_;
+  size_type              size_ = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,437 @@
+#ifndef _ROCK_PARKING_LOT_HPP_
+#define _ROCK_PARKING_LOT_HPP_
+
+/*
+  Parking lot (Linux)
+
+  Buckets (global, hashed by address):
+    lock    - futex mutex
+    threads -> List of parked threads
+
+  Parked Thread (thread local):
+    list_node
+    address - address the thread is parked on
+    word    - futex word the thread sleeps on
+    token   - value passed by the unparking thread
+
+
+  notes:
+  - locks and conditions built on the parking lot keep only one byte of
+    state, all queuing is done in the buckets
+  - bucket table has a fixed size, so threads parked on different
+    addresses can share a bucket
+ */
+
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <ctime>
+#include <thread>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "list.hpp"
+#include "utils.hpp"
+
+
+namespace rock {
+
+namespace detail {
+
+inline long futex(std::atomic<int> *word, int op, int value, const struct timespec *timeout) noexcept {
+  return syscall(SYS_futex, reinterpret_cast<int*>(word), op | FUTEX_PRIVATE_FLAG, value, timeout, nullptr, 0);
+}
+
+/*
+  Three state futex mutex: 0 - unlocked, 1 - locked, 2 - locked with waiters
+ */
+class futex_mutex {
+public:
+  futex_mutex() noexcept {}
+  futex_mutex(const futex_mutex&) = delete;
+  futex_mutex &operator=(const futex_mutex&) = delete;
+
+  void lock() noexcept {
+    int c = 0;
+    if (state_.compare_exchange_strong(c, 1, std::memory_order_acquire)) {
+      return;
+    }
+    if (c != 2) {
+      c = state_.exchange(2, std::memory_order_acquire);
+    }
+    while (c != 0) {
+      futex(&state_, FUTEX_WAIT, 2, nullptr);
+      c = state_.exchange(2, std::memory_order_acquire);
+    }
+  }
+
+  void unlock() noexcept {
+    if (state_.exchange(0, std::memory_order_release) == 2) {
+      futex(&state_, FUTEX_WAKE, 1, nullptr);
+    }
+  }
+
+private:
+  std::atomic<int> state_{0};
+};
+
+}
+
+
+class parking_lot {
+public:
+  struct unpark_result {
+    bool did_unpark;
+    bool may_have_more;
+  };
+
+  struct park_result {
+    bool     was_unparked;
+    intptr_t token;
+  };
+
+  static constexpr std::size_t bucket_count = 1024;
+
+  /*
+    Parks current thread on address if validate() returns true, validate
+    is called with the bucket locked. before_sleep() is called after the
+    bucket is unlocked. Negative timeout means waiting forever.
+   */
+  template<typename Validate, typename BeforeSleep>
+  static park_result park(const void *address, Validate validate, BeforeSleep before_sleep,
+                          std::chrono::nanoseconds timeout = std::chrono::nanoseconds(-1)) {
+    parked_thread &self = current_();
+    bucket &b = bucket_for_(address);
+
+    b.lock.lock();
+    if (!validate()) {
+      b.lock.unlock();
+      return park_result{false, 0};
+    }
+    self.address = address;
+    self.token = 0;
+    self.word.store(0, std::memory_order_relaxed);
+    b.threads.push_back(self);
+    b.lock.unlock();
+
+    before_sleep();
+
+    if (timeout.count() < 0) {
+      wait_(self, nullptr);
+      return park_result{true, self.token};
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (;;) {
+      auto left = deadline - std::chrono::steady_clock::now();
+      if (left.count() <= 0) {
+        break;
+      }
+      struct timespec ts;
+      auto s = std::chrono::duration_cast<std::chrono::seconds>(left);
+      ts.tv_sec = static_cast<time_t>(s.count());
+      ts.tv_nsec = static_cast<long>(std::chrono::duration_cast<std::chrono::nanoseconds>(left - s).count());
+      if (wait_(self, &ts)) {
+        return park_result{true, self.token};
+      }
+    }
+
+    // timed out, thread is still linked unless somebody is unparking it
+    b.lock.lock();
+    if (self.address) {
+      b.threads.erase(self);
+      self.address = nullptr;
+      b.lock.unlock();
+      return park_result{false, 0};
+    }
+    b.lock.unlock();
+    wait_(self, nullptr);
+    return park_result{true, self.token};
+  }
+
+  template<typename Validate>
+  static park_result park(const void *address, Validate validate) {
+    return park(address, validate, []() {});
+  }
+
+  /*
+    Unparks one thread parked on address. callback(unpark_result) is
+    called with the bucket locked and returns token for the woken thread.
+   */
+  template<typename Callback>
+  static unpark_result unpark_one(const void *address, Callback callback) {
+    bucket &b = bucket_for_(address);
+    unpark_result r{false, false};
+    parked_thread *t = nullptr;
+
+    b.lock.lock();
+    for (auto i = b.threads.begin(); i != b.threads.end(); ++i) {
+      if (i->address != address) {
+        continue;
+      }
+      if (!t) {
+        t = &*i;
+      } else {
+        r.may_have_more = true;
+        break;
+      }
+    }
+    if (t) {
+      b.threads.erase(*t);
+      t->address = nullptr;
+      r.did_unpark = true;
+    }
+    intptr_t token = callback(r);
+    if (t) {
+      t->token = token;
+    }
+    b.lock.unlock();
+
+    if (t) {
+      wake_(*t);
+    }
+    return r;
+  }
+
+  static unpark_result unpark_one(const void *address) {
+    return unpark_one(address, [](unpark_result) { return intptr_t(0); });
+  }
+
+  // Returns number of unparked threads.
+  static std::size_t unpark_all(const void *address) {
+    bucket &b = bucket_for_(address);
+    list<parked_thread::list_node_dmp> woken;
+
+    b.lock.lock();
+    for (auto i = b.threads.begin(); i != b.threads.end();) {
+      parked_thread &t = *i++;
+      if (t.address == address) {
+        b.threads.erase(t);
+        t.address = nullptr;
+        woken.push_back(t);
+      }
+    }
+    b.lock.unlock();
+
+    std::size_t n = 0;
+    while (!woken.empty()) {
+      wake_(woken.pop_front());
+      n++;
+    }
+    return n;
+  }
+
+private:
+  class parked_thread {
+  public:
+    const void       *address = nullptr;
+    intptr_t          token = 0;
+    std::atomic<int>  word{0};
+
+  private:
+    list_node list_node_;
+
+  public:
+    using list_node_dmp = dmp<list_node parked_thread::*, &parked_thread::list_node_>;
+  };
+
+  struct bucket {
+    detail::futex_mutex                lock;
+    list<parked_thread::list_node_dmp> threads;
+  };
+
+  static parked_thread &current_() noexcept {
+    static thread_local parked_thread t;
+    return t;
+  }
+
+  static bucket &bucket_for_(const void *address) noexcept {
+    static bucket buckets[bucket_count];
+    uint64_t h = reinterpret_cast<uintptr_t>(address);
+    h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdULL;
+    return buckets[(h ^ (h >> 33)) & (bucket_count - 1)];
+  }
+
+  // Returns false on timeout.
+  static bool wait_(parked_thread &t, const struct timespec *timeout) noexcept {
+    while (!t.word.load(std::memory_order_acquire)) {
+      if (detail::futex(&t.word, FUTEX_WAIT, 0, timeout) == -1 && errno == ETIMEDOUT) {
+        return t.word.load(std::memory_order_acquire) != 0;
+      }
+    }
+    return true;
+  }
+
+  static void wake_(parked_thread &t) noexcept {
+    t.word.store(1, std::memory_order_release);
+    detail::futex(&t.word, FUTEX_WAKE, 1, nullptr);
+  }
+};
+
+
+/*
+  One byte mutex
+ */
+class byte_lock {
+public:
+  byte_lock() noexcept {}
+  byte_lock(const byte_lock&) = delete;
+  byte_lock &operator=(const byte_lock&) = delete;
+
+  bool try_lock() noexcept {
+    uint8_t s = state_.load(std::memory_order_relaxed);
+    while (!(s & held_)) {
+      if (state_.compare_exchange_weak(s, s | held_, std::memory_order_acquire)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void lock() noexcept {
+    uint8_t s = 0;
+    if (state_.compare_exchange_weak(s, held_, std::memory_order_acquire)) {
+      return;
+    }
+    lock_slow_();
+  }
+
+  void unlock() noexcept {
+    uint8_t s = held_;
+    if (state_.compare_exchange_strong(s, 0, std::memory_order_release)) {
+      return;
+    }
+    unlock_slow_(false);
+  }
+
+  // Hands the lock directly to a parked thread, if there is one.
+  void unlock_fairly() noexcept {
+    uint8_t s = held_;
+    if (state_.compare_exchange_strong(s, 0, std::memory_order_release)) {
+      return;
+    }
+    unlock_slow_(true);
+  }
+
+  bool is_locked() const noexcept {
+    return state_.load(std::memory_order_acquire) & held_;
+  }
+
+private:
+  static constexpr uint8_t held_   = 1;
+  static constexpr uint8_t parked_ = 2;
+  static constexpr unsigned spin_limit_ = 40;
+
+  void lock_slow_() noexcept {
+    unsigned spins = 0;
+    for (;;) {
+      uint8_t s = state_.load(std::memory_order_relaxed);
+      if (!(s & held_)) {
+        if (state_.compare_exchange_weak(s, s | held_, std::memory_order_acquire)) {
+          return;
+        }
+        continue;
+      }
+
+      if (!(s & parked_) && spins < spin_limit_) {
+        spins++;
+        std::this_thread::yield();
+        continue;
+      }
+
+      if (!(s & parked_) && !state_.compare_exchange_weak(s, s | parked_, std::memory_order_relaxed)) {
+        continue;
+      }
+
+      auto r = parking_lot::park(&state_, [this]() {
+          return state_.load(std::memory_order_relaxed) == (held_ | parked_);
+        });
+      if (r.was_unparked && r.token) {
+        // lock was handed to us
+        assert(state_.load(std::memory_order_relaxed) & held_);
+        return;
+      }
+    }
+  }
+
+  void unlock_slow_(bool fair) noexcept {
+    parking_lot::unpark_one(&state_, [this, fair](parking_lot::unpark_result r) {
+        if (fair && r.did_unpark) {
+          state_.store(r.may_have_more ? (held_ | parked_) : held_, std::memory_order_release);
+          return intptr_t(1);
+        }
+        state_.store(r.may_have_more ? parked_ : 0, std::memory_order_release);
+        return intptr_t(0);
+      });
+  }
+
+  std::atomic<uint8_t> state_{0};
+};
+
+
+/*
+  One byte condition variable
+ */
+class byte_condition {
+public:
+  byte_condition() noexcept {}
+  byte_condition(const byte_condition&) = delete;
+  byte_condition &operator=(const byte_condition&) = delete;
+
+  template<typename Lock>
+  void wait(Lock &lock) {
+    parking_lot::park(&has_waiters_, [this]() {
+        has_waiters_.store(1, std::memory_order_relaxed);
+        return true;
+      }, [&lock]() { lock.unlock(); });
+    lock.lock();
+  }
+
+  template<typename Lock, typename Predicate>
+  void wait(Lock &lock, Predicate pred) {
+    while (!pred()) {
+      wait(lock);
+    }
+  }
+
+  // Returns false on timeout.
+  template<typename Lock>
+  bool wait_for(Lock &lock, std::chrono::nanoseconds timeout) {
+    auto r = parking_lot::park(&has_waiters_, [this]() {
+        has_waiters_.store(1, std::memory_order_relaxed);
+        return true;
+      }, [&lock]() { lock.unlock(); }, timeout);
+    lock.lock();
+    return r.was_unparked;
+  }
+
+  void notify_one() noexcept {
+    if (!has_waiters_.load(std::memory_order_relaxed)) {
+      return;
+    }
+    parking_lot::unpark_one(&has_waiters_, [this](parking_lot::unpark_result r) {
+        has_waiters_.store(r.may_have_more, std::memory_order_relaxed);
+        return intptr_t(0);
+      });
+  }
+
+  void notify_all() noexcept {
+    if (!has_waiters_.load(std::memory_order_relaxed)) {
+      return;
+    }
+    has_waiters_.store(0, std::memory_order_relaxed);
+    parking_lot::unpark_all(&has_waiters_);
+  }
+
+private:
+  std::atomic<uint8_t> has_waiters_{0};
+};
+
+}
+
+#endif
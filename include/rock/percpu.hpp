@@ -0,0 +1,438 @@
+#ifndef _ROCK_PERCPU_HPP_
+#define _ROCK_PERCPU_HPP_
+
+/*
+  Per-CPU sharded containers (Linux)
+
+  Shards (one cache line per possible CPU):
+    first -> Node
+    lock  - used only by fallback path
+
+
+  notes:
+  - push and pop operate on the shard of the current CPU inside a
+    restartable sequence, kernel aborts and restarts the sequence when
+    the thread is preempted or migrated, so no atomic instructions or
+    locks are needed
+  - rseq is used when glibc registered it for the threads (glibc 2.35+
+    on x86-64), otherwise shards are protected by spin locks and indexed
+    by sched_getcpu()
+  - pop takes elements only from the shard of the current CPU, elements
+    pushed on other CPUs are collected by drain_all(), which migrates
+    the calling thread to each CPU in turn
+ */
+
+
+#include <atomic>
+#include <cassert>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+#include <sched.h>
+#include <unistd.h>
+
+#include "stack.hpp"
+
+#if defined(__x86_64__) && defined(__GLIBC__) && \
+  (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 35))
+#define ROCK_RSEQ_X86 1
+#include <sys/rseq.h>
+#endif
+
+
+namespace rock {
+
+namespace detail {
+
+inline unsigned possible_cpus() noexcept {
+  static const unsigned n = []() {
+    long r = sysconf(_SC_NPROCESSORS_CONF);
+    return r > 0 ? static_cast<unsigned>(r) : 1u;
+  }();
+  return n;
+}
+
+inline unsigned current_cpu() noexcept {
+  int cpu = sched_getcpu();
+  return cpu < 0 ? 0u : static_cast<unsigned>(cpu);
+}
+
+#ifdef ROCK_RSEQ_X86
+static_assert(offsetof(struct rseq, cpu_id) == 4, "rseq layout");
+static_assert(offsetof(struct rseq, rseq_cs) == 8, "rseq layout");
+
+inline struct rseq *rseq_area() noexcept {
+  char *tp;
+  __asm__ ("movq %%fs:0, %0" : "=r"(tp));
+  return reinterpret_cast<struct rseq*>(tp + __rseq_offset);
+}
+
+/*
+  Critical section descriptor and abort handler, abort handler has to be
+  preceded by the signature registered by glibc.
+ */
+#define ROCK_RSEQ_STR_(x) #x
+#define ROCK_RSEQ_STR(x) ROCK_RSEQ_STR_(x)
+
+#define ROCK_RSEQ_CS(label, start, commit, abort)                 \
+  ".pushsection __rseq_cs, \"aw\"\n\t"                            \
+  ".balign 32\n\t"                                                \
+  label ":\n\t"                                                   \
+  ".long 0x0, 0x0\n\t"                                            \
+  ".quad " start "f, (" commit "f - " start "f), " abort "f\n\t"  \
+  ".popsection\n\t"
+
+#define ROCK_RSEQ_ABORT(label, retry)                             \
+  ".pushsection __rseq_failure, \"ax\"\n\t"                       \
+  ".byte 0x0f, 0xb9, 0x3d\n\t"                                    \
+  ".long " ROCK_RSEQ_STR(RSEQ_SIG) "\n\t"                         \
+  label ":\n\t"                                                   \
+  "jmp " retry "b\n\t"                                            \
+  ".popsection\n\t"
+#endif
+
+inline bool rseq_available() noexcept {
+#ifdef ROCK_RSEQ_X86
+  static const bool r = __rseq_size > 0 && static_cast<int32_t>(rseq_area()->cpu_id) >= 0;
+  return r;
+#else
+  return false;
+#endif
+}
+
+template<typename T>
+T *allocate_shards(std::size_t n) {
+  void *p = nullptr;
+  if (posix_memalign(&p, alignof(T), n * sizeof(T))) {
+    throw std::bad_alloc();
+  }
+  T *shards = static_cast<T*>(p);
+  for (std::size_t i = 0; i < n; i++) {
+    new (shards + i) T();
+  }
+  return shards;
+}
+
+/*
+  Pins calling thread to one CPU at a time and restores original
+  affinity on destruction.
+ */
+class cpu_pin {
+public:
+  cpu_pin() noexcept {
+    saved_ = sched_getaffinity(0, sizeof(mask_), &mask_) == 0;
+  }
+  cpu_pin(const cpu_pin&) = delete;
+  cpu_pin &operator=(const cpu_pin&) = delete;
+
+  ~cpu_pin() {
+    if (saved_) {
+      sched_setaffinity(0, sizeof(mask_), &mask_);
+    }
+  }
+
+  // Returns false when the thread is not allowed to run on cpu.
+  bool move_to(unsigned cpu) noexcept {
+    if (cpu >= CPU_SETSIZE) {
+      return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set)) {
+      return false;
+    }
+    while (current_cpu() != cpu) {
+      std::this_thread::yield();
+    }
+    return true;
+  }
+
+private:
+  cpu_set_t mask_;
+  bool      saved_;
+};
+
+}
+
+
+class percpu_stack_base {
+public:
+  explicit percpu_stack_base(bool use_rseq = detail::rseq_available())
+    : shards_(detail::allocate_shards<shard>(detail::possible_cpus())),
+      count_(detail::possible_cpus()),
+      rseq_(use_rseq) {
+    assert(!use_rseq || detail::rseq_available());
+  }
+  percpu_stack_base(const percpu_stack_base&) = delete;
+  percpu_stack_base &operator=(const percpu_stack_base&) = delete;
+
+  ~percpu_stack_base() {
+    std::free(shards_);
+  }
+
+  bool uses_rseq() const noexcept { return rseq_; }
+  std::size_t shard_count() const noexcept { return count_; }
+
+protected:
+  struct alignas(64) shard {
+    stack_node       *first = nullptr;
+    std::atomic_flag  lock = ATOMIC_FLAG_INIT;
+  };
+  static_assert(sizeof(shard) == 64, "shard has to fill one cache line");
+
+  void push(stack_node &n) noexcept {
+#ifdef ROCK_RSEQ_X86
+    if (rseq_) {
+      struct rseq *rs = detail::rseq_area();
+      assert(rs->cpu_id < count_);
+      __asm__ __volatile__ (
+        ROCK_RSEQ_CS("3", "1", "2", "4")
+        "0:\n\t"
+        "leaq 3b(%%rip), %%rax\n\t"
+        "movq %%rax, 8(%[rs])\n\t"
+        "1:\n\t"
+        "movl 4(%[rs]), %%eax\n\t"
+        "shlq $6, %%rax\n\t"
+        "addq %[shards], %%rax\n\t"
+        "movq (%%rax), %%rcx\n\t"
+        "movq %%rcx, (%[node])\n\t"
+        "movq %[node], (%%rax)\n\t"   // commit
+        "2:\n\t"
+        ROCK_RSEQ_ABORT("4", "0")
+        :
+        : [rs] "r"(rs), [shards] "r"(shards_), [node] "r"(&n)
+        : "rax", "rcx", "memory", "cc");
+      return;
+    }
+#endif
+    shard &s = lock_(detail::current_cpu() % count_);
+    n.next_ = s.first;
+    s.first = &n;
+    s.lock.clear(std::memory_order_release);
+  }
+
+  stack_node *pop() noexcept {
+#ifdef ROCK_RSEQ_X86
+    if (rseq_) {
+      struct rseq *rs = detail::rseq_area();
+      stack_node *first;
+      assert(rs->cpu_id < count_);
+      __asm__ __volatile__ (
+        ROCK_RSEQ_CS("3", "1", "2", "4")
+        "0:\n\t"
+        "leaq 3b(%%rip), %%rax\n\t"
+        "movq %%rax, 8(%[rs])\n\t"
+        "1:\n\t"
+        "movl 4(%[rs]), %%eax\n\t"
+        "shlq $6, %%rax\n\t"
+        "addq %[shards], %%rax\n\t"
+        "movq (%%rax), %[first]\n\t"
+        "testq %[first], %[first]\n\t"
+        "jz 2f\n\t"
+        "movq (%[first]), %%rcx\n\t"
+        "movq %%rcx, (%%rax)\n\t"     // commit
+        "2:\n\t"
+        ROCK_RSEQ_ABORT("4", "0")
+        : [first] "=&r"(first)
+        : [rs] "r"(rs), [shards] "r"(shards_)
+        : "rax", "rcx", "memory", "cc");
+      if (first) {
+        first->next_ = nullptr;
+      }
+      return first;
+    }
+#endif
+    shard &s = lock_(detail::current_cpu() % count_);
+    stack_node *first = s.first;
+    if (first) {
+      s.first = first->next_;
+      first->next_ = nullptr;
+    }
+    s.lock.clear(std::memory_order_release);
+    return first;
+  }
+
+  // Detaches elements of all shards, returns chain linked through next.
+  stack_node *detach_all() noexcept {
+    stack_node *result = nullptr;
+    auto append = [&result](stack_node *n) {
+      n->next_ = result;
+      result = n;
+    };
+
+    if (!rseq_) {
+      for (std::size_t i = 0; i < count_; i++) {
+        shard &s = lock_(i);
+        stack_node *n = s.first;
+        s.first = nullptr;
+        s.lock.clear(std::memory_order_release);
+        while (n) {
+          stack_node *next = n->next_;
+          append(n);
+          n = next;
+        }
+      }
+      return result;
+    }
+
+    detail::cpu_pin pin;
+    for (unsigned cpu = 0; cpu < count_; cpu++) {
+      if (!pin.move_to(cpu)) {
+        continue;
+      }
+      while (stack_node *n = pop()) {
+        append(n);
+      }
+    }
+    return result;
+  }
+
+  static stack_node *next_(stack_node *n) noexcept {
+    return n->next_;
+  }
+
+  static void unlink_(stack_node *n) noexcept {
+    n->next_ = nullptr;
+  }
+
+private:
+  shard &lock_(std::size_t i) noexcept {
+    shard &s = shards_[i];
+    while (s.lock.test_and_set(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    return s;
+  }
+
+  shard       *shards_;
+  std::size_t  count_;
+  bool         rseq_;
+};
+
+
+template<typename DMP>
+class percpu_stack : public percpu_stack_base {
+public:
+  typedef typename DMP::container_type value_type;
+  typedef value_type                  *pointer;
+  typedef value_type                  &reference;
+  typedef std::size_t                  size_type;
+
+  using percpu_stack_base::percpu_stack_base;
+
+  void push(value_type &o) noexcept {
+    percpu_stack_base::push(*DMP::to_member(&o));
+    ROCK_PROBE2(percpu_stack_push, this, &o);
+  }
+
+  // Returns nullptr when the shard of the current CPU is empty.
+  pointer pop() noexcept {
+    stack_node *n = percpu_stack_base::pop();
+    if (!n) {
+      return nullptr;
+    }
+    pointer o = DMP::to_container(n);
+    ROCK_PROBE2(percpu_stack_pop, this, o);
+    return o;
+  }
+
+  /*
+    Removes elements of all shards and calls f(value_type&) for each,
+    returns number of removed elements. Elements on CPUs the calling
+    thread is not allowed to run on are left in place.
+   */
+  template<typename F>
+  size_type drain_all(F f) {
+    size_type count = 0;
+    stack_node *n = detach_all();
+    while (n) {
+      stack_node *next = next_(n);
+      unlink_(n);
+      f(*DMP::to_container(n));
+      n = next;
+      count++;
+    }
+    return count;
+  }
+};
+
+
+/*
+  Per-CPU counter
+
+  Each CPU increments its own cache line, value() sums all of them and
+  is not a snapshot when updates are running concurrently.
+ */
+class percpu_counter {
+public:
+  explicit percpu_counter(bool use_rseq = detail::rseq_available())
+    : slots_(detail::allocate_shards<slot>(detail::possible_cpus())),
+      count_(detail::possible_cpus()),
+      rseq_(use_rseq) {
+    assert(!use_rseq || detail::rseq_available());
+  }
+  percpu_counter(const percpu_counter&) = delete;
+  percpu_counter &operator=(const percpu_counter&) = delete;
+
+  ~percpu_counter() {
+    std::free(slots_);
+  }
+
+  void add(int64_t v) noexcept {
+#ifdef ROCK_RSEQ_X86
+    if (rseq_) {
+      struct rseq *rs = detail::rseq_area();
+      assert(rs->cpu_id < count_);
+      __asm__ __volatile__ (
+        ROCK_RSEQ_CS("3", "1", "2", "4")
+        "0:\n\t"
+        "leaq 3b(%%rip), %%rax\n\t"
+        "movq %%rax, 8(%[rs])\n\t"
+        "1:\n\t"
+        "movl 4(%[rs]), %%eax\n\t"
+        "shlq $6, %%rax\n\t"
+        "addq %[slots], %%rax\n\t"
+        "addq %[v], (%%rax)\n\t"      // commit
+        "2:\n\t"
+        ROCK_RSEQ_ABORT("4", "0")
+        :
+        : [rs] "r"(rs), [slots] "r"(slots_), [v] "r"(v)
+        : "rax", "memory", "cc");
+      return;
+    }
+#endif
+    slots_[detail::current_cpu() % count_].value.fetch_add(v, std::memory_order_relaxed);
+  }
+
+  void sub(int64_t v) noexcept { add(-v); }
+  void inc() noexcept { add(1); }
+  void dec() noexcept { add(-1); }
+
+  int64_t value() const noexcept {
+    int64_t r = 0;
+    for (std::size_t i = 0; i < count_; i++) {
+      r += slots_[i].value.load(std::memory_order_relaxed);
+    }
+    return r;
+  }
+
+  bool uses_rseq() const noexcept { return rseq_; }
+
+private:
+  struct alignas(64) slot {
+    std::atomic<int64_t> value{0};
+  };
+  static_assert(sizeof(slot) == 64, "slot has to fill one cache line");
+
+  slot        *slots_;
+  std::size_t  count_;
+  bool         rseq_;
+};
+
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef _ROCK_PRIORITY_QUEUE_HPP_
+#define _ROCK_PRIORITY_QUEUE_HPP_
+
+/*
+  Intrusive multi-level priority queue
+
+  Root:
+    bitmap[Levels / 64] - non-empty levels
+    levels[Levels]      -> Queue
+
+  Node:
+    queue_node
+
+
+  notes:
+  - level 0 has the highest priority
+  - elements with the same level are popped in FIFO order
+  - finding the highest non-empty level is a ctz on the bitmap
+ */
+
+
+#include <cassert>
+#include <cinttypes>
+
+#include "queue.hpp"
+
+
+namespace rock {
+
+template<typename DMP, std::size_t Levels = 64>
+class priority_queue {
+public:
+  using value_type      = typename DMP::container_type;
+  using reference       = value_type&;
+  using const_reference = const value_type&;
+  using level_type      = queue<DMP>;
+  using size_type       = std::size_t;
+
+  static constexpr size_type levels = Levels;
+
+  static_assert(Levels > 0, "priority queue should have at least one level");
+
+
+  priority_queue() noexcept {
+    for (size_type i = 0; i < words_; i++) {
+      bitmap_[i] = 0;
+    }
+  }
+  priority_queue(const priority_queue&) = delete;
+  priority_queue &operator=(const priority_queue&) = delete;
+
+
+  bool is_empty() const noexcept {
+    for (size_type i = 0; i < words_; i++) {
+      if (bitmap_[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool is_empty(size_type level) const noexcept {
+    assert(level < Levels);
+    return !(bitmap_[level / 64] & bit_(level));
+  }
+
+  // Returns highest non-empty level, queue should not be empty.
+  size_type top_level() const noexcept {
+    for (size_type i = 0; i < words_; i++) {
+      if (bitmap_[i]) {
+        return i * 64 + static_cast<size_type>(__builtin_ctzll(bitmap_[i]));
+      }
+    }
+    assert(false);
+    return Levels;
+  }
+
+
+  void push(reference o, size_type level) noexcept {
+    assert(level < Levels);
+    levels_[level].push(o);
+    bitmap_[level / 64] |= bit_(level);
+  }
+
+  reference pop() noexcept {
+    return pop(top_level());
+  }
+
+  reference pop(size_type level) noexcept {
+    assert(!is_empty(level));
+    reference o = levels_[level].pop();
+    if (levels_[level].is_empty()) {
+      bitmap_[level / 64] &= ~bit_(level);
+    }
+    return o;
+  }
+
+  // Moves all elements of the highest non-empty level to the end of out.
+  size_type pop_level(level_type &out) noexcept {
+    size_type level = top_level();
+    pop_level(level, out);
+    return level;
+  }
+
+  void pop_level(size_type level, level_type &out) noexcept {
+    assert(level < Levels);
+    out.splice(levels_[level]);
+    bitmap_[level / 64] &= ~bit_(level);
+  }
+
+  reference front() noexcept {
+    return levels_[top_level()].front();
+  }
+  const_reference front() const noexcept {
+    return levels_[top_level()].front();
+  }
+
+  level_type &level(size_type l) noexcept {
+    assert(l < Levels);
+    return levels_[l];
+  }
+  const level_type &level(size_type l) const noexcept {
+    assert(l < Levels);
+    return levels_[l];
+  }
+
+private:
+  static constexpr size_type words_ = (Levels + 63) / 64;
+
+  static uint64_t bit_(size_type level) noexcept {
+    return uint64_t(1) << (level % 64);
+  }
+
+  uint64_t   bitmap_[words_];
+  level_type levels_[Levels];
+};
+
+}
+
+#endif
@@ -12,14 +12,36 @@
    next  -> Node
 
 
+  Cancellable queue:
+   cancelled node keeps its link, lowest bit of its next pointer marks
+   it as a tombstone
+
+
   notes:
-  - nodes cannot be removed at random order
+  - nodes cannot be removed at random order, cancellable_queue cancels
+    a node at any position in O(1)
+  - tombstones are skipped by iteration and reclaimed lazily when they
+    reach the head, compaction unlinks all of them once they outnumber
+    both live nodes and max_dead, so traversal wastes at most that much
+  - node is handed to the reclaim delegate after it is unlinked, only
+    then it can be pushed again or destroyed, the delegate must not
+    modify the queue
+  - cancel can compact, which invalidates iterators to tombstones
+  - nodes are not movable, relocate() of the queue moves the links to
+    the new node, so an element can be relocated while it is in one
+    queue at most
  */
 
 
+#include <cassert>
 #include <cinttypes>
+#include <functional>
 #include <iterator>
 
+#include "delegate.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
 
 namespace rock {
 
@@ -29,20 +51,29 @@ public:
   queue_node(const queue_node&) = delete;
   queue_node &operator=(const queue_node&) = delete;
 
-
   bool is_linked() const noexcept {
     return !!next_;
   }
 
 private:
+  // Predecessor link is fixed by queue_base::relocate().
+  void relocate_from_(queue_node &o) noexcept {
+    next_ = o.next_;
+    o.next_ = nullptr;
+  }
+
   queue_node *next_;
 
   template<typename, typename> friend class queue_iterator;
+  template<typename, typename> friend class cancellable_queue_iterator;
+  template<typename> friend class cancellable_queue;
   friend class queue_base;
+  friend class actor_base;
 };
 
 class queue_base {
 public:
+  queue_base() noexcept {}
   queue_base(const queue_base &s) = delete;
   queue_base &operator=(const queue_base &s) = delete;
 
@@ -63,14 +94,101 @@ protected:
     last_ = &n;
   }
 
+  void push_front(queue_node &n) noexcept {
+    n.next_ = first_;
+    first_ = &n;
+    if (!last_) {
+      last_ = &n;
+    }
+  }
+
   queue_node &pop() noexcept {
     assert(!is_empty());
 
     queue_node *first = first_;
     first_ = first->next_;
+    if (!first_) {
+      last_ = nullptr;
+    }
     return *first;
   }
 
+  // Moves all nodes from the other queue to the end of this queue.
+  void splice(queue_base &o) noexcept {
+    if (o.is_empty()) {
+      return;
+    }
+    if (last_) {
+      last_->next_ = o.first_;
+    } else {
+      first_ = o.first_;
+    }
+    last_ = o.last_;
+    o.first_ = nullptr;
+    o.last_ = nullptr;
+  }
+
+  // Merge sort on node addresses, no allocation.
+  void relink_by_address() noexcept {
+    if (first_ == last_) {
+      return;
+    }
+
+    // bins[i] holds a sorted run of 2^i nodes
+    queue_node *bins[64];
+    std::size_t used = 0;
+    queue_node *n = first_;
+    while (n) {
+      queue_node *carry = n;
+      n = n->next_;
+      carry->next_ = nullptr;
+
+      std::size_t i = 0;
+      for (; i < used && bins[i]; i++) {
+        carry = merge_(bins[i], carry);
+        bins[i] = nullptr;
+      }
+      if (i == used) {
+        used++;
+      }
+      bins[i] = carry;
+    }
+
+    queue_node *r = nullptr;
+    for (std::size_t i = 0; i < used; i++) {
+      if (bins[i]) {
+        r = r ? merge_(bins[i], r) : bins[i];
+      }
+    }
+    first_ = r;
+    while (r->next_) {
+      r = r->next_;
+    }
+    last_ = r;
+  }
+
+  // Calls move for each node, the returned node takes its place, then
+  // the old node is passed to dispose.
+  template<typename Move, typename Dispose>
+  void relocate(Move move, Dispose dispose) {
+    queue_node *prev = nullptr;
+    queue_node *n = first_;
+    while (n) {
+      queue_node *next = n->next_;
+      queue_node *m = move(n);
+      m->relocate_from_(*n);
+      dispose(n);
+      if (prev) {
+        prev->next_ = m;
+      } else {
+        first_ = m;
+      }
+      prev = m;
+      n = next;
+    }
+    last_ = prev;
+  }
+
   queue_node &front() noexcept {
     assert(!is_empty());
     return *first_;
@@ -94,11 +212,32 @@ protected:
 protected:
   queue_node *first_ = nullptr;
   queue_node *last_  = nullptr;
+
+private:
+  static queue_node *merge_(queue_node *a, queue_node *b) noexcept {
+    std::less<queue_node*> less;
+    queue_node *r;
+    queue_node **tail = &r;
+    while (a && b) {
+      if (less(b, a)) {
+        *tail = b;
+        tail = &b->next_;
+        b = b->next_;
+      } else {
+        *tail = a;
+        tail = &a->next_;
+        a = a->next_;
+      }
+    }
+    *tail = a ? a : b;
+    return r;
+  }
 };
 
 template<typename DMP, typename T>
 class queue_iterator : public std::iterator<std::forward_iterator_tag, T, std::size_t> {
 public:
+  queue_iterator() noexcept {}
   queue_iterator(const queue_iterator &o) : node_(o.node_) {}
   queue_iterator &operator=(const queue_iterator &o) {
     node_ = o.node_;
@@ -111,7 +250,7 @@ public:
     return *this;
   }
 
-  queue_iterator &operator++(int) noexcept {
+  queue_iterator operator++(int) noexcept {
     queue_iterator result(*this);
     ++(*this);
     return result;
@@ -132,15 +271,15 @@ public:
   }
 
 private:
-  queue_node *node_;
+  queue_node *node_ = nullptr;
 
   explicit queue_iterator(queue_node *ptr) noexcept : node_(ptr) {}
-  template<typename> friend class queue;
+  template<typename, typename> friend class queue;
 };
 
 
-template<typename DMP>
-class queue : public queue_base {
+template<typename DMP, typename Stats = no_stats>
+class queue : public queue_base, private Stats {
 public:
   typedef typename DMP::container_type value_type;
   typedef value_type                  *pointer;
@@ -169,9 +308,42 @@ public:
 
   void push(value_type &o) noexcept {
     queue_base::push(*DMP::to_member(&o));
+    Stats::on_push(o);
+    ROCK_PROBE2(queue_push, this, &o);
+  }
+  void push_front(value_type &o) noexcept {
+    queue_base::push_front(*DMP::to_member(&o));
+    Stats::on_push(o);
+    ROCK_PROBE2(queue_push, this, &o);
   }
   value_type &pop() noexcept {
-    return *DMP::to_container(&queue_base::pop());
+    value_type &o = *DMP::to_container(&queue_base::pop());
+    Stats::on_pop(o);
+    ROCK_PROBE2(queue_pop, this, &o);
+    return o;
+  }
+
+  void splice(queue &o) noexcept {
+    queue_base::splice(o);
+    Stats::on_splice(o);
+  }
+
+  // Reorders elements by address where the order doesn't matter, sequential
+  // traversal of a long-lived queue becomes sequential in memory.
+  void relink_by_address() noexcept {
+    queue_base::relink_by_address();
+  }
+
+  // Calls move for each element in order, move returns a new element
+  // which takes place of the old one, then the old element is passed to
+  // dispose. See compact().
+  template<typename Move, typename Dispose>
+  void relocate(Move move, Dispose dispose) {
+    queue_base::relocate([&move](queue_node *n) {
+        return DMP::to_member(&move(*DMP::to_container(n)));
+      }, [&dispose](queue_node *n) {
+        dispose(*DMP::to_container(n));
+      });
   }
 
 
@@ -190,8 +362,234 @@ public:
   const value_type &back() const noexcept {
     return *DMP::to_container(&queue_base::back());
   }
+
+
+  const Stats &stats() const noexcept {
+    return *this;
+  }
 };
 
+
+template<typename DMP, typename T>
+class cancellable_queue_iterator
+  : public std::iterator<std::forward_iterator_tag, T, std::size_t> {
+public:
+  cancellable_queue_iterator() noexcept {}
+  cancellable_queue_iterator(const cancellable_queue_iterator &o) noexcept : node_(o.node_) {}
+  cancellable_queue_iterator &operator=(const cancellable_queue_iterator &o) noexcept {
+    node_ = o.node_;
+    return *this;
+  }
+
+
+  cancellable_queue_iterator &operator++() noexcept {
+    node_ = skip_(next_(node_));
+    return *this;
+  }
+
+  cancellable_queue_iterator operator++(int) noexcept {
+    cancellable_queue_iterator result(*this);
+    ++(*this);
+    return result;
+  }
+
+  bool operator==(const cancellable_queue_iterator &o) const noexcept {
+    return node_ == o.node_;
+  }
+  bool operator!=(const cancellable_queue_iterator &o) const noexcept {
+    return node_ != o.node_;
+  }
+
+  T &operator*() const noexcept {
+    return *DMP::to_container(node_);
+  }
+  T *operator->() const noexcept {
+    return DMP::to_container(node_);
+  }
+
+private:
+  queue_node *node_ = nullptr;
+
+  explicit cancellable_queue_iterator(queue_node *ptr) noexcept : node_(skip_(ptr)) {}
+
+  static queue_node *next_(const queue_node *n) noexcept {
+    return reinterpret_cast<queue_node*>(reinterpret_cast<uintptr_t>(n->next_) & ~uintptr_t(1));
+  }
+
+  static queue_node *skip_(queue_node *n) noexcept {
+    while (n && (reinterpret_cast<uintptr_t>(n->next_) & 1)) {
+      n = next_(n);
+    }
+    return n;
+  }
+
+  template<typename> friend class cancellable_queue;
+};
+
+
+template<typename DMP>
+class cancellable_queue {
+public:
+  typedef typename DMP::container_type value_type;
+  typedef value_type                  *pointer;
+  typedef const value_type            *const_pointer;
+  typedef value_type                  &reference;
+  typedef const value_type            &const_reference;
+  typedef std::size_t                  size_type;
+  typedef std::size_t                  difference_type;
+
+  typedef cancellable_queue_iterator<DMP, value_type>       iterator;
+  typedef cancellable_queue_iterator<DMP, const value_type> const_iterator;
+
+  using reclaim_type = delegate<void (reference)>;
+
+  static constexpr size_type default_max_dead = 64;
+
+  explicit cancellable_queue(reclaim_type reclaim = reclaim_type(),
+                             size_type max_dead = default_max_dead) noexcept
+    : reclaim_(reclaim), max_dead_(max_dead) {}
+  cancellable_queue(const cancellable_queue&) = delete;
+  cancellable_queue &operator=(const cancellable_queue&) = delete;
+
+  // Remaining tombstones are reclaimed, live nodes stay untouched.
+  ~cancellable_queue() {
+    compact();
+  }
+
+  bool is_empty() const noexcept { return !size_; }
+  size_type size() const noexcept { return size_; }
+  size_type dead() const noexcept { return dead_; }
+
+  static bool is_cancelled(const_reference o) noexcept {
+    return is_dead_(DMP::to_member(&o));
+  }
+
+
+  iterator begin() noexcept {
+    return iterator(first_);
+  }
+  iterator end() noexcept {
+    return iterator();
+  }
+  const_iterator cbegin() const noexcept {
+    return const_iterator(first_);
+  }
+  const_iterator cend() const noexcept {
+    return const_iterator();
+  }
+
+
+  void push(reference o) noexcept {
+    queue_node *n = DMP::to_member(&o);
+    n->next_ = nullptr;
+    if (last_) {
+      set_next_(last_, n);
+    } else {
+      first_ = n;
+    }
+    last_ = n;
+    size_++;
+  }
+
+  reference pop() noexcept {
+    assert(!is_empty());
+    skip_();
+    queue_node *first = first_;
+    first_ = next_(first);
+    if (!first_) {
+      last_ = nullptr;
+    }
+    size_--;
+    return *DMP::to_container(first);
+  }
+
+  reference front() noexcept {
+    assert(!is_empty());
+    skip_();
+    return *DMP::to_container(first_);
+  }
+
+  // Object has to be live in this queue, it stays linked as a tombstone
+  // until pop, front or compaction reclaims it.
+  void cancel(reference o) noexcept {
+    queue_node *n = DMP::to_member(&o);
+    assert(!is_dead_(n));
+    n->next_ = reinterpret_cast<queue_node*>(reinterpret_cast<uintptr_t>(n->next_) | 1);
+    size_--;
+    dead_++;
+    if (dead_ > max_dead_ && dead_ > size_) {
+      compact();
+    }
+  }
+
+  // Unlinks and reclaims all tombstones.
+  void compact() noexcept {
+    queue_node *prev = nullptr;
+    queue_node *n = first_;
+    while (n) {
+      queue_node *next = next_(n);
+      if (is_dead_(n)) {
+        if (prev) {
+          prev->next_ = next;
+        } else {
+          first_ = next;
+        }
+        reclaim_node_(n);
+      } else {
+        prev = n;
+      }
+      n = next;
+    }
+    last_ = prev;
+    assert(!dead_);
+  }
+
+private:
+  static bool is_dead_(const queue_node *n) noexcept {
+    return reinterpret_cast<uintptr_t>(n->next_) & 1;
+  }
+
+  static queue_node *next_(const queue_node *n) noexcept {
+    return iterator::next_(n);
+  }
+
+  // Keeps the tombstone mark of n.
+  static void set_next_(queue_node *n, queue_node *next) noexcept {
+    n->next_ = reinterpret_cast<queue_node*>(reinterpret_cast<uintptr_t>(next) |
+                                             (reinterpret_cast<uintptr_t>(n->next_) & 1));
+  }
+
+  // Reclaims tombstones at the head.
+  void skip_() noexcept {
+    while (first_ && is_dead_(first_)) {
+      queue_node *n = first_;
+      first_ = next_(n);
+      if (!first_) {
+        last_ = nullptr;
+      }
+      reclaim_node_(n);
+    }
+  }
+
+  void reclaim_node_(queue_node *n) {
+    n->next_ = nullptr;
+    dead_--;
+    if (reclaim_) {
+      reclaim_(*DMP::to_container(n));
+    }
+  }
+
+  queue_node   *first_ = nullptr;
+  queue_node   *last_  = nullptr;
+  size_type     size_ = 0;
+  size_type     dead_ = 0;
+  reclaim_type  reclaim_;
+  size_type     max_dead_;
+};
+
+template<typename DMP>
+constexpr typename cancellable_queue<DMP>::size_type cancellable_queue<DMP>::default_max_dead;
+
 }
 
 #endif
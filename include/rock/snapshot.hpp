@@ -0,0 +1,540 @@
+#ifndef _ROCK_SNAPSHOT_HPP_
+#define _ROCK_SNAPSHOT_HPP_
+
+/*
+  Column snapshots of intrusive containers
+
+  Snapshot:
+    values  -> T[capacity]        (64 byte aligned)
+    objects -> Container*[capacity]
+
+  Field is read through DMP from every element of a container and
+  stored into a contiguous column, column scans are vectorized:
+
+    count(op, value)  - number of elements matching the comparison
+    filter(op, value) - indices of elements matching the comparison
+    min(), max()
+
+
+  notes:
+  - gather() keeps the buffers, so periodic snapshots don't allocate
+    after the first one
+  - int32_t and int64_t columns use AVX2 or SSE4.1 kernels selected at
+    runtime, other types use scalar loops
+ */
+
+
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ROCK_SNAPSHOT_X86 1
+#include <immintrin.h>
+#endif
+
+
+namespace rock {
+
+enum class compare_op {
+  less,
+  less_equal,
+  greater,
+  greater_equal,
+  equal,
+  not_equal
+};
+
+
+namespace simd {
+
+template<typename T>
+inline bool compare(compare_op op, T x, T v) noexcept {
+  switch (op) {
+  case compare_op::less:          return x < v;
+  case compare_op::less_equal:    return x <= v;
+  case compare_op::greater:       return x > v;
+  case compare_op::greater_equal: return x >= v;
+  case compare_op::equal:         return x == v;
+  case compare_op::not_equal:     return x != v;
+  }
+  return false;
+}
+
+
+/*
+  Scalar kernels
+ */
+template<typename T>
+std::size_t count_scalar(const T *data, std::size_t n, compare_op op, T v) noexcept {
+  std::size_t r = 0;
+  for (std::size_t i = 0; i < n; i++) {
+    r += compare(op, data[i], v);
+  }
+  return r;
+}
+
+template<typename T>
+std::size_t filter_scalar(const T *data, std::size_t n, compare_op op, T v,
+                          uint32_t *out, std::size_t offset = 0) noexcept {
+  std::size_t r = 0;
+  for (std::size_t i = 0; i < n; i++) {
+    if (compare(op, data[i], v)) {
+      out[r++] = static_cast<uint32_t>(offset + i);
+    }
+  }
+  return r;
+}
+
+template<typename T>
+T min_scalar(const T *data, std::size_t n) noexcept {
+  T r = std::numeric_limits<T>::max();
+  for (std::size_t i = 0; i < n; i++) {
+    r = data[i] < r ? data[i] : r;
+  }
+  return r;
+}
+
+template<typename T>
+T max_scalar(const T *data, std::size_t n) noexcept {
+  T r = std::numeric_limits<T>::lowest();
+  for (std::size_t i = 0; i < n; i++) {
+    r = data[i] > r ? data[i] : r;
+  }
+  return r;
+}
+
+
+#ifdef ROCK_SNAPSHOT_X86
+
+enum class isa {
+  scalar,
+  sse41,
+  avx2
+};
+
+inline isa detect() noexcept {
+  static const isa level = []() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      return isa::avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+      return isa::sse41;
+    }
+    return isa::scalar;
+  }();
+  return level;
+}
+
+// Comparisons are expressed as gt or eq, optionally inverted.
+inline bool swaps_(compare_op op) noexcept {
+  return op == compare_op::less || op == compare_op::greater_equal;
+}
+inline bool inverts_(compare_op op) noexcept {
+  return op == compare_op::less_equal || op == compare_op::greater_equal ||
+         op == compare_op::not_equal;
+}
+inline bool is_eq_(compare_op op) noexcept {
+  return op == compare_op::equal || op == compare_op::not_equal;
+}
+
+
+/*
+  int32_t
+ */
+__attribute__((target("avx2")))
+inline unsigned mask8_i32_(const int32_t *p, __m256i v, compare_op op) noexcept {
+  __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  __m256i m = is_eq_(op) ? _mm256_cmpeq_epi32(x, v)
+            : swaps_(op) ? _mm256_cmpgt_epi32(v, x) : _mm256_cmpgt_epi32(x, v);
+  unsigned bits = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+  return inverts_(op) ? bits ^ 0xffu : bits;
+}
+
+__attribute__((target("avx2")))
+inline std::size_t count_avx2(const int32_t *data, std::size_t n, compare_op op, int32_t v) noexcept {
+  __m256i vv = _mm256_set1_epi32(v);
+  std::size_t r = 0;
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    r += static_cast<std::size_t>(__builtin_popcount(mask8_i32_(data + i, vv, op)));
+  }
+  return r + count_scalar(data + i, n - i, op, v);
+}
+
+__attribute__((target("avx2")))
+inline std::size_t filter_avx2(const int32_t *data, std::size_t n, compare_op op, int32_t v,
+                               uint32_t *out) noexcept {
+  __m256i vv = _mm256_set1_epi32(v);
+  std::size_t r = 0;
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    unsigned bits = mask8_i32_(data + i, vv, op);
+    while (bits) {
+      out[r++] = static_cast<uint32_t>(i + static_cast<std::size_t>(__builtin_ctz(bits)));
+      bits &= bits - 1;
+    }
+  }
+  return r + filter_scalar(data + i, n - i, op, v, out + r, i);
+}
+
+__attribute__((target("avx2")))
+inline int32_t min_avx2(const int32_t *data, std::size_t n) noexcept {
+  __m256i m = _mm256_set1_epi32(std::numeric_limits<int32_t>::max());
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    m = _mm256_min_epi32(m, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+  }
+  int32_t lanes[8];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), m);
+  int32_t r = min_scalar(lanes, 8);
+  int32_t t = min_scalar(data + i, n - i);
+  return t < r ? t : r;
+}
+
+__attribute__((target("avx2")))
+inline int32_t max_avx2(const int32_t *data, std::size_t n) noexcept {
+  __m256i m = _mm256_set1_epi32(std::numeric_limits<int32_t>::min());
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    m = _mm256_max_epi32(m, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+  }
+  int32_t lanes[8];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), m);
+  int32_t r = max_scalar(lanes, 8);
+  int32_t t = max_scalar(data + i, n - i);
+  return t > r ? t : r;
+}
+
+__attribute__((target("sse4.1")))
+inline unsigned mask4_i32_(const int32_t *p, __m128i v, compare_op op) noexcept {
+  __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  __m128i m = is_eq_(op) ? _mm_cmpeq_epi32(x, v)
+            : swaps_(op) ? _mm_cmpgt_epi32(v, x) : _mm_cmpgt_epi32(x, v);
+  unsigned bits = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(m)));
+  return inverts_(op) ? bits ^ 0xfu : bits;
+}
+
+__attribute__((target("sse4.1")))
+inline std::size_t count_sse41(const int32_t *data, std::size_t n, compare_op op, int32_t v) noexcept {
+  __m128i vv = _mm_set1_epi32(v);
+  std::size_t r = 0;
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    r += static_cast<std::size_t>(__builtin_popcount(mask4_i32_(data + i, vv, op)));
+  }
+  return r + count_scalar(data + i, n - i, op, v);
+}
+
+__attribute__((target("sse4.1")))
+inline std::size_t filter_sse41(const int32_t *data, std::size_t n, compare_op op, int32_t v,
+                                uint32_t *out) noexcept {
+  __m128i vv = _mm_set1_epi32(v);
+  std::size_t r = 0;
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    unsigned bits = mask4_i32_(data + i, vv, op);
+    while (bits) {
+      out[r++] = static_cast<uint32_t>(i + static_cast<std::size_t>(__builtin_ctz(bits)));
+      bits &= bits - 1;
+    }
+  }
+  return r + filter_scalar(data + i, n - i, op, v, out + r, i);
+}
+
+__attribute__((target("sse4.1")))
+inline int32_t min_sse41(const int32_t *data, std::size_t n) noexcept {
+  __m128i m = _mm_set1_epi32(std::numeric_limits<int32_t>::max());
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    m = _mm_min_epi32(m, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+  }
+  int32_t lanes[4];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), m);
+  int32_t r = min_scalar(lanes, 4);
+  int32_t t = min_scalar(data + i, n - i);
+  return t < r ? t : r;
+}
+
+__attribute__((target("sse4.1")))
+inline int32_t max_sse41(const int32_t *data, std::size_t n) noexcept {
+  __m128i m = _mm_set1_epi32(std::numeric_limits<int32_t>::min());
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    m = _mm_max_epi32(m, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+  }
+  int32_t lanes[4];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), m);
+  int32_t r = max_scalar(lanes, 4);
+  int32_t t = max_scalar(data + i, n - i);
+  return t > r ? t : r;
+}
+
+
+/*
+  int64_t (AVX2 only, SSE4.1 has no 64-bit compare)
+ */
+__attribute__((target("avx2")))
+inline unsigned mask4_i64_(const int64_t *p, __m256i v, compare_op op) noexcept {
+  __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  __m256i m = is_eq_(op) ? _mm256_cmpeq_epi64(x, v)
+            : swaps_(op) ? _mm256_cmpgt_epi64(v, x) : _mm256_cmpgt_epi64(x, v);
+  unsigned bits = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+  return inverts_(op) ? bits ^ 0xfu : bits;
+}
+
+__attribute__((target("avx2")))
+inline std::size_t count_avx2(const int64_t *data, std::size_t n, compare_op op, int64_t v) noexcept {
+  __m256i vv = _mm256_set1_epi64x(v);
+  std::size_t r = 0;
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    r += static_cast<std::size_t>(__builtin_popcount(mask4_i64_(data + i, vv, op)));
+  }
+  return r + count_scalar(data + i, n - i, op, v);
+}
+
+__attribute__((target("avx2")))
+inline std::size_t filter_avx2(const int64_t *data, std::size_t n, compare_op op, int64_t v,
+                               uint32_t *out) noexcept {
+  __m256i vv = _mm256_set1_epi64x(v);
+  std::size_t r = 0;
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    unsigned bits = mask4_i64_(data + i, vv, op);
+    while (bits) {
+      out[r++] = static_cast<uint32_t>(i + static_cast<std::size_t>(__builtin_ctz(bits)));
+      bits &= bits - 1;
+    }
+  }
+  return r + filter_scalar(data + i, n - i, op, v, out + r, i);
+}
+
+__attribute__((target("avx2")))
+inline int64_t min_avx2(const int64_t *data, std::size_t n) noexcept {
+  __m256i m = _mm256_set1_epi64x(std::numeric_limits<int64_t>::max());
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    m = _mm256_blendv_epi8(m, x, _mm256_cmpgt_epi64(m, x));
+  }
+  int64_t lanes[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), m);
+  int64_t r = min_scalar(lanes, 4);
+  int64_t t = min_scalar(data + i, n - i);
+  return t < r ? t : r;
+}
+
+__attribute__((target("avx2")))
+inline int64_t max_avx2(const int64_t *data, std::size_t n) noexcept {
+  __m256i m = _mm256_set1_epi64x(std::numeric_limits<int64_t>::min());
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    m = _mm256_blendv_epi8(m, x, _mm256_cmpgt_epi64(x, m));
+  }
+  int64_t lanes[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), m);
+  int64_t r = max_scalar(lanes, 4);
+  int64_t t = max_scalar(data + i, n - i);
+  return t > r ? t : r;
+}
+
+
+/*
+  Dispatch
+ */
+inline std::size_t count(const int32_t *data, std::size_t n, compare_op op, int32_t v) noexcept {
+  switch (detect()) {
+  case isa::avx2:  return count_avx2(data, n, op, v);
+  case isa::sse41: return count_sse41(data, n, op, v);
+  default:         return count_scalar(data, n, op, v);
+  }
+}
+
+inline std::size_t filter(const int32_t *data, std::size_t n, compare_op op, int32_t v,
+                          uint32_t *out) noexcept {
+  switch (detect()) {
+  case isa::avx2:  return filter_avx2(data, n, op, v, out);
+  case isa::sse41: return filter_sse41(data, n, op, v, out);
+  default:         return filter_scalar(data, n, op, v, out);
+  }
+}
+
+inline int32_t min(const int32_t *data, std::size_t n) noexcept {
+  switch (detect()) {
+  case isa::avx2:  return min_avx2(data, n);
+  case isa::sse41: return min_sse41(data, n);
+  default:         return min_scalar(data, n);
+  }
+}
+
+inline int32_t max(const int32_t *data, std::size_t n) noexcept {
+  switch (detect()) {
+  case isa::avx2:  return max_avx2(data, n);
+  case isa::sse41: return max_sse41(data, n);
+  default:         return max_scalar(data, n);
+  }
+}
+
+inline std::size_t count(const int64_t *data, std::size_t n, compare_op op, int64_t v) noexcept {
+  return detect() == isa::avx2 ? count_avx2(data, n, op, v) : count_scalar(data, n, op, v);
+}
+
+inline std::size_t filter(const int64_t *data, std::size_t n, compare_op op, int64_t v,
+                          uint32_t *out) noexcept {
+  return detect() == isa::avx2 ? filter_avx2(data, n, op, v, out) : filter_scalar(data, n, op, v, out);
+}
+
+inline int64_t min(const int64_t *data, std::size_t n) noexcept {
+  return detect() == isa::avx2 ? min_avx2(data, n) : min_scalar(data, n);
+}
+
+inline int64_t max(const int64_t *data, std::size_t n) noexcept {
+  return detect() == isa::avx2 ? max_avx2(data, n) : max_scalar(data, n);
+}
+
+#endif
+
+template<typename T>
+std::size_t count(const T *data, std::size_t n, compare_op op, T v) noexcept {
+  return count_scalar(data, n, op, v);
+}
+
+template<typename T>
+std::size_t filter(const T *data, std::size_t n, compare_op op, T v, uint32_t *out) noexcept {
+  return filter_scalar(data, n, op, v, out);
+}
+
+template<typename T>
+T min(const T *data, std::size_t n) noexcept {
+  return min_scalar(data, n);
+}
+
+template<typename T>
+T max(const T *data, std::size_t n) noexcept {
+  return max_scalar(data, n);
+}
+
+}
+
+
+template<typename DMP>
+class snapshot {
+public:
+  using value_type  = typename std::remove_cv<typename DMP::member_type>::type;
+  using object_type = typename DMP::container_type;
+  using size_type   = std::size_t;
+
+  static_assert(std::is_arithmetic<value_type>::value, "snapshot columns should be arithmetic");
+
+  static constexpr size_type alignment = 64;
+
+  snapshot() noexcept {}
+  snapshot(const snapshot&) = delete;
+  snapshot &operator=(const snapshot&) = delete;
+
+  ~snapshot() {
+    std::free(values_);
+    std::free(objects_);
+  }
+
+
+  // Reads field from every element of the container, replaces previous contents.
+  template<typename Container>
+  void gather(Container &c) {
+    size_ = 0;
+    for (auto &o: c) {
+      if (size_ == capacity_) {
+        reserve(capacity_ ? capacity_ * 2 : 1024);
+      }
+      values_[size_] = *DMP::to_member(&o);
+      objects_[size_] = &o;
+      size_++;
+    }
+  }
+
+  void reserve(size_type n) {
+    if (n <= capacity_) {
+      return;
+    }
+    value_type *v = static_cast<value_type*>(allocate_(n * sizeof(value_type)));
+    object_type **o;
+    try {
+      o = static_cast<object_type**>(allocate_(n * sizeof(object_type*)));
+    } catch (...) {
+      std::free(v);
+      throw;
+    }
+    if (size_) {
+      std::memcpy(v, values_, size_ * sizeof(value_type));
+      std::memcpy(o, objects_, size_ * sizeof(object_type*));
+    }
+    std::free(values_);
+    std::free(objects_);
+    values_ = v;
+    objects_ = o;
+    capacity_ = n;
+  }
+
+  void clear() noexcept { size_ = 0; }
+
+  size_type size() const noexcept { return size_; }
+  bool empty() const noexcept { return !size_; }
+
+  const value_type *values() const noexcept { return values_; }
+  object_type *object(size_type i) const noexcept { return objects_[i]; }
+
+
+  size_type count(compare_op op, value_type v) const noexcept {
+    return simd::count(values_, size_, op, v);
+  }
+
+  // Writes indices of matching elements into out (room for size() entries).
+  size_type filter(compare_op op, value_type v, uint32_t *out) const noexcept {
+    return simd::filter(values_, size_, op, v, out);
+  }
+
+  // Calls f(object) for each matching element.
+  template<typename F>
+  void for_each_match(compare_op op, value_type v, F &&f) const {
+    uint32_t idx[256];
+    for (size_type i = 0; i < size_; i += 256) {
+      size_type n = size_ - i < 256 ? size_ - i : 256;
+      size_type m = simd::filter(values_ + i, n, op, v, idx);
+      for (size_type j = 0; j < m; j++) {
+        f(*objects_[i + idx[j]]);
+      }
+    }
+  }
+
+  value_type min() const noexcept {
+    return simd::min(values_, size_);
+  }
+
+  value_type max() const noexcept {
+    return simd::max(values_, size_);
+  }
+
+private:
+  static void *allocate_(size_type bytes) {
+    void *p = nullptr;
+    if (posix_memalign(&p, alignment, bytes ? bytes : alignment)) {
+      throw std::bad_alloc();
+    }
+    return p;
+  }
+
+  value_type   *values_ = nullptr;
+  object_type **objects_ = nullptr;
+  size_type     size_ = 0;
+  size_type     capacity_ = 0;
+};
+
+}
+
+#endif
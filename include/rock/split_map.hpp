@@ -0,0 +1,376 @@
+#ifndef _ROCK_SPLIT_MAP_HPP_
+#define _ROCK_SPLIT_MAP_HPP_
+
+/*
+  Lock-free split-ordered hash map (Shalev, Shavit)
+
+  Root:
+    segments -> Bucket[2^s]   (segment 0 has 2 buckets)
+    Bucket   -> Dummy node
+
+  List (sorted by split-order key, next pointer marked when deleted):
+    Dummy(0) -> Node -> Dummy(2) -> Node -> Node -> Dummy(1) -> ...
+
+  Split-order key:
+    dummy  reverse(bucket)
+    node   reverse(hash | msb)
+
+
+  notes:
+  - all elements are in a single lock-free list (Harris, Michael), list
+    is sorted by bit-reversed hash, so elements of a bucket stay together
+    when the table grows and bucket 2^k + b splits bucket b
+  - table grows by doubling bucket count, new buckets are initialized
+    lazily by inserting a dummy node after the parent bucket, elements
+    are never moved, bucket segments are never reallocated
+  - erased elements are retired through epoch reclamation, reclaim
+    delegate receives an element when no reader can see it anymore, it
+    can't be inserted again before that
+  - find() result is valid while the caller holds epoch_guard
+  - keys have to be unique
+ */
+
+
+#include <atomic>
+#include <cassert>
+#include <cinttypes>
+#include <cstddef>
+#include <functional>
+#include <thread>
+
+#include "delegate.hpp"
+#include "epoch.hpp"
+#include "utils.hpp"
+
+
+namespace rock {
+
+class split_node {
+public:
+  split_node() noexcept {}
+  split_node(const split_node&) = delete;
+  split_node &operator=(const split_node&) = delete;
+
+private:
+  std::atomic<uintptr_t>  next_{0};
+  uint64_t                so_key_ = 0;
+  epoch_node              epoch_node_;
+
+  template<typename NodeDMP, typename KeyDMP, typename Hash, typename Equal>
+  friend class split_map;
+};
+
+
+template<typename NodeDMP, typename KeyDMP,
+         typename Hash = std::hash<typename KeyDMP::member_type>,
+         typename Equal = std::equal_to<typename KeyDMP::member_type>>
+class split_map : private Hash, private Equal {
+public:
+  using value_type   = typename NodeDMP::container_type;
+  using key_type     = typename KeyDMP::member_type;
+  using pointer      = value_type*;
+  using reference    = value_type&;
+  using size_type    = std::size_t;
+  using reclaim_type = delegate<void (reference)>;
+
+  static constexpr size_type max_load = 2;
+
+  explicit split_map(reclaim_type reclaim = reclaim_type(), size_type buckets = 16)
+    : reclaim_(reclaim) {
+    size_type n = 2;
+    while (n < buckets) {
+      n *= 2;
+    }
+    bucket_count_.store(n, std::memory_order_relaxed);
+
+    split_node *head = new split_node;
+    slot_(0).store(head, std::memory_order_relaxed);
+  }
+  split_map(const split_map&) = delete;
+  split_map &operator=(const split_map&) = delete;
+
+  // Waits for elements retired by this map, elements still linked are
+  // left to the user. No other thread may use the map.
+  ~split_map() {
+    assert(!epoch::pinned());
+    while (retired_.load(std::memory_order_acquire)) {
+      if (!epoch::reclaim()) {
+        std::this_thread::yield();
+      }
+    }
+
+    split_node *n = slot_(0).load(std::memory_order_relaxed);
+    while (n) {
+      split_node *next = ptr_(n->next_.load(std::memory_order_relaxed));
+      if (is_dummy_(n)) {
+        delete n;
+      }
+      n = next;
+    }
+    for (auto &s : segments_) {
+      delete[] s.load(std::memory_order_relaxed);
+    }
+  }
+
+
+  bool empty() const noexcept { return !size(); }
+  size_type size() const noexcept { return size_.load(std::memory_order_relaxed); }
+  size_type bucket_count() const noexcept { return bucket_count_.load(std::memory_order_relaxed); }
+
+
+  // Returns false when an element with the same key is already linked.
+  bool insert(reference o) {
+    epoch_guard g;
+
+    const key_type &key = *KeyDMP::to_member(&o);
+    uint64_t h = hash_(key);
+    size_type count = bucket_count();
+    split_node *head = bucket_(h & (count - 1));
+
+    split_node *n = NodeDMP::to_member(&o);
+    n->so_key_ = regular_key_(h);
+
+    split_node *prev;
+    split_node *cur;
+    for (;;) {
+      if (find_(head, n->so_key_, &key, prev, cur)) {
+        return false;
+      }
+      n->next_.store(reinterpret_cast<uintptr_t>(cur), std::memory_order_relaxed);
+      uintptr_t expected = reinterpret_cast<uintptr_t>(cur);
+      if (prev->next_.compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(n),
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+        break;
+      }
+    }
+
+    size_type s = size_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (s > count * max_load && count < max_buckets_) {
+      bucket_count_.compare_exchange_strong(count, count * 2, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  // Result is valid while the caller holds epoch_guard.
+  pointer find(const key_type &key) const {
+    epoch_guard g;
+
+    uint64_t h = hash_(key);
+    split_node *head = self_()->bucket_(h & (bucket_count() - 1));
+    split_node *prev;
+    split_node *cur;
+    if (self_()->find_(head, regular_key_(h), &key, prev, cur)) {
+      return NodeDMP::to_container(cur);
+    }
+    return nullptr;
+  }
+
+  bool contains(const key_type &key) const {
+    epoch_guard g;
+    return find(key);
+  }
+
+  // Returns erased element, it is passed to the reclaim delegate after
+  // grace period.
+  pointer erase(const key_type &key) {
+    epoch_guard g;
+
+    uint64_t h = hash_(key);
+    uint64_t so_key = regular_key_(h);
+    split_node *head = bucket_(h & (bucket_count() - 1));
+
+    split_node *prev;
+    split_node *cur;
+    for (;;) {
+      if (!find_(head, so_key, &key, prev, cur)) {
+        return nullptr;
+      }
+      uintptr_t next = cur->next_.load(std::memory_order_acquire);
+      if (next & marked_) {
+        continue;
+      }
+      // logical delete, the element can't be found after this
+      if (!cur->next_.compare_exchange_strong(next, next | marked_, std::memory_order_acq_rel)) {
+        continue;
+      }
+      size_.fetch_sub(1, std::memory_order_relaxed);
+
+      uintptr_t expected = reinterpret_cast<uintptr_t>(cur);
+      if (prev->next_.compare_exchange_strong(expected, next, std::memory_order_acq_rel)) {
+        retire_(cur);
+      } else {
+        // unlinked and retired by a concurrent traversal
+        split_node *erased = cur;
+        find_(head, so_key, &key, prev, cur);
+        cur = erased;
+      }
+      return NodeDMP::to_container(cur);
+    }
+  }
+
+  // Visits linked elements, caller has to hold epoch_guard to keep
+  // references after the call.
+  template<typename F>
+  void for_each(F &&f) const {
+    epoch_guard g;
+    split_node *n = slot_(0).load(std::memory_order_acquire);
+    while (n) {
+      uintptr_t next = n->next_.load(std::memory_order_acquire);
+      if (!is_dummy_(n) && !(next & marked_)) {
+        f(*NodeDMP::to_container(n));
+      }
+      n = ptr_(next);
+    }
+  }
+
+private:
+  static constexpr uintptr_t marked_ = 1;
+  static constexpr unsigned  max_segments_ = 48;
+  static constexpr size_type max_buckets_ = size_type(1) << (max_segments_ - 1);
+
+  split_map *self_() const noexcept {
+    return const_cast<split_map*>(this);
+  }
+
+  uint64_t hash_(const key_type &key) const noexcept {
+    // std::hash is often identity, low bits select the bucket
+    uint64_t h = static_cast<uint64_t>(Hash::operator()(key));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  static uint64_t reverse_(uint64_t v) noexcept {
+    v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+    v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+    v = ((v >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((v & 0x0f0f0f0f0f0f0f0fULL) << 4);
+    return __builtin_bswap64(v);
+  }
+
+  static uint64_t regular_key_(uint64_t h) noexcept {
+    return reverse_(h | (uint64_t(1) << 63));
+  }
+
+  static uint64_t dummy_key_(size_type bucket) noexcept {
+    return reverse_(bucket);
+  }
+
+  static bool is_dummy_(const split_node *n) noexcept {
+    return !(n->so_key_ & 1);
+  }
+
+  static split_node *ptr_(uintptr_t v) noexcept {
+    return reinterpret_cast<split_node*>(v & ~marked_);
+  }
+
+  static unsigned segment_(size_type bucket) noexcept {
+    return bucket < 2 ? 0 : 63 - __builtin_clzll(bucket);
+  }
+
+  std::atomic<split_node*> &slot_(size_type bucket) const {
+    unsigned s = segment_(bucket);
+    size_type base = s ? size_type(1) << s : 0;
+    std::atomic<split_node*> *seg = segments_[s].load(std::memory_order_acquire);
+    if (!seg) {
+      size_type n = s ? size_type(1) << s : 2;
+      std::atomic<split_node*> *fresh = new std::atomic<split_node*>[n]();
+      if (segments_[s].compare_exchange_strong(seg, fresh, std::memory_order_acq_rel)) {
+        seg = fresh;
+      } else {
+        delete[] fresh;
+      }
+    }
+    return seg[bucket - base];
+  }
+
+  split_node *bucket_(size_type bucket) {
+    split_node *d = slot_(bucket).load(std::memory_order_acquire);
+    return d ? d : init_bucket_(bucket);
+  }
+
+  // Links dummy node of the bucket after its parent bucket.
+  split_node *init_bucket_(size_type bucket) {
+    size_type parent = bucket & ~(size_type(1) << segment_(bucket));
+    split_node *head = bucket_(parent);
+
+    split_node *d = new split_node;
+    d->so_key_ = dummy_key_(bucket);
+
+    split_node *prev;
+    split_node *cur;
+    for (;;) {
+      if (find_(head, d->so_key_, nullptr, prev, cur)) {
+        delete d;
+        d = cur;
+        break;
+      }
+      d->next_.store(reinterpret_cast<uintptr_t>(cur), std::memory_order_relaxed);
+      uintptr_t expected = reinterpret_cast<uintptr_t>(cur);
+      if (prev->next_.compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(d),
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    slot_(bucket).store(d, std::memory_order_release);
+    return d;
+  }
+
+  // Finds position of the key after head, prev -> cur where cur is the
+  // element or the first greater one. Unlinks marked nodes on the way.
+  bool find_(split_node *head, uint64_t so_key, const key_type *key,
+             split_node *&prev, split_node *&cur) {
+  retry:
+    prev = head;
+    cur = ptr_(prev->next_.load(std::memory_order_acquire));
+    while (cur) {
+      uintptr_t next = cur->next_.load(std::memory_order_acquire);
+      if (next & marked_) {
+        uintptr_t expected = reinterpret_cast<uintptr_t>(cur);
+        if (!prev->next_.compare_exchange_strong(expected, next & ~marked_,
+                                                 std::memory_order_acq_rel)) {
+          goto retry;
+        }
+        retire_(cur);
+        cur = ptr_(next);
+        continue;
+      }
+
+      if (cur->so_key_ > so_key) {
+        return false;
+      }
+      if (cur->so_key_ == so_key &&
+          (!key || Equal::operator()(*key, *KeyDMP::to_member(NodeDMP::to_container(cur))))) {
+        return true;
+      }
+      prev = cur;
+      cur = ptr_(next);
+    }
+    return false;
+  }
+
+  void retire_(split_node *n) noexcept {
+    retired_.fetch_add(1, std::memory_order_relaxed);
+    epoch::retire(n->epoch_node_, epoch_node::reclaim_type::from<split_map, &split_map::reclaim_node_>(this));
+  }
+
+  void reclaim_node_(epoch_node &e) {
+    split_node *n = container_of(&e, &split_node::epoch_node_);
+    if (reclaim_) {
+      reclaim_(*NodeDMP::to_container(n));
+    }
+    retired_.fetch_sub(1, std::memory_order_release);
+  }
+
+  reclaim_type                                reclaim_;
+  mutable std::atomic<std::atomic<split_node*>*> segments_[max_segments_] = {};
+  std::atomic<size_type>                      bucket_count_{0};
+  std::atomic<size_type>                      size_{0};
+  std::atomic<size_type>                      retired_{0};
+};
+
+}
+
+#endif
@@ -11,14 +11,32 @@
     next -> Node
 
 
+  Cancellable stack:
+    cancelled node keeps its link, lowest bit of its next pointer marks
+    it as a tombstone
+
+
   notes:
-  - nodes cannot be removed at random order
+  - nodes cannot be removed at random order, cancellable_stack cancels
+    a node at any position in O(1)
+  - tombstones are skipped by iteration and reclaimed lazily when they
+    reach the top, compaction unlinks all of them once they outnumber
+    both live nodes and max_dead, so traversal wastes at most that much
+  - node is handed to the reclaim delegate after it is unlinked, only
+    then it can be pushed again or destroyed, the delegate must not
+    modify the stack
+  - cancel can compact, which invalidates iterators to tombstones
  */
 
 
+#include <cassert>
 #include <cinttypes>
 #include <iterator>
 
+#include "delegate.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
 
 namespace rock {
 
@@ -36,7 +54,10 @@ private:
   stack_node *next_ = nullptr;
 
   template<typename, typename> friend class stack_iterator;
+  template<typename, typename> friend class cancellable_stack_iterator;
+  template<typename> friend class cancellable_stack;
   friend class stack_base;
+  friend class percpu_stack_base;
 };
 
 class stack_base {
@@ -53,9 +74,11 @@ protected:
     first_ = &n;
   }
 
-  void pop() noexcept {
+  stack_node &pop() noexcept {
     assert(!is_empty());
-    first_ = first_->next_;
+    stack_node *first = first_;
+    first_ = first->next_;
+    return *first;
   }
 
   stack_node &front() noexcept {
@@ -88,7 +111,7 @@ public:
     return *this;
   }
 
-  stack_iterator &operator++(int) noexcept {
+  stack_iterator operator++(int) noexcept {
     stack_iterator result(*this);
     ++(*this);
     return result;
@@ -110,15 +133,14 @@ public:
 
 private:
   stack_node *node_ = nullptr;
-  stack_node *next_;
 
   explicit stack_iterator(stack_node *ptr) noexcept : node_(ptr) {}
-  template<typename> friend class stack;
+  template<typename, typename> friend class stack;
 };
 
 
-template<typename DMP>
-class stack : public stack_base {
+template<typename DMP, typename Stats = no_stats>
+class stack : public stack_base, private Stats {
 public:
   typedef typename DMP::container_type value_type;
   typedef value_type                  *pointer;
@@ -150,11 +172,16 @@ public:
 
 
   void push(value_type &o) noexcept {
-    stack_base::push_front(*DMP::to_member(&o));
+    stack_base::push(*DMP::to_member(&o));
+    Stats::on_push(o);
+    ROCK_PROBE2(stack_push, this, &o);
   }
 
   value_type &pop() noexcept {
-    return *DMP::to_container(stack_base::pop_front());
+    value_type &o = *DMP::to_container(&stack_base::pop());
+    Stats::on_pop(o);
+    ROCK_PROBE2(stack_pop, this, &o);
+    return o;
   }
 
   value_type &front() noexcept {
@@ -164,8 +191,216 @@ public:
   const value_type &front() const noexcept {
     return *DMP::to_container(&stack_base::front());
   }
+
+  const Stats &stats() const noexcept {
+    return *this;
+  }
+};
+
+
+template<typename DMP, typename T>
+class cancellable_stack_iterator
+  : public std::iterator<std::forward_iterator_tag, T, std::size_t> {
+public:
+  cancellable_stack_iterator() noexcept {}
+  cancellable_stack_iterator(const cancellable_stack_iterator &o) noexcept : node_(o.node_) {}
+  cancellable_stack_iterator &operator=(const cancellable_stack_iterator &o) noexcept {
+    node_ = o.node_;
+    return *this;
+  }
+
+  cancellable_stack_iterator &operator++() noexcept {
+    node_ = skip_(next_(node_));
+    return *this;
+  }
+
+  cancellable_stack_iterator operator++(int) noexcept {
+    cancellable_stack_iterator result(*this);
+    ++(*this);
+    return result;
+  }
+
+  bool operator==(const cancellable_stack_iterator &o) const noexcept {
+    return node_ == o.node_;
+  }
+  bool operator!=(const cancellable_stack_iterator &o) const noexcept {
+    return node_ != o.node_;
+  }
+
+  T &operator*() const noexcept {
+    return *DMP::to_container(node_);
+  }
+  T *operator->() const noexcept {
+    return DMP::to_container(node_);
+  }
+
+private:
+  stack_node *node_ = nullptr;
+
+  explicit cancellable_stack_iterator(stack_node *ptr) noexcept : node_(skip_(ptr)) {}
+
+  static stack_node *next_(const stack_node *n) noexcept {
+    return reinterpret_cast<stack_node*>(reinterpret_cast<uintptr_t>(n->next_) & ~uintptr_t(1));
+  }
+
+  static stack_node *skip_(stack_node *n) noexcept {
+    while (n && (reinterpret_cast<uintptr_t>(n->next_) & 1)) {
+      n = next_(n);
+    }
+    return n;
+  }
+
+  template<typename> friend class cancellable_stack;
 };
 
+
+template<typename DMP>
+class cancellable_stack {
+public:
+  typedef typename DMP::container_type value_type;
+  typedef value_type                  *pointer;
+  typedef const value_type            *const_pointer;
+  typedef value_type                  &reference;
+  typedef const value_type            &const_reference;
+  typedef std::size_t                  size_type;
+  typedef std::size_t                  difference_type;
+
+  typedef cancellable_stack_iterator<DMP, value_type>       iterator;
+  typedef cancellable_stack_iterator<DMP, const value_type> const_iterator;
+
+  using reclaim_type = delegate<void (reference)>;
+
+  static constexpr size_type default_max_dead = 64;
+
+  explicit cancellable_stack(reclaim_type reclaim = reclaim_type(),
+                             size_type max_dead = default_max_dead) noexcept
+    : reclaim_(reclaim), max_dead_(max_dead) {}
+  cancellable_stack(const cancellable_stack&) = delete;
+  cancellable_stack &operator=(const cancellable_stack&) = delete;
+
+  // Remaining tombstones are reclaimed, live nodes stay untouched.
+  ~cancellable_stack() {
+    compact();
+  }
+
+  bool is_empty() const noexcept { return !size_; }
+  size_type size() const noexcept { return size_; }
+  size_type dead() const noexcept { return dead_; }
+
+  static bool is_cancelled(const_reference o) noexcept {
+    return is_dead_(DMP::to_member(&o));
+  }
+
+
+  iterator begin() noexcept {
+    return iterator(first_);
+  }
+
+  iterator end() noexcept {
+    return iterator();
+  }
+
+  const_iterator cbegin() const noexcept {
+    return const_iterator(first_);
+  }
+
+  const_iterator cend() const noexcept {
+    return const_iterator();
+  }
+
+
+  void push(reference o) noexcept {
+    stack_node *n = DMP::to_member(&o);
+    n->next_ = first_;
+    first_ = n;
+    size_++;
+  }
+
+  reference pop() noexcept {
+    assert(!is_empty());
+    skip_();
+    stack_node *first = first_;
+    first_ = next_(first);
+    size_--;
+    return *DMP::to_container(first);
+  }
+
+  reference front() noexcept {
+    assert(!is_empty());
+    skip_();
+    return *DMP::to_container(first_);
+  }
+
+  // Object has to be live in this stack, it stays linked as a tombstone
+  // until pop, front or compaction reclaims it.
+  void cancel(reference o) noexcept {
+    stack_node *n = DMP::to_member(&o);
+    assert(!is_dead_(n));
+    n->next_ = reinterpret_cast<stack_node*>(reinterpret_cast<uintptr_t>(n->next_) | 1);
+    size_--;
+    dead_++;
+    if (dead_ > max_dead_ && dead_ > size_) {
+      compact();
+    }
+  }
+
+  // Unlinks and reclaims all tombstones.
+  void compact() noexcept {
+    stack_node *prev = nullptr;
+    stack_node *n = first_;
+    while (n) {
+      stack_node *next = next_(n);
+      if (is_dead_(n)) {
+        if (prev) {
+          prev->next_ = next;
+        } else {
+          first_ = next;
+        }
+        reclaim_node_(n);
+      } else {
+        prev = n;
+      }
+      n = next;
+    }
+    assert(!dead_);
+  }
+
+private:
+  static bool is_dead_(const stack_node *n) noexcept {
+    return reinterpret_cast<uintptr_t>(n->next_) & 1;
+  }
+
+  static stack_node *next_(const stack_node *n) noexcept {
+    return iterator::next_(n);
+  }
+
+  // Reclaims tombstones at the top.
+  void skip_() noexcept {
+    while (first_ && is_dead_(first_)) {
+      stack_node *n = first_;
+      first_ = next_(n);
+      reclaim_node_(n);
+    }
+  }
+
+  void reclaim_node_(stack_node *n) {
+    n->next_ = nullptr;
+    dead_--;
+    if (reclaim_) {
+      reclaim_(*DMP::to_container(n));
+    }
+  }
+
+  stack_node   *first_ = nullptr;
+  size_type     size_ = 0;
+  size_type     dead_ = 0;
+  reclaim_type  reclaim_;
+  size_type     max_dead_;
+};
+
+template<typename DMP>
+constexpr typename cancellable_stack<DMP>::size_type cancellable_stack<DMP>::default_max_dead;
+
 }
 
 #endif
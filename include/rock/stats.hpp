@@ -0,0 +1,175 @@
+#ifndef _ROCK_STATS_HPP_
+#define _ROCK_STATS_HPP_
+
+/*
+  Container statistics policies
+
+  Policy is passed as a template parameter to intrusive containers and
+  receives callbacks on each operation:
+
+    on_push(T&)       - element was added
+    on_pop(T&)        - element was removed from the front or back
+    on_erase(T&)      - element was removed at random position
+    on_splice(Stats&) - elements of other container were moved in
+
+
+  notes:
+  - no_stats is the default, it is empty and all of its callbacks are
+    empty inline functions, so it is compiled out completely
+  - policies are not thread-safe, just like containers
+ */
+
+
+#include <chrono>
+#include <cinttypes>
+#include <cstddef>
+
+
+namespace rock {
+
+class no_stats {
+public:
+  template<typename T> void on_push(T&) noexcept {}
+  template<typename T> void on_pop(T&) noexcept {}
+  template<typename T> void on_erase(T&) noexcept {}
+  void on_splice(no_stats&) noexcept {}
+};
+
+
+/*
+  Operation counters, current depth and high-water mark
+ */
+class counter_stats {
+public:
+  template<typename T>
+  void on_push(T&) noexcept {
+    pushes_++;
+    inc_depth_(1);
+  }
+
+  template<typename T>
+  void on_pop(T&) noexcept {
+    pops_++;
+    depth_--;
+  }
+
+  template<typename T>
+  void on_erase(T&) noexcept {
+    erases_++;
+    depth_--;
+  }
+
+  void on_splice(counter_stats &o) noexcept {
+    inc_depth_(o.depth_);
+    o.depth_ = 0;
+  }
+
+  uint64_t pushes() const noexcept { return pushes_; }
+  uint64_t pops() const noexcept { return pops_; }
+  uint64_t erases() const noexcept { return erases_; }
+  std::size_t depth() const noexcept { return depth_; }
+  std::size_t high_water() const noexcept { return high_water_; }
+
+  void reset_high_water() noexcept { high_water_ = depth_; }
+
+private:
+  void inc_depth_(std::size_t n) noexcept {
+    depth_ += n;
+    if (depth_ > high_water_) {
+      high_water_ = depth_;
+    }
+  }
+
+  uint64_t    pushes_ = 0;
+  uint64_t    pops_ = 0;
+  uint64_t    erases_ = 0;
+  std::size_t depth_ = 0;
+  std::size_t high_water_ = 0;
+};
+
+
+/*
+  Dwell time histogram
+
+  Enqueue timestamp is stored in the element through TimestampDMP
+  (uint64_t member), histogram buckets are powers of two nanoseconds:
+  bucket 0 counts zero dwell times, bucket i counts [2^(i-1), 2^i).
+ */
+template<typename TimestampDMP, typename Clock = std::chrono::steady_clock>
+class dwell_stats : public counter_stats {
+public:
+  static constexpr std::size_t buckets = 65;
+
+  dwell_stats() noexcept {
+    for (std::size_t i = 0; i < buckets; i++) {
+      histogram_[i] = 0;
+    }
+  }
+
+  template<typename T>
+  void on_push(T &o) noexcept {
+    counter_stats::on_push(o);
+    *TimestampDMP::to_member(&o) = now_();
+  }
+
+  template<typename T>
+  void on_pop(T &o) noexcept {
+    counter_stats::on_pop(o);
+    record_(o);
+  }
+
+  template<typename T>
+  void on_erase(T &o) noexcept {
+    counter_stats::on_erase(o);
+    record_(o);
+  }
+
+  void on_splice(dwell_stats &o) noexcept {
+    counter_stats::on_splice(o);
+  }
+
+  uint64_t histogram(std::size_t bucket) const noexcept {
+    return histogram_[bucket];
+  }
+
+  uint64_t max_dwell() const noexcept { return max_; }
+
+  // Approximate dwell time percentile (upper bound of the bucket).
+  uint64_t percentile(double p) const noexcept {
+    uint64_t total = 0;
+    for (std::size_t i = 0; i < buckets; i++) {
+      total += histogram_[i];
+    }
+    uint64_t target = static_cast<uint64_t>(static_cast<double>(total) * p);
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < buckets; i++) {
+      seen += histogram_[i];
+      if (histogram_[i] && seen >= target) {
+        return i < 64 ? (uint64_t(1) << i) - 1 : UINT64_MAX;
+      }
+    }
+    return 0;
+  }
+
+private:
+  static uint64_t now_() noexcept {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   Clock::now().time_since_epoch()).count());
+  }
+
+  template<typename T>
+  void record_(T &o) noexcept {
+    uint64_t d = now_() - *TimestampDMP::to_member(&o);
+    if (d > max_) {
+      max_ = d;
+    }
+    histogram_[d ? 64 - __builtin_clzll(d) : 0]++;
+  }
+
+  uint64_t histogram_[buckets];
+  uint64_t max_ = 0;
+};
+
+}
+
+#endif
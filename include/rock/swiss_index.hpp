@@ -0,0 +1,320 @@
+#ifndef _ROCK_SWISS_INDEX_HPP_
+#define _ROCK_SWISS_INDEX_HPP_
+
+/*
+  Open-addressing hash index (Swiss table)
+
+  Root:
+    ctrl  -> int8_t[capacity]   (16 byte aligned)
+    slots -> T*[capacity]
+
+  Control byte:
+    empty   -128
+    deleted -2
+    full    0..127 (7 bits of the hash)
+
+
+  notes:
+  - index stores only pointers to user objects, keys are read through
+    DMP, so they are never duplicated
+  - slots are probed in groups of 16 control bytes compared with a
+    single SSE2 instruction, full key comparison is done only for slots
+    with matching 7-bit fingerprint
+  - groups are probed quadratically, lookup stops at the first group
+    with an empty slot
+  - keys have to be unique
+ */
+
+
+#include <cassert>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace rock {
+
+class swiss_group {
+public:
+  static constexpr std::size_t width = 16;
+
+  static constexpr int8_t empty   = -128;
+  static constexpr int8_t deleted = -2;
+
+  explicit swiss_group(const int8_t *ctrl) noexcept : ctrl_(ctrl) {}
+
+  // Bitmask of slots with matching fingerprint.
+  uint32_t match(int8_t h2) const noexcept {
+#ifdef __SSE2__
+    __m128i c = _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl_));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), c)));
+#else
+    uint32_t r = 0;
+    for (std::size_t i = 0; i < width; i++) {
+      r |= uint32_t(ctrl_[i] == h2) << i;
+    }
+    return r;
+#endif
+  }
+
+  uint32_t match_empty() const noexcept {
+    return match(empty);
+  }
+
+  // Bitmask of empty and deleted slots, both have the sign bit set.
+  uint32_t match_free() const noexcept {
+#ifdef __SSE2__
+    __m128i c = _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl_));
+    return static_cast<uint32_t>(_mm_movemask_epi8(c));
+#else
+    uint32_t r = 0;
+    for (std::size_t i = 0; i < width; i++) {
+      r |= uint32_t(ctrl_[i] < 0) << i;
+    }
+    return r;
+#endif
+  }
+
+private:
+  const int8_t *ctrl_;
+};
+
+
+template<typename DMP,
+         typename Hash = std::hash<typename DMP::member_type>,
+         typename Equal = std::equal_to<typename DMP::member_type>>
+class swiss_index : private Hash, private Equal {
+public:
+  using value_type = typename DMP::container_type;
+  using key_type   = typename DMP::member_type;
+  using pointer    = value_type*;
+  using reference  = value_type&;
+  using size_type  = std::size_t;
+
+  swiss_index() noexcept {}
+  explicit swiss_index(size_type n) {
+    reserve(n);
+  }
+  swiss_index(const swiss_index&) = delete;
+  swiss_index &operator=(const swiss_index&) = delete;
+
+  ~swiss_index() {
+    std::free(ctrl_);
+    std::free(slots_);
+  }
+
+
+  bool empty() const noexcept { return !size_; }
+  size_type size() const noexcept { return size_; }
+  size_type capacity() const noexcept { return capacity_; }
+
+  void clear() noexcept {
+    if (capacity_) {
+      std::memset(ctrl_, swiss_group::empty, capacity_);
+    }
+    size_ = 0;
+    growth_left_ = max_load_(capacity_);
+  }
+
+  void reserve(size_type n) {
+    size_type c = swiss_group::width;
+    while (max_load_(c) < n) {
+      c *= 2;
+    }
+    if (c > capacity_) {
+      rehash_(c);
+    }
+  }
+
+
+  pointer find(const key_type &key) const noexcept {
+    if (!capacity_) {
+      return nullptr;
+    }
+    uint64_t h = hash_(key);
+    int8_t h2 = h2_(h);
+    size_type mask = groups_mask_();
+    size_type g = h1_(h) & mask;
+    for (size_type i = 1;; i++) {
+      const int8_t *ctrl = ctrl_ + g * swiss_group::width;
+      swiss_group group(ctrl);
+      for (uint32_t m = group.match(h2); m; m &= m - 1) {
+        pointer p = slots_[g * swiss_group::width + static_cast<size_type>(__builtin_ctz(m))];
+        if (equal_(*DMP::to_member(p), key)) {
+          return p;
+        }
+      }
+      if (group.match_empty()) {
+        return nullptr;
+      }
+      g = (g + i) & mask;
+    }
+  }
+
+  // Returns false when element with the same key is already in the index.
+  bool insert(reference o) {
+    const key_type &key = *DMP::to_member(&o);
+    if (find(key)) {
+      return false;
+    }
+    if (!growth_left_) {
+      // purge tombstones in place when the table is mostly deleted slots
+      rehash_(size_ * 2 < max_load_(capacity_) ? capacity_ : (capacity_ ? capacity_ * 2 : swiss_group::width));
+    }
+    uint64_t h = hash_(key);
+    size_type i = find_free_(h);
+    if (ctrl_[i] == swiss_group::empty) {
+      growth_left_--;
+    }
+    ctrl_[i] = h2_(h);
+    slots_[i] = &o;
+    size_++;
+    return true;
+  }
+
+  pointer erase(const key_type &key) noexcept {
+    if (!capacity_) {
+      return nullptr;
+    }
+    uint64_t h = hash_(key);
+    int8_t h2 = h2_(h);
+    size_type mask = groups_mask_();
+    size_type g = h1_(h) & mask;
+    for (size_type i = 1;; i++) {
+      int8_t *ctrl = ctrl_ + g * swiss_group::width;
+      swiss_group group(ctrl);
+      for (uint32_t m = group.match(h2); m; m &= m - 1) {
+        size_type s = g * swiss_group::width + static_cast<size_type>(__builtin_ctz(m));
+        pointer p = slots_[s];
+        if (equal_(*DMP::to_member(p), key)) {
+          // group with an empty slot was never full, so no probe
+          // sequence continues past it and the slot can become empty
+          if (group.match_empty()) {
+            ctrl_[s] = swiss_group::empty;
+            growth_left_++;
+          } else {
+            ctrl_[s] = swiss_group::deleted;
+          }
+          size_--;
+          return p;
+        }
+      }
+      if (group.match_empty()) {
+        return nullptr;
+      }
+      g = (g + i) & mask;
+    }
+  }
+
+  void erase(reference o) noexcept {
+    erase(*DMP::to_member(&o));
+  }
+
+
+  template<typename F>
+  void for_each(F &&f) const {
+    for (size_type i = 0; i < capacity_; i++) {
+      if (ctrl_[i] >= 0) {
+        f(*slots_[i]);
+      }
+    }
+  }
+
+private:
+  static size_type max_load_(size_type c) noexcept {
+    return c - c / 8;
+  }
+
+  uint64_t hash_(const key_type &key) const noexcept {
+    // std::hash is often identity, mix bits so both h1 and h2 are usable
+    uint64_t h = static_cast<uint64_t>(Hash::operator()(key));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  bool equal_(const key_type &a, const key_type &b) const noexcept {
+    return Equal::operator()(a, b);
+  }
+
+  static size_type h1_(uint64_t h) noexcept {
+    return static_cast<size_type>(h >> 7);
+  }
+
+  static int8_t h2_(uint64_t h) noexcept {
+    return static_cast<int8_t>(h & 0x7f);
+  }
+
+  size_type groups_mask_() const noexcept {
+    return capacity_ / swiss_group::width - 1;
+  }
+
+  size_type find_free_(uint64_t h) const noexcept {
+    size_type mask = groups_mask_();
+    size_type g = h1_(h) & mask;
+    for (size_type i = 1;; i++) {
+      uint32_t m = swiss_group(ctrl_ + g * swiss_group::width).match_free();
+      if (m) {
+        return g * swiss_group::width + static_cast<size_type>(__builtin_ctz(m));
+      }
+      g = (g + i) & mask;
+    }
+  }
+
+  static void *allocate_(size_type bytes) {
+    void *p = nullptr;
+    if (posix_memalign(&p, swiss_group::width, bytes)) {
+      throw std::bad_alloc();
+    }
+    return p;
+  }
+
+  void rehash_(size_type c) {
+    int8_t *ctrl = static_cast<int8_t*>(allocate_(c));
+    pointer *slots;
+    try {
+      slots = static_cast<pointer*>(allocate_(c * sizeof(pointer)));
+    } catch (...) {
+      std::free(ctrl);
+      throw;
+    }
+
+    int8_t *old_ctrl = ctrl_;
+    pointer *old_slots = slots_;
+    size_type old_capacity = capacity_;
+
+    ctrl_ = ctrl;
+    slots_ = slots;
+    std::memset(ctrl_, swiss_group::empty, c);
+    capacity_ = c;
+    growth_left_ = max_load_(c) - size_;
+
+    for (size_type i = 0; i < old_capacity; i++) {
+      if (old_ctrl[i] >= 0) {
+        uint64_t h = hash_(*DMP::to_member(old_slots[i]));
+        size_type s = find_free_(h);
+        ctrl_[s] = h2_(h);
+        slots_[s] = old_slots[i];
+      }
+    }
+    std::free(old_ctrl);
+    std::free(old_slots);
+  }
+
+  int8_t    *ctrl_ = nullptr;
+  pointer   *slots_ = nullptr;
+  size_type  capacity_ = 0;
+  size_type  size_ = 0;
+  size_type  growth_left_ = 0;
+};
+
+}
+
+#endif
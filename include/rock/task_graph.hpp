@@ -0,0 +1,240 @@
+#ifndef _ROCK_TASK_GRAPH_HPP_
+#define _ROCK_TASK_GRAPH_HPP_
+
+/*
+  Task graph executor
+
+  Graph:
+    tasks -> List of tasks
+
+  Task:
+    body         - delegate
+    successors   -> Chain of edges
+    dependencies - number of incoming edges
+    pending      - dependencies not finished in the current run
+    ready_node   - link in ready queue of the executor
+
+  Edge (owned by the user, like tasks):
+    to -> Task
+
+
+  notes:
+  - tasks and edges are intrusive, graph and executor never allocate,
+    graph can be run any number of times, pending counters are reset
+    at the beginning of each run
+  - successor becomes ready when the last of its predecessors finishes,
+    all successors made ready by one task are queued with one lock
+  - thread calling run() executes tasks too, so an executor without
+    worker threads runs graphs sequentially
+  - graph has to be acyclic and must not be modified while it runs,
+    bodies must not throw
+ */
+
+
+#include <atomic>
+#include <cassert>
+#include <cinttypes>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "chain.hpp"
+#include "delegate.hpp"
+#include "list.hpp"
+#include "queue.hpp"
+#include "utils.hpp"
+
+
+namespace rock {
+
+class task;
+
+class task_edge {
+public:
+  task_edge() noexcept {}
+  task_edge(const task_edge&) = delete;
+  task_edge &operator=(const task_edge&) = delete;
+
+  task *to() const noexcept { return to_; }
+
+private:
+  task       *to_ = nullptr;
+  chain_node  chain_node_;
+
+  friend class task_graph;
+  friend class task_executor;
+
+public:
+  using chain_node_dmp = dmp<chain_node task_edge::*, &task_edge::chain_node_>;
+};
+
+
+class task {
+public:
+  using body_type = delegate<void ()>;
+
+  task() noexcept {}
+  explicit task(body_type b) noexcept : body(b) {}
+  task(const task&) = delete;
+  task &operator=(const task&) = delete;
+
+  body_type body;
+
+  uint32_t dependencies() const noexcept { return dependencies_; }
+
+private:
+  chain<task_edge::chain_node_dmp> successors_;
+  std::atomic<uint32_t>            pending_{0};
+  uint32_t                         dependencies_ = 0;
+  queue_node                       ready_node_;
+  list_node                        graph_node_;
+
+  friend class task_graph;
+  friend class task_executor;
+
+public:
+  using ready_node_dmp = dmp<queue_node task::*, &task::ready_node_>;
+  using graph_node_dmp = dmp<list_node task::*, &task::graph_node_>;
+};
+
+
+class task_graph {
+public:
+  task_graph() noexcept {}
+  task_graph(const task_graph&) = delete;
+  task_graph &operator=(const task_graph&) = delete;
+
+  bool empty() const noexcept { return !size_; }
+  std::size_t size() const noexcept { return size_; }
+
+  void add(task &t) noexcept {
+    tasks_.push_back(t);
+    size_++;
+  }
+
+  // Adds edge from -> to, to runs after from is finished.
+  void precede(task &from, task &to, task_edge &e) noexcept {
+    e.to_ = &to;
+    from.successors_.push(e);
+    to.dependencies_++;
+  }
+
+private:
+  list<task::graph_node_dmp> tasks_;
+  std::size_t                size_ = 0;
+
+  friend class task_executor;
+};
+
+
+class task_executor {
+public:
+  explicit task_executor(unsigned threads = std::thread::hardware_concurrency()) {
+    workers_.reserve(threads);
+    for (unsigned i = 0; i < threads; i++) {
+      workers_.emplace_back([this]() { work_(); });
+    }
+  }
+
+  task_executor(const task_executor&) = delete;
+  task_executor &operator=(const task_executor&) = delete;
+
+  ~task_executor() {
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      stop_ = true;
+    }
+    ready_cond_.notify_all();
+    for (auto &w : workers_) {
+      w.join();
+    }
+  }
+
+  std::size_t threads() const noexcept { return workers_.size(); }
+
+  // Runs all tasks of the graph, returns when the last one finished.
+  void run(task_graph &g) {
+    if (g.empty()) {
+      return;
+    }
+
+    std::unique_lock<std::mutex> guard(lock_);
+    assert(!remaining_);
+    remaining_ = g.size();
+    for (auto &t : g.tasks_) {
+      t.pending_.store(t.dependencies_, std::memory_order_relaxed);
+      if (!t.dependencies_) {
+        ready_.push(t);
+      }
+    }
+    assert(!ready_.is_empty());
+    ready_cond_.notify_all();
+
+    for (;;) {
+      ready_cond_.wait(guard, [this]() { return !ready_.is_empty() || !remaining_; });
+      if (!remaining_) {
+        break;
+      }
+      task &t = ready_.pop();
+      guard.unlock();
+      execute_(t);
+      guard.lock();
+    }
+  }
+
+private:
+  void work_() {
+    std::unique_lock<std::mutex> guard(lock_);
+    for (;;) {
+      ready_cond_.wait(guard, [this]() { return !ready_.is_empty() || stop_; });
+      if (stop_) {
+        return;
+      }
+      task &t = ready_.pop();
+      guard.unlock();
+      execute_(t);
+      guard.lock();
+    }
+  }
+
+  void execute_(task &t) {
+    if (t.body) {
+      t.body();
+    }
+
+    queue<task::ready_node_dmp> ready;
+    std::size_t n = 0;
+    for (auto &e : t.successors_) {
+      if (e.to_->pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        ready.push(*e.to_);
+        n++;
+      }
+    }
+
+    bool done;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      ready_.splice(ready);
+      done = !--remaining_;
+    }
+    if (done) {
+      ready_cond_.notify_all();
+    } else if (n > 1) {
+      ready_cond_.notify_all();
+    } else if (n) {
+      ready_cond_.notify_one();
+    }
+  }
+
+  std::mutex                  lock_;
+  std::condition_variable     ready_cond_;
+  queue<task::ready_node_dmp> ready_;
+  std::size_t                 remaining_ = 0;
+  bool                        stop_ = false;
+  std::vector<std::thread>    workers_;
+};
+
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef _ROCK_TRACE_HPP_
+#define _ROCK_TRACE_HPP_
+
+/*
+  Static tracepoints (SystemTap SDT / USDT)
+
+  Probes are enabled with ROCK_ENABLE_TRACING, otherwise they expand to
+  nothing. Enabled probe is a single nop instruction in the code and a
+  note in the ELF file, tools like perf and bpftrace attach to it at
+  runtime.
+
+  Provider name is "rock", probes:
+
+    queue_push, queue_pop            (container, object)
+    stack_push, stack_pop            (container, object)
+    chain_push, chain_pop, chain_erase (container, object)
+    list_push, list_pop, list_erase  (container, object)
+    delegate_call                    (object, function)
+ */
+
+
+#ifdef ROCK_ENABLE_TRACING
+
+#include <sys/sdt.h>
+
+#define ROCK_PROBE2(name, a1, a2) DTRACE_PROBE2(rock, name, a1, a2)
+
+#else
+
+#define ROCK_PROBE2(name, a1, a2) do {} while (0)
+
+#endif
+
+#endif
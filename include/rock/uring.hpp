@@ -0,0 +1,492 @@
+#ifndef _ROCK_URING_HPP_
+#define _ROCK_URING_HPP_
+
+/*
+  io_uring engine (Linux)
+
+  Engine:
+    ring    - submission and completion rings shared with the kernel
+    pending -> Queue of operations waiting for a free submission slot
+
+  Operation:
+    queue_node
+    sqe         - prepared request, copied into the ring on flush
+    on_complete - delegate called for each completion
+
+
+  notes:
+  - operation address is used as user_data, so completions are
+    dispatched without any lookup or allocation
+  - submit() only links the operation into the pending queue, flush()
+    copies pending requests into the ring and submits them with one
+    io_uring_enter call
+  - multishot operations produce completions until a completion without
+    IORING_CQE_F_MORE is received, operation has to stay alive till then
+  - engine is not thread-safe
+ */
+
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <system_error>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "delegate.hpp"
+#include "queue.hpp"
+#include "trace.hpp"
+#include "utils.hpp"
+
+
+namespace rock {
+
+class uring_operation;
+
+struct uring_completion {
+  uring_operation *operation;
+  int32_t          res;
+  uint32_t         flags;
+
+  // Operation will produce more completions (multishot).
+  bool more() const noexcept {
+    return flags & IORING_CQE_F_MORE;
+  }
+
+  bool has_buffer() const noexcept {
+    return flags & IORING_CQE_F_BUFFER;
+  }
+
+  // Id of the provided buffer selected by the kernel.
+  uint16_t buffer_id() const noexcept {
+    return static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+  }
+};
+
+
+class uring_operation {
+public:
+  using completion_type = delegate<void (const uring_completion&)>;
+
+  uring_operation() noexcept {
+    std::memset(&sqe_, 0, sizeof(sqe_));
+  }
+  uring_operation(const uring_operation&) = delete;
+  uring_operation &operator=(const uring_operation&) = delete;
+
+  completion_type on_complete;
+
+
+  void prep_nop() noexcept {
+    prep_(IORING_OP_NOP, -1, nullptr, 0, 0);
+  }
+
+  void prep_read(int fd, void *buf, uint32_t len, uint64_t offset) noexcept {
+    prep_(IORING_OP_READ, fd, buf, len, offset);
+  }
+
+  void prep_write(int fd, const void *buf, uint32_t len, uint64_t offset) noexcept {
+    prep_(IORING_OP_WRITE, fd, buf, len, offset);
+  }
+
+  void prep_readv(int fd, const struct iovec *iov, uint32_t n, uint64_t offset) noexcept {
+    prep_(IORING_OP_READV, fd, iov, n, offset);
+  }
+
+  void prep_writev(int fd, const struct iovec *iov, uint32_t n, uint64_t offset) noexcept {
+    prep_(IORING_OP_WRITEV, fd, iov, n, offset);
+  }
+
+  // Buffer has to be inside of buffer registered at index.
+  void prep_read_fixed(int fd, void *buf, uint32_t len, uint64_t offset, uint16_t index) noexcept {
+    prep_(IORING_OP_READ_FIXED, fd, buf, len, offset);
+    sqe_.buf_index = index;
+  }
+
+  void prep_write_fixed(int fd, const void *buf, uint32_t len, uint64_t offset, uint16_t index) noexcept {
+    prep_(IORING_OP_WRITE_FIXED, fd, buf, len, offset);
+    sqe_.buf_index = index;
+  }
+
+  void prep_send(int fd, const void *buf, uint32_t len, int flags = 0) noexcept {
+    prep_(IORING_OP_SEND, fd, buf, len, 0);
+    sqe_.msg_flags = static_cast<uint32_t>(flags);
+  }
+
+  void prep_recv(int fd, void *buf, uint32_t len, int flags = 0) noexcept {
+    prep_(IORING_OP_RECV, fd, buf, len, 0);
+    sqe_.msg_flags = static_cast<uint32_t>(flags);
+  }
+
+  // Receives into buffers of the group until the socket is closed or fails.
+  void prep_recv_multishot(int fd, uint16_t group, int flags = 0) noexcept {
+    prep_(IORING_OP_RECV, fd, nullptr, 0, 0);
+    sqe_.msg_flags = static_cast<uint32_t>(flags);
+    sqe_.ioprio |= IORING_RECV_MULTISHOT;
+    sqe_.flags |= IOSQE_BUFFER_SELECT;
+    sqe_.buf_group = group;
+  }
+
+  void prep_accept(int fd, int flags = 0) noexcept {
+    prep_(IORING_OP_ACCEPT, fd, nullptr, 0, 0);
+    sqe_.accept_flags = static_cast<uint32_t>(flags);
+  }
+
+  void prep_accept_multishot(int fd, int flags = 0) noexcept {
+    prep_accept(fd, flags);
+    sqe_.ioprio |= IORING_ACCEPT_MULTISHOT;
+  }
+
+  // Cancels operation submitted earlier.
+  void prep_cancel(const uring_operation &target) noexcept {
+    prep_(IORING_OP_ASYNC_CANCEL, -1, nullptr, 0, 0);
+    sqe_.addr = reinterpret_cast<uintptr_t>(&target);
+  }
+
+  // Raw access for operations without a helper.
+  struct io_uring_sqe &sqe() noexcept { return sqe_; }
+
+private:
+  void prep_(uint8_t op, int fd, const void *addr, uint32_t len, uint64_t offset) noexcept {
+    std::memset(&sqe_, 0, sizeof(sqe_));
+    sqe_.opcode = op;
+    sqe_.fd = fd;
+    sqe_.addr = reinterpret_cast<uintptr_t>(addr);
+    sqe_.len = len;
+    sqe_.off = offset;
+  }
+
+  struct io_uring_sqe sqe_;
+  queue_node          queue_node_;
+
+  friend class uring;
+
+public:
+  using queue_node_dmp = dmp<queue_node uring_operation::*, &uring_operation::queue_node_>;
+};
+
+
+class uring {
+public:
+  explicit uring(unsigned entries = 256, unsigned flags = 0) {
+    struct io_uring_params p;
+    std::memset(&p, 0, sizeof(p));
+    p.flags = flags;
+    fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+    if (fd_ < 0) {
+      throw std::system_error(errno, std::system_category(), "io_uring_setup");
+    }
+
+    sq_size_ = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    single_mmap_ = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap_ && cq_size_ > sq_size_) {
+      sq_size_ = cq_size_;
+    }
+
+    sq_ptr_ = map_(sq_size_, IORING_OFF_SQ_RING);
+    cq_ptr_ = single_mmap_ ? sq_ptr_ : map_(cq_size_, IORING_OFF_CQ_RING);
+    sqes_size_ = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = static_cast<struct io_uring_sqe*>(map_(sqes_size_, IORING_OFF_SQES));
+
+    char *sq = static_cast<char*>(sq_ptr_);
+    sq_head_ = reinterpret_cast<uint32_t*>(sq + p.sq_off.head);
+    sq_tail_ = reinterpret_cast<uint32_t*>(sq + p.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<uint32_t*>(sq + p.sq_off.ring_mask);
+    sq_entries_ = p.sq_entries;
+    sq_array_ = reinterpret_cast<uint32_t*>(sq + p.sq_off.array);
+
+    char *cq = static_cast<char*>(cq_ptr_);
+    cq_head_ = reinterpret_cast<uint32_t*>(cq + p.cq_off.head);
+    cq_tail_ = reinterpret_cast<uint32_t*>(cq + p.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<uint32_t*>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+
+    // identity mapping, entries are always used in ring order
+    for (uint32_t i = 0; i < sq_entries_; i++) {
+      sq_array_[i] = i;
+    }
+  }
+
+  uring(const uring&) = delete;
+  uring &operator=(const uring&) = delete;
+
+  ~uring() {
+    release_();
+  }
+
+  int fd() const noexcept { return fd_; }
+
+  // Operations submitted to the kernel and not completed yet.
+  std::size_t in_flight() const noexcept { return in_flight_; }
+
+  bool has_pending() const noexcept { return !pending_.is_empty(); }
+
+
+  // Queues operation, it is passed to the kernel on the next flush.
+  void submit(uring_operation &op) noexcept {
+    pending_.push(op);
+    ROCK_PROBE2(uring_submit, this, &op);
+  }
+
+  /*
+    Copies pending operations into free submission slots and submits
+    them, returns number of operations accepted by the kernel or -errno.
+   */
+  int flush() noexcept {
+    fill_();
+    return enter_(0, 0);
+  }
+
+  // Dispatches available completions without blocking.
+  std::size_t poll() {
+    return reap_();
+  }
+
+  /*
+    Submits pending operations, waits for at least min_complete
+    completions and dispatches them.
+   */
+  std::size_t wait(unsigned min_complete = 1) {
+    fill_();
+    int r = enter_(min_complete, IORING_ENTER_GETEVENTS);
+    if (r < 0 && r != -EINTR && r != -EAGAIN && r != -EBUSY) {
+      throw std::system_error(-r, std::system_category(), "io_uring_enter");
+    }
+    return reap_();
+  }
+
+
+  // Registers fixed buffers used by prep_read_fixed and prep_write_fixed.
+  void register_buffers(const struct iovec *iov, unsigned n) {
+    register_(IORING_REGISTER_BUFFERS, iov, n, "register buffers");
+  }
+
+  void unregister_buffers() {
+    register_(IORING_UNREGISTER_BUFFERS, nullptr, 0, "unregister buffers");
+  }
+
+private:
+  void register_(unsigned op, const void *arg, unsigned n, const char *what) {
+    if (syscall(__NR_io_uring_register, fd_, op, arg, n) < 0) {
+      throw std::system_error(errno, std::system_category(), what);
+    }
+  }
+
+  void *map_(std::size_t size, off_t offset) {
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+    if (p == MAP_FAILED) {
+      int e = errno;
+      release_();
+      throw std::system_error(e, std::system_category(), "io_uring mmap");
+    }
+    return p;
+  }
+
+  void release_() noexcept {
+    unmap_(sqes_, sqes_size_);
+    if (!single_mmap_) {
+      unmap_(cq_ptr_, cq_size_);
+    }
+    unmap_(sq_ptr_, sq_size_);
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+    sqes_ = nullptr;
+    sq_ptr_ = cq_ptr_ = nullptr;
+    fd_ = -1;
+  }
+
+  static void unmap_(void *p, std::size_t size) noexcept {
+    if (p) {
+      munmap(p, size);
+    }
+  }
+
+  void fill_() noexcept {
+    uint32_t head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    uint32_t tail = *sq_tail_;
+    while (!pending_.is_empty() && tail - head < sq_entries_) {
+      uring_operation &op = pending_.pop();
+      struct io_uring_sqe &sqe = sqes_[tail & sq_mask_];
+      sqe = op.sqe_;
+      sqe.user_data = reinterpret_cast<uintptr_t>(&op);
+      tail++;
+      to_submit_++;
+    }
+    __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+  }
+
+  int enter_(unsigned min_complete, unsigned flags) noexcept {
+    if (!to_submit_ && !min_complete) {
+      return 0;
+    }
+    long r = syscall(__NR_io_uring_enter, fd_, to_submit_, min_complete, flags, nullptr, 0);
+    if (r < 0) {
+      return -errno;
+    }
+    to_submit_ -= static_cast<unsigned>(r);
+    in_flight_ += static_cast<std::size_t>(r);
+    return static_cast<int>(r);
+  }
+
+  std::size_t reap_() {
+    std::size_t n = 0;
+    uint32_t head = *cq_head_;
+    for (;;) {
+      uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      if (head == tail) {
+        break;
+      }
+      const struct io_uring_cqe &cqe = cqes_[head & cq_mask_];
+      uring_completion c{reinterpret_cast<uring_operation*>(cqe.user_data), cqe.res, cqe.flags};
+      head++;
+      // release the slot before the callback, it may wait on the ring again
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+      if (!c.more()) {
+        in_flight_--;
+      }
+      ROCK_PROBE2(uring_complete, this, c.operation);
+      if (c.operation->on_complete) {
+        c.operation->on_complete(c);
+      }
+      n++;
+    }
+    return n;
+  }
+
+  int                    fd_ = -1;
+  void                  *sq_ptr_ = nullptr;
+  void                  *cq_ptr_ = nullptr;
+  struct io_uring_sqe   *sqes_ = nullptr;
+  std::size_t            sq_size_ = 0;
+  std::size_t            cq_size_ = 0;
+  std::size_t            sqes_size_ = 0;
+  bool                   single_mmap_ = false;
+
+  uint32_t              *sq_head_ = nullptr;
+  uint32_t              *sq_tail_ = nullptr;
+  uint32_t              *sq_array_ = nullptr;
+  uint32_t               sq_mask_ = 0;
+  uint32_t               sq_entries_ = 0;
+  uint32_t              *cq_head_ = nullptr;
+  uint32_t              *cq_tail_ = nullptr;
+  uint32_t               cq_mask_ = 0;
+  struct io_uring_cqe   *cqes_ = nullptr;
+
+  unsigned               to_submit_ = 0;
+  std::size_t            in_flight_ = 0;
+  queue<uring_operation::queue_node_dmp> pending_;
+
+  friend class uring_buffer_ring;
+};
+
+
+/*
+  Provided buffer ring
+
+  Buffers are selected by the kernel for operations with buffer select
+  (multishot recv), completion carries buffer id, buffer has to be
+  returned with recycle() after the data is consumed.
+ */
+class uring_buffer_ring {
+public:
+  uring_buffer_ring(uring &ring, uint16_t group, uint16_t count, uint32_t buffer_size)
+    : ring_(ring),
+      group_(group),
+      count_(count),
+      buffer_size_(buffer_size) {
+    assert(count && !(count & (count - 1)));
+    void *p = nullptr;
+    if (posix_memalign(&p, static_cast<std::size_t>(sysconf(_SC_PAGESIZE)), count * sizeof(struct io_uring_buf))) {
+      throw std::bad_alloc();
+    }
+    // entries are addressed directly, flexible array member of
+    // io_uring_buf_ring has a wrong offset in C++ with some kernel headers
+    bufs_ = static_cast<struct io_uring_buf*>(p);
+    std::memset(bufs_, 0, count * sizeof(struct io_uring_buf));
+    data_ = static_cast<char*>(std::malloc(std::size_t(count) * buffer_size));
+    if (!data_) {
+      std::free(bufs_);
+      throw std::bad_alloc();
+    }
+
+    struct io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uintptr_t>(bufs_);
+    reg.ring_entries = count;
+    reg.bgid = group;
+    try {
+      ring_.register_(IORING_REGISTER_PBUF_RING, &reg, 1, "register buffer ring");
+    } catch (...) {
+      std::free(data_);
+      std::free(bufs_);
+      throw;
+    }
+
+    for (uint16_t i = 0; i < count; i++) {
+      add_(i);
+    }
+    publish_();
+  }
+
+  uring_buffer_ring(const uring_buffer_ring&) = delete;
+  uring_buffer_ring &operator=(const uring_buffer_ring&) = delete;
+
+  ~uring_buffer_ring() {
+    struct io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.bgid = group_;
+    syscall(__NR_io_uring_register, ring_.fd(), IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    std::free(data_);
+    std::free(bufs_);
+  }
+
+  uint16_t group() const noexcept { return group_; }
+  uint32_t buffer_size() const noexcept { return buffer_size_; }
+
+  char *buffer(uint16_t id) noexcept {
+    assert(id < count_);
+    return data_ + std::size_t(id) * buffer_size_;
+  }
+
+  // Returns buffer to the kernel.
+  void recycle(uint16_t id) noexcept {
+    add_(id);
+    publish_();
+  }
+
+private:
+  void add_(uint16_t id) noexcept {
+    struct io_uring_buf &b = bufs_[tail_ & (count_ - 1)];
+    b.addr = reinterpret_cast<uintptr_t>(buffer(id));
+    b.len = buffer_size_;
+    b.bid = id;
+    tail_++;
+  }
+
+  void publish_() noexcept {
+    // ring tail overlays reserved field of the first entry
+    __atomic_store_n(&bufs_[0].resv, tail_, __ATOMIC_RELEASE);
+  }
+
+  uring                  &ring_;
+  struct io_uring_buf     *bufs_ = nullptr;
+  char                   *data_ = nullptr;
+  uint16_t                group_;
+  uint16_t                count_;
+  uint16_t                tail_ = 0;
+  uint32_t                buffer_size_;
+};
+
+}
+
+#endif
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <rock/actor.hpp>
+#include <rock/utils.hpp>
+
+
+class Message {
+public:
+  explicit Message(int v=0) : value(v) {}
+
+  int value;
+  rock::queue_node queue_node_;
+
+  using queue_node_dmp = rock::dmp<rock::queue_node Message::*, &Message::queue_node_>;
+};
+
+using message_actor = rock::actor<Message::queue_node_dmp>;
+
+
+class Counter {
+public:
+  explicit Counter(rock::actor_runtime &rt)
+    : actor(rt, message_actor::handler_type::from<Counter, &Counter::on_message>(this)) {}
+
+  void on_message(Message &m) {
+    received.push_back(m.value);
+    sum += m.value;
+  }
+
+  std::vector<int> received;
+  int sum = 0;
+  message_actor actor;
+};
+
+
+TEST(Actor, idle) {
+  rock::actor_runtime rt(0);
+  Counter c(rt);
+  EXPECT_TRUE(c.actor.idle());
+  EXPECT_EQ(0u, rt.poll());
+}
+
+TEST(Actor, order_and_scheduling) {
+  rock::actor_runtime rt(0);
+  Counter c(rt);
+  Message m1(1);
+  Message m2(2);
+  Message m3(3);
+  c.actor.send(m1);
+  EXPECT_FALSE(c.actor.idle());
+  c.actor.send(m2);
+  c.actor.send(m3);
+
+  // scheduled once, all messages handled in one turn
+  EXPECT_EQ(1u, rt.poll());
+  EXPECT_EQ((std::vector<int>{1, 2, 3}), c.received);
+  EXPECT_TRUE(c.actor.idle());
+}
+
+TEST(Actor, batch) {
+  rock::actor_runtime rt(0, 2);
+  Counter a(rt);
+  Counter b(rt);
+  std::vector<Message> ma(5);
+  std::vector<Message> mb(1);
+  for (auto &m : ma) {
+    a.actor.send(m);
+  }
+  for (auto &m : mb) {
+    b.actor.send(m);
+  }
+  // a runs 3 turns, b gets its turn after the first one
+  EXPECT_EQ(4u, rt.poll());
+  EXPECT_EQ(5u, a.received.size());
+  EXPECT_EQ(1u, b.received.size());
+  EXPECT_TRUE(a.actor.idle());
+  EXPECT_TRUE(b.actor.idle());
+}
+
+class Pinger {
+public:
+  explicit Pinger(rock::actor_runtime &rt)
+    : actor(rt, message_actor::handler_type::from<Pinger, &Pinger::on_message>(this)) {}
+
+  // sends the message back to itself while handling it
+  void on_message(Message &m) {
+    if (m.value--) {
+      actor.send(m);
+    }
+    turns++;
+  }
+
+  int turns = 0;
+  message_actor actor;
+};
+
+TEST(Actor, send_to_self) {
+  rock::actor_runtime rt(0);
+  Pinger p(rt);
+  Message m(3);
+  p.actor.send(m);
+  EXPECT_EQ(4u, rt.poll());
+  EXPECT_EQ(4, p.turns);
+  EXPECT_TRUE(p.actor.idle());
+}
+
+TEST(Actor, threads) {
+  static constexpr int senders = 4;
+  static constexpr int per_sender = 5000;
+  std::vector<Message> messages(senders * per_sender);
+  for (std::size_t i = 0; i < messages.size(); i++) {
+    messages[i].value = 1;
+  }
+
+  rock::actor_runtime rt(2);
+  std::vector<Counter*> actors;
+  for (int i = 0; i < 8; i++) {
+    actors.push_back(new Counter(rt));
+  }
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < senders; t++) {
+    threads.emplace_back([&messages, &actors, t]() {
+        for (int i = 0; i < per_sender; i++) {
+          actors[static_cast<std::size_t>(i) % actors.size()]->actor.send(messages[t * per_sender + i]);
+        }
+      });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  for (auto *c : actors) {
+    while (!c->actor.idle()) {
+      std::this_thread::yield();
+    }
+  }
+  int total = 0;
+  for (auto *c : actors) {
+    total += c->sum;
+    delete c;
+  }
+  EXPECT_EQ(senders * per_sender, total);
+}
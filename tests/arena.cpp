@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <rock/arena.hpp>
+#include <rock/list.hpp>
+#include <rock/queue.hpp>
+#include <rock/utils.hpp>
+
+
+class MyClass {
+public:
+  explicit MyClass(int a=0) : i(a) {}
+  // Nodes are not moved, memberships are relocated by compact().
+  MyClass(MyClass &&o) noexcept : i(o.i) {}
+
+  static void relink_odd(MyClass &from, MyClass &to) {
+    to.odd_node_.relocate_from(from.odd_node_);
+  }
+
+  static void relink_all(MyClass &from, MyClass &to) {
+    to.all_node_.relocate_from(from.all_node_);
+  }
+
+  int i;
+
+private:
+  rock::list_node  all_node_;
+  rock::list_node  odd_node_;
+  rock::queue_node queue_node_;
+
+public:
+  using all_node_dmp   = rock::dmp<rock::list_node MyClass::*, &MyClass::all_node_>;
+  using odd_node_dmp   = rock::dmp<rock::list_node MyClass::*, &MyClass::odd_node_>;
+  using queue_node_dmp = rock::dmp<rock::queue_node MyClass::*, &MyClass::queue_node_>;
+};
+
+
+TEST(Arena, emplace) {
+  rock::arena<MyClass> a(3);
+  EXPECT_EQ(a.capacity(), 3u);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(a.begin()) % 64, 0u);
+
+  MyClass &m1 = a.emplace(1);
+  MyClass &m2 = a.emplace(2);
+  EXPECT_EQ(&m2, &m1 + 1);
+  EXPECT_EQ(a.size(), 2u);
+  EXPECT_TRUE(a.contains(&m1));
+  EXPECT_FALSE(a.contains(&m1 + 2));
+  EXPECT_FALSE(a.full());
+  a.emplace(3);
+  EXPECT_TRUE(a.full());
+
+  int i = 1;
+  for (auto &m: a) {
+    EXPECT_EQ(m.i, i++);
+  }
+}
+
+// Elements scattered on the heap are moved into the arena in list order,
+// their membership in the second list and in the queue survives.
+TEST(Arena, compact_list) {
+  rock::list<MyClass::all_node_dmp> all;
+  rock::list<MyClass::odd_node_dmp> odd;
+  std::vector<MyClass*> items;
+  for (int i = 0; i < 100; i++) {
+    items.push_back(new MyClass(i));
+  }
+  std::mt19937 rnd(7);
+  std::shuffle(items.begin(), items.end(), rnd);
+  for (auto *m: items) {
+    all.push_back(*m);
+    if (m->i % 2) {
+      odd.push_back(*m);
+    }
+  }
+
+  std::vector<int> keys;
+  for (auto *m: items) {
+    keys.push_back(m->i);
+  }
+
+  rock::arena<MyClass> a(items.size());
+  std::size_t disposed = 0;
+  rock::compact(all, a, &MyClass::relink_odd, [&disposed](MyClass &m) {
+      delete &m;
+      disposed++;
+    });
+  EXPECT_EQ(disposed, items.size());
+  EXPECT_EQ(a.size(), items.size());
+
+  std::size_t n = 0;
+  for (auto &m: all) {
+    EXPECT_EQ(&m, a.begin() + n);
+    EXPECT_EQ(m.i, keys[n]);
+    n++;
+  }
+  EXPECT_EQ(n, items.size());
+
+  n = 0;
+  MyClass *prev = nullptr;
+  for (auto &m: odd) {
+    EXPECT_TRUE(a.contains(&m));
+    EXPECT_EQ(m.i % 2, 1);
+    EXPECT_TRUE(!prev || prev < &m);
+    prev = &m;
+    n++;
+  }
+  EXPECT_EQ(n, 50u);
+
+  while (!odd.empty()) {
+    odd.pop_front();
+  }
+  while (!all.empty()) {
+    all.pop_front();
+  }
+}
+
+TEST(Arena, compact_queue) {
+  rock::queue<MyClass::queue_node_dmp> q;
+  rock::list<MyClass::all_node_dmp> all;
+  std::vector<std::unique_ptr<MyClass>> items;
+  for (int i = 0; i < 10; i++) {
+    items.emplace_back(new MyClass(i));
+    q.push(*items.back());
+    all.push_front(*items.back());
+  }
+
+  rock::arena<MyClass> a(items.size());
+  rock::compact(q, a, &MyClass::relink_all, [](MyClass &) {});
+  items.clear();
+
+  int i = 0;
+  for (auto &m: q) {
+    EXPECT_EQ(&m, a.begin() + i);
+    EXPECT_EQ(m.i, i);
+    i++;
+  }
+  EXPECT_EQ(&q.back(), a.begin() + 9);
+
+  i = 9;
+  for (auto &m: all) {
+    EXPECT_EQ(&m, a.begin() + i);
+    i--;
+  }
+  EXPECT_EQ(i, -1);
+
+  while (!all.empty()) {
+    all.pop_front();
+  }
+  for (i = 0; i < 10; i++) {
+    EXPECT_EQ(q.pop().i, i);
+  }
+}
+
+TEST(Arena, compact_too_small) {
+  rock::list<MyClass::all_node_dmp> all;
+  MyClass mc[3];
+  for (auto &m: mc) {
+    all.push_back(m);
+  }
+
+  rock::arena<MyClass> a(4);
+  a.emplace(7);
+  a.emplace(8);
+  EXPECT_THROW(rock::compact(all, a, [](MyClass &) {}), std::length_error);
+  EXPECT_EQ(a.size(), 2u);
+
+  int n = 0;
+  for (auto &m: all) {
+    EXPECT_EQ(&m, &mc[n++]);
+  }
+  EXPECT_EQ(n, 3);
+  while (!all.empty()) {
+    all.pop_front();
+  }
+}
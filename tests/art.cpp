@@ -0,0 +1,246 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <rock/art.hpp>
+#include <rock/utils.hpp>
+
+
+class IntItem {
+public:
+  explicit IntItem(uint64_t k=0) : key(k) {}
+
+  uint64_t key;
+
+  using key_dmp = rock::dmp<uint64_t IntItem::*, &IntItem::key>;
+};
+
+class StrItem {
+public:
+  explicit StrItem(const std::string &k) : key(k) {}
+
+  std::string key;
+
+  using key_dmp = rock::dmp<std::string StrItem::*, &StrItem::key>;
+};
+
+using IntTree = rock::art<IntItem::key_dmp>;
+using StrTree = rock::art<StrItem::key_dmp>;
+
+
+TEST(ART, empty) {
+  IntTree t;
+  EXPECT_TRUE(t.empty());
+  EXPECT_EQ(t.find(1), nullptr);
+  EXPECT_EQ(t.minimum(), nullptr);
+}
+
+TEST(ART, insert_find) {
+  IntTree t;
+  IntItem a(1);
+  IntItem b(2);
+  IntItem c(0x0100000000000000);
+
+  EXPECT_TRUE(t.insert(a));
+  EXPECT_TRUE(t.insert(b));
+  EXPECT_TRUE(t.insert(c));
+  EXPECT_EQ(t.size(), 3u);
+
+  EXPECT_EQ(t.find(1), &a);
+  EXPECT_EQ(t.find(2), &b);
+  EXPECT_EQ(t.find(0x0100000000000000), &c);
+  EXPECT_EQ(t.find(3), nullptr);
+}
+
+TEST(ART, duplicate) {
+  IntTree t;
+  IntItem a(7);
+  IntItem b(7);
+
+  EXPECT_TRUE(t.insert(a));
+  EXPECT_FALSE(t.insert(b));
+  EXPECT_EQ(t.find(7), &a);
+}
+
+TEST(ART, erase) {
+  IntTree t;
+  IntItem a(1);
+  IntItem b(2);
+
+  t.insert(a);
+  t.insert(b);
+  EXPECT_EQ(t.erase(1), &a);
+  EXPECT_EQ(t.erase(1), nullptr);
+  EXPECT_EQ(t.find(2), &b);
+  t.erase(b);
+  EXPECT_TRUE(t.empty());
+}
+
+TEST(ART, ordered_iteration) {
+  IntTree t;
+  std::vector<std::unique_ptr<IntItem>> items;
+  for (uint64_t k: {300u, 5u, 70000u, 1u, 256u, 255u}) {
+    items.emplace_back(new IntItem(k));
+    t.insert(*items.back());
+  }
+
+  std::vector<uint64_t> keys;
+  t.for_each([&keys](IntItem &i) { keys.push_back(i.key); });
+  EXPECT_EQ(keys, (std::vector<uint64_t>{1, 5, 255, 256, 300, 70000}));
+  EXPECT_EQ(t.minimum()->key, 1u);
+  EXPECT_EQ(t.maximum()->key, 70000u);
+}
+
+TEST(ART, string_prefix_keys) {
+  StrTree t;
+  StrItem a("ab");
+  StrItem b("abc");
+  StrItem c("abcdefghijklmnop");
+  StrItem d("abcdefghijklmnoq");
+  StrItem e("");
+
+  EXPECT_TRUE(t.insert(c));
+  EXPECT_TRUE(t.insert(d));
+  EXPECT_TRUE(t.insert(b));
+  EXPECT_TRUE(t.insert(a));
+  EXPECT_TRUE(t.insert(e));
+
+  EXPECT_EQ(t.find("ab"), &a);
+  EXPECT_EQ(t.find("abc"), &b);
+  EXPECT_EQ(t.find("abcdefghijklmnop"), &c);
+  EXPECT_EQ(t.find("abcdefghijklmnoq"), &d);
+  EXPECT_EQ(t.find(""), &e);
+  EXPECT_EQ(t.find("abcd"), nullptr);
+  EXPECT_EQ(t.find("abcdefghijklmnopq"), nullptr);
+
+  std::vector<std::string> keys;
+  t.for_each([&keys](StrItem &i) { keys.push_back(i.key); });
+  EXPECT_EQ(keys, (std::vector<std::string>{"", "ab", "abc", "abcdefghijklmnop", "abcdefghijklmnoq"}));
+
+  EXPECT_EQ(t.erase("abc"), &b);
+  EXPECT_EQ(t.find("abcdefghijklmnop"), &c);
+  EXPECT_EQ(t.find("ab"), &a);
+}
+
+TEST(ART, prefix_scan) {
+  StrTree t;
+  StrItem a("apple");
+  StrItem b("application");
+  StrItem c("apricot");
+  StrItem d("banana");
+  t.insert(a);
+  t.insert(b);
+  t.insert(c);
+  t.insert(d);
+
+  std::vector<std::string> keys;
+  auto collect = [&keys](StrItem &i) { keys.push_back(i.key); };
+
+  t.for_each_prefix(reinterpret_cast<const uint8_t*>("app"), 3, collect);
+  EXPECT_EQ(keys, (std::vector<std::string>{"apple", "application"}));
+
+  keys.clear();
+  t.for_each_prefix(reinterpret_cast<const uint8_t*>("ap"), 2, collect);
+  EXPECT_EQ(keys.size(), 3u);
+
+  keys.clear();
+  t.for_each_prefix(reinterpret_cast<const uint8_t*>("apx"), 3, collect);
+  EXPECT_TRUE(keys.empty());
+}
+
+TEST(ART, random_against_map) {
+  IntTree t;
+  std::map<uint64_t, IntItem*> m;
+  std::vector<std::unique_ptr<IntItem>> items;
+  std::mt19937_64 rng(42);
+
+  for (int i = 0; i < 20000; i++) {
+    // narrow the key space so that node types grow and shrink
+    uint64_t k = rng() & 0x0000ff00ff00ffff;
+    items.emplace_back(new IntItem(k));
+    bool inserted = m.emplace(k, items.back().get()).second;
+    EXPECT_EQ(t.insert(*items.back()), inserted);
+  }
+  EXPECT_EQ(t.size(), m.size());
+
+  for (auto &kv: m) {
+    EXPECT_EQ(t.find(kv.first), kv.second);
+  }
+
+  for (auto i = m.begin(); i != m.end();) {
+    if (i->first & 1) {
+      EXPECT_EQ(t.erase(i->first), i->second);
+      i = m.erase(i);
+    } else {
+      ++i;
+    }
+  }
+
+  auto mi = m.begin();
+  t.for_each([&mi](IntItem &i) {
+    EXPECT_EQ(mi->second, &i);
+    ++mi;
+  });
+  EXPECT_EQ(mi, m.end());
+
+  for (auto &kv: m) {
+    EXPECT_EQ(t.erase(kv.first), kv.second);
+  }
+  EXPECT_TRUE(t.empty());
+}
+
+TEST(ART, random_strings_against_map) {
+  StrTree t;
+  std::map<std::string, StrItem*> m;
+  std::vector<std::unique_ptr<StrItem>> items;
+  std::mt19937 rng(7);
+
+  for (int i = 0; i < 5000; i++) {
+    // long shared segments exercise prefixes longer than stored part
+    std::string k;
+    std::size_t len = rng() % 6;
+    for (std::size_t j = 0; j < len; j++) {
+      k += (rng() & 1) ? "0123456789abcdef" : "x";
+      k += static_cast<char>('a' + rng() % 3);
+    }
+    items.emplace_back(new StrItem(k));
+    bool inserted = m.emplace(k, items.back().get()).second;
+    EXPECT_EQ(t.insert(*items.back()), inserted);
+  }
+
+  for (auto &kv: m) {
+    EXPECT_EQ(t.find(kv.first), kv.second);
+  }
+
+  std::vector<std::string> keys;
+  t.for_each_prefix(reinterpret_cast<const uint8_t*>("0123456789abcdefa"), 17,
+                    [&keys](StrItem &i) { keys.push_back(i.key); });
+  std::vector<std::string> expected;
+  for (auto &kv: m) {
+    if (kv.first.compare(0, 17, "0123456789abcdefa") == 0) {
+      expected.push_back(kv.first);
+    }
+  }
+  EXPECT_EQ(keys, expected);
+
+  int n = 0;
+  for (auto i = m.begin(); i != m.end();) {
+    if (n++ % 3) {
+      EXPECT_EQ(t.erase(i->first), i->second);
+      i = m.erase(i);
+    } else {
+      ++i;
+    }
+  }
+
+  auto mi = m.begin();
+  t.for_each([&mi](StrItem &i) {
+    EXPECT_EQ(mi->second, &i);
+    ++mi;
+  });
+  EXPECT_EQ(mi, m.end());
+}
@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <rock/btree.hpp>
+#include <rock/utils.hpp>
+
+
+class MyClass {
+public:
+  explicit MyClass(int64_t a=0) : id(a), id32(static_cast<int32_t>(a)) {}
+
+  int64_t id;
+  int32_t id32;
+
+  using id_dmp = rock::dmp<int64_t MyClass::*, &MyClass::id>;
+  using id32_dmp = rock::dmp<int32_t MyClass::*, &MyClass::id32>;
+};
+
+// small nodes to exercise splits and merges on every level
+using small_tree = rock::btree<MyClass::id32_dmp, std::less<int32_t>, 64>;
+
+
+template<typename Tree>
+static void check_order(const Tree &t) {
+  std::size_t n = 0;
+  const MyClass *prev = nullptr;
+  for (auto &c : t) {
+    if (prev) {
+      ASSERT_LT(prev->id, c.id);
+    }
+    prev = &c;
+    n++;
+  }
+  ASSERT_EQ(t.size(), n);
+}
+
+
+TEST(BTree, empty) {
+  rock::btree<MyClass::id_dmp> t;
+  EXPECT_TRUE(t.empty());
+  EXPECT_EQ(0u, t.height());
+  EXPECT_EQ(nullptr, t.find(1));
+  EXPECT_EQ(nullptr, t.erase(1));
+  EXPECT_EQ(nullptr, t.minimum());
+  EXPECT_TRUE(t.begin() == t.end());
+  EXPECT_TRUE(t.lower_bound(1) == t.end());
+}
+
+TEST(BTree, capacity) {
+  EXPECT_EQ(29u, (rock::btree<MyClass::id_dmp>::leaf_capacity));
+  EXPECT_EQ(15u, (rock::btree<MyClass::id_dmp>::inner_capacity));
+  EXPECT_EQ(4u, small_tree::inner_capacity);
+}
+
+TEST(BTree, insert_find_erase) {
+  rock::btree<MyClass::id_dmp> t;
+  MyClass c1(1);
+  MyClass c2(2);
+  MyClass c3(3);
+  EXPECT_TRUE(t.insert(c2));
+  EXPECT_TRUE(t.insert(c1));
+  EXPECT_TRUE(t.insert(c3));
+  MyClass dup(2);
+  EXPECT_FALSE(t.insert(dup));
+  EXPECT_EQ(3u, t.size());
+
+  EXPECT_EQ(&c1, t.find(1));
+  EXPECT_EQ(&c2, t.find(2));
+  EXPECT_EQ(nullptr, t.find(4));
+  EXPECT_EQ(&c1, t.minimum());
+  EXPECT_EQ(&c3, t.maximum());
+
+  EXPECT_EQ(&c2, t.erase(2));
+  EXPECT_EQ(nullptr, t.erase(2));
+  t.erase(c1);
+  EXPECT_EQ(1u, t.size());
+  EXPECT_EQ(&c3, &*t.begin());
+  t.erase(c3);
+  EXPECT_TRUE(t.empty());
+  EXPECT_EQ(0u, t.height());
+}
+
+TEST(BTree, random) {
+  std::mt19937 rng(7);
+  std::vector<MyClass> items(5000);
+  for (std::size_t i = 0; i < items.size(); i++) {
+    items[i] = MyClass(static_cast<int64_t>(i) * 3);
+  }
+  std::shuffle(items.begin(), items.end(), rng);
+
+  small_tree t;
+  std::map<int32_t, MyClass*> m;
+  for (auto &c : items) {
+    ASSERT_TRUE(t.insert(c));
+    m[c.id32] = &c;
+  }
+  EXPECT_LT(3u, t.height());
+  check_order(t);
+
+  std::vector<MyClass*> order;
+  for (auto &c : items) {
+    order.push_back(&c);
+  }
+  std::shuffle(order.begin(), order.end(), rng);
+  for (std::size_t i = 0; i < order.size(); i++) {
+    if (i % 3) {
+      ASSERT_EQ(order[i], t.erase(order[i]->id32));
+      m.erase(order[i]->id32);
+    }
+    if (i % 500 == 0) {
+      check_order(t);
+    }
+  }
+  ASSERT_EQ(m.size(), t.size());
+  check_order(t);
+  for (int32_t k = -1; k < 15001; k++) {
+    auto it = m.find(k);
+    ASSERT_EQ(it == m.end() ? nullptr : it->second, t.find(k));
+    auto lb = m.lower_bound(k);
+    auto tlb = t.lower_bound(k);
+    if (lb == m.end()) {
+      ASSERT_TRUE(tlb == t.end());
+    } else {
+      ASSERT_EQ(lb->second, &*tlb);
+    }
+  }
+
+  for (auto &e : m) {
+    ASSERT_EQ(e.second, t.erase(e.first));
+  }
+  EXPECT_TRUE(t.empty());
+}
+
+TEST(BTree, iteration) {
+  std::vector<MyClass> items;
+  for (int i = 0; i < 100; i++) {
+    items.emplace_back(i);
+  }
+  small_tree t;
+  for (auto &c : items) {
+    t.insert(c);
+  }
+
+  auto it = t.end();
+  for (int i = 99; i >= 0; i--) {
+    --it;
+    ASSERT_EQ(i, it->id32);
+  }
+  EXPECT_TRUE(it == t.begin());
+
+  std::vector<int> v;
+  t.range(10, 20, [&v](MyClass &c) { v.push_back(c.id32); });
+  ASSERT_EQ(10u, v.size());
+  EXPECT_EQ(10, v.front());
+  EXPECT_EQ(19, v.back());
+
+  v.clear();
+  t.for_each([&v](MyClass &c) { v.push_back(c.id32); return c.id32 < 4; });
+  EXPECT_EQ(5u, v.size());
+}
+
+TEST(BTree, bulk_load) {
+  for (std::size_t n : {1, 5, 6, 100, 1000, 4321}) {
+    std::vector<MyClass> items;
+    for (std::size_t i = 0; i < n; i++) {
+      items.emplace_back(static_cast<int64_t>(i) * 2);
+    }
+    small_tree t;
+    t.bulk_load(items.begin(), items.end());
+    ASSERT_EQ(n, t.size());
+    check_order(t);
+    for (std::size_t i = 0; i < n; i++) {
+      ASSERT_EQ(&items[i], t.find(static_cast<int32_t>(i * 2)));
+      ASSERT_EQ(nullptr, t.find(static_cast<int32_t>(i * 2 + 1)));
+    }
+
+    // tree stays balanced for updates after bulk load
+    std::vector<MyClass> more;
+    for (std::size_t i = 0; i < n; i++) {
+      more.emplace_back(static_cast<int64_t>(i) * 2 + 1);
+    }
+    for (auto &c : more) {
+      ASSERT_TRUE(t.insert(c));
+    }
+    for (std::size_t i = 0; i < n; i++) {
+      ASSERT_EQ(&items[i], t.erase(items[i].id32));
+    }
+    ASSERT_EQ(n, t.size());
+    check_order(t);
+  }
+}
+
+TEST(BTree, custom_compare) {
+  std::vector<MyClass> items;
+  for (int i = 0; i < 1000; i++) {
+    items.emplace_back(i);
+  }
+  rock::btree<MyClass::id_dmp, std::greater<int64_t>> t;
+  for (auto &c : items) {
+    t.insert(c);
+  }
+  EXPECT_EQ(999, t.minimum()->id);
+  EXPECT_EQ(&items[500], t.find(500));
+  EXPECT_EQ(499, t.lower_bound(499)->id);
+}
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <rock/buffer_chain.hpp>
+
+
+using rock::buffer;
+using rock::buffer_chain;
+using rock::buffer_segment;
+using rock::intrusive_ptr;
+
+
+static intrusive_ptr<buffer> make_buffer(const std::string &s) {
+  intrusive_ptr<buffer> b = buffer::create(s.size());
+  memcpy(b->data(), s.data(), s.size());
+  return b;
+}
+
+static std::string to_string(const buffer_chain &c) {
+  std::string r;
+  for (auto &s: c) {
+    r.append(s.data(), s.size());
+  }
+  return r;
+}
+
+
+TEST(BufferChain, append_prepend) {
+  buffer_chain c;
+  EXPECT_TRUE(c.empty());
+
+  c.append(make_buffer("world"), 0, 5);
+  c.prepend(make_buffer("hello "), 0, 6);
+  c.append(make_buffer("!!!"), 0, 1);
+  EXPECT_EQ(c.size(), 12u);
+  EXPECT_EQ(c.segments(), 3u);
+  EXPECT_EQ(to_string(c), "hello world!");
+
+  buffer_chain d;
+  d.append(rock::make_intrusive<buffer_segment>(make_buffer(" bye")));
+  c.append(std::move(d));
+  EXPECT_TRUE(d.empty());
+  EXPECT_EQ(to_string(c), "hello world! bye");
+
+  EXPECT_TRUE(c.begin()->is_linked());
+  intrusive_ptr<buffer_segment> s = c.pop();
+  EXPECT_FALSE(s->is_linked());
+  EXPECT_EQ(std::string(s->data(), s->size()), "hello ");
+  EXPECT_EQ(c.size(), 10u);
+
+  // popped segment can be linked again
+  c.append(s);
+  EXPECT_TRUE(s->is_linked());
+  EXPECT_EQ(to_string(c), "world! byehello ");
+}
+
+TEST(BufferChain, wrap) {
+  static const char text[] = "static response";
+  int released = 0;
+  struct Counter {
+    void release(void *) { (*count)++; }
+    int *count;
+  } counter{&released};
+
+  {
+    buffer_chain c;
+    c.append(buffer::wrap(text, sizeof(text) - 1,
+                          buffer::release_type::from<Counter, &Counter::release>(&counter)),
+             7, 8);
+    EXPECT_EQ(c.begin()->data(), text + 7);
+    EXPECT_EQ(to_string(c), "response");
+  }
+  EXPECT_EQ(released, 1);
+}
+
+TEST(BufferChain, slice) {
+  buffer_chain c;
+  intrusive_ptr<buffer> b = make_buffer("0123456789");
+  c.append(b, 0, 4);
+  c.append(b, 4, 3);
+  c.append(b, 7, 3);
+  EXPECT_EQ(b->use_count(), 4u);
+
+  buffer_chain s = c.slice(2, 6);
+  EXPECT_EQ(to_string(s), "234567");
+  EXPECT_EQ(s.segments(), 3u);
+  EXPECT_EQ(s.begin()->data(), b->data() + 2);
+  EXPECT_EQ(b->use_count(), 7u);
+
+  EXPECT_EQ(to_string(c.slice(4, 3)), "456");
+  EXPECT_TRUE(c.slice(10, 0).empty());
+}
+
+TEST(BufferChain, consume) {
+  buffer_chain c;
+  c.append(make_buffer("abc"), 0, 3);
+  c.append(make_buffer("defg"), 0, 4);
+
+  iovec iov[4];
+  EXPECT_EQ(c.to_iovec(iov, 4), 2u);
+  EXPECT_EQ(iov[1].iov_len, 4u);
+
+  c.consume(4);
+  EXPECT_EQ(c.segments(), 1u);
+  EXPECT_EQ(to_string(c), "efg");
+
+  // segment held outside the chain is not changed
+  intrusive_ptr<const buffer_segment> held(&*c.begin());
+  const buffer_segment &s = *held;
+  c.consume(1);
+  EXPECT_EQ(to_string(c), "fg");
+  EXPECT_EQ(std::string(s.data(), s.size()), "efg");
+
+  c.consume(2);
+  EXPECT_TRUE(c.empty());
+  EXPECT_EQ(c.segments(), 0u);
+}
+
+TEST(BufferChain, write_read) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  ASSERT_EQ(fcntl(fds[1], F_SETFL, O_NONBLOCK), 0);
+
+  buffer_chain out;
+  std::string data;
+  for (int i = 0; i < 100; i++) {
+    std::string s(1000, static_cast<char>('a' + i % 26));
+    out.append(make_buffer(s), 0, s.size());
+    data += s;
+  }
+
+  // pipe takes less than the whole chain, the rest is written after
+  // partial writes
+  buffer_chain in;
+  while (!out.empty()) {
+    ssize_t r = out.write_to(fds[1]);
+    if (r == -EAGAIN) {
+      ASSERT_GT(in.read_from(fds[0], 16384, 3000), 0);
+      continue;
+    }
+    ASSERT_GT(r, 0);
+  }
+  close(fds[1]);
+  for (;;) {
+    ssize_t r = in.read_from(fds[0], 65536);
+    ASSERT_GE(r, 0);
+    if (!r) {
+      break;
+    }
+  }
+  EXPECT_EQ(in.read_from(fds[0], 0), -EINVAL);
+  close(fds[0]);
+
+  EXPECT_EQ(in.size(), data.size());
+  EXPECT_TRUE(to_string(in) == data);
+}
@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <vector>
+
+#include <rock/coalescer.hpp>
+#include <rock/utils.hpp>
+
+
+class MyClass {
+public:
+  explicit MyClass(int a=0) : value(a) {}
+
+  int value;
+  rock::queue_node queue_node_;
+
+  using queue_node_dmp = rock::dmp<rock::queue_node MyClass::*, &MyClass::queue_node_>;
+};
+
+
+struct ManualClock {
+  using duration = std::chrono::microseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<ManualClock>;
+  static constexpr bool is_steady = true;
+
+  static time_point now() noexcept { return time_point(duration(ticks)); }
+  static void advance(int us) noexcept { ticks += us; }
+
+  static rep ticks;
+};
+
+ManualClock::rep ManualClock::ticks = 0;
+
+
+using Coalescer = rock::coalescer<MyClass::queue_node_dmp, ManualClock>;
+
+class Sink {
+public:
+  void consume(Coalescer::batch_type &batch, rock::flush_reason reason) {
+    std::vector<int> b;
+    while (!batch.is_empty()) {
+      b.push_back(batch.pop().value);
+    }
+    batches.push_back(b);
+    reasons.push_back(reason);
+  }
+
+  Coalescer::sink_type delegate() {
+    return Coalescer::sink_type::from<Sink, &Sink::consume>(this);
+  }
+
+  std::vector<std::vector<int>>   batches;
+  std::vector<rock::flush_reason> reasons;
+};
+
+
+TEST(Coalescer, count_limit) {
+  Sink sink;
+  Coalescer::limits l;
+  l.max_items = 3;
+  Coalescer c(sink.delegate(), l);
+
+  std::vector<MyClass> v(7);
+  for (int i = 0; i < 7; i++) {
+    v[static_cast<std::size_t>(i)].value = i;
+    c.push(v[static_cast<std::size_t>(i)]);
+  }
+  ASSERT_EQ(2u, sink.batches.size());
+  EXPECT_EQ((std::vector<int>{0, 1, 2}), sink.batches[0]);
+  EXPECT_EQ((std::vector<int>{3, 4, 5}), sink.batches[1]);
+  EXPECT_EQ(rock::flush_reason::items, sink.reasons[0]);
+  EXPECT_EQ(1u, c.size());
+
+  c.flush();
+  ASSERT_EQ(3u, sink.batches.size());
+  EXPECT_EQ((std::vector<int>{6}), sink.batches[2]);
+  EXPECT_EQ(rock::flush_reason::manual, sink.reasons[2]);
+  EXPECT_TRUE(c.empty());
+  EXPECT_EQ(3u, c.batches());
+  EXPECT_EQ(7u, c.flushed_items());
+}
+
+TEST(Coalescer, byte_limit) {
+  Sink sink;
+  Coalescer::limits l;
+  l.max_bytes = 1000;
+  Coalescer c(sink.delegate(), l);
+
+  MyClass a(1);
+  MyClass b(2);
+  c.push(a, 600);
+  EXPECT_EQ(600u, c.bytes());
+  EXPECT_TRUE(sink.batches.empty());
+  c.push(b, 600);
+  ASSERT_EQ(1u, sink.batches.size());
+  EXPECT_EQ((std::vector<int>{1, 2}), sink.batches[0]);
+  EXPECT_EQ(rock::flush_reason::bytes, sink.reasons[0]);
+  EXPECT_EQ(0u, c.bytes());
+}
+
+TEST(Coalescer, deadline) {
+  Sink sink;
+  Coalescer::limits l;
+  l.max_delay = std::chrono::microseconds(100);
+  Coalescer c(sink.delegate(), l);
+
+  EXPECT_FALSE(c.poll());
+  MyClass a(1);
+  MyClass b(2);
+  c.push(a);
+  EXPECT_EQ(ManualClock::now() + std::chrono::microseconds(100), c.deadline());
+  ManualClock::advance(60);
+  c.push(b);
+  EXPECT_FALSE(c.poll());
+  ManualClock::advance(40);
+  // deadline is set by the oldest item
+  EXPECT_TRUE(c.poll());
+  ASSERT_EQ(1u, sink.batches.size());
+  EXPECT_EQ((std::vector<int>{1, 2}), sink.batches[0]);
+  EXPECT_EQ(rock::flush_reason::deadline, sink.reasons[0]);
+  EXPECT_FALSE(c.poll());
+}
+
+TEST(Coalescer, adaptive) {
+  Sink sink;
+  Coalescer::limits l;
+  l.adaptive = true;
+  l.min_items = 2;
+  l.max_items = 16;
+  l.max_delay = std::chrono::microseconds(100);
+  Coalescer c(sink.delegate(), l);
+  EXPECT_EQ(2u, c.batch_limit());
+
+  // load: batches fill up, limit grows to max_items
+  std::vector<MyClass> v(100);
+  for (auto &o : v) {
+    c.push(o);
+  }
+  EXPECT_EQ(16u, c.batch_limit());
+  c.flush();
+
+  // idle: deadline flushes small batches, limit shrinks back
+  for (int i = 0; i < 4; i++) {
+    c.push(v[0]);
+    ManualClock::advance(100);
+    EXPECT_TRUE(c.poll());
+  }
+  EXPECT_EQ(2u, c.batch_limit());
+}
+
+TEST(Coalescer, push_from_sink) {
+  Coalescer::limits l;
+  l.max_items = 2;
+  std::vector<MyClass> v(4);
+
+  struct Forwarder {
+    Coalescer *c;
+    MyClass *extra;
+    int flushed;
+
+    void consume(Coalescer::batch_type &batch, rock::flush_reason) {
+      while (!batch.is_empty()) {
+        batch.pop();
+        flushed++;
+      }
+      if (extra) {
+        MyClass *e = extra;
+        extra = nullptr;
+        c->push(*e);
+      }
+    }
+  } f{nullptr, &v[3], 0};
+
+  Coalescer c(Coalescer::sink_type::from<Forwarder, &Forwarder::consume>(&f), l);
+  f.c = &c;
+  c.push(v[0]);
+  c.push(v[1]);
+  EXPECT_EQ(2, f.flushed);
+  EXPECT_EQ(1u, c.size());
+}
@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <rock/coro.hpp>
+
+
+using namespace rock::coro;
+
+
+namespace {
+
+task<int> answer() {
+  co_return 42;
+}
+
+task<int> add_answer(int x) {
+  int a = co_await answer();
+  co_return a + x;
+}
+
+// Runs task until its first suspension point, task keeps the frame.
+void start(task<void> &t) {
+  std::move(t).operator co_await().await_suspend(std::noop_coroutine()).resume();
+}
+
+task<void> acquire_once(async_semaphore &sm, cancellation *c, int &acquired) {
+  bool ok = co_await sm.acquire(c);
+  if (ok) {
+    acquired++;
+  }
+}
+
+task<void> locked_append(async_mutex &m, scheduler &s, std::vector<int> &out, int id) {
+  co_await m.lock();
+  out.push_back(id);
+  co_await s.schedule();
+  out.push_back(id);
+  m.unlock();
+}
+
+}
+
+
+TEST(Coro, task_chain) {
+  scheduler s;
+  int result = 0;
+  spawn(s, [](int &r) -> task<void> {
+      r = co_await add_answer(1);
+    }(result));
+  s.run();
+  EXPECT_EQ(result, 43);
+}
+
+TEST(Coro, nested_tasks) {
+  struct chain {
+    static task<int> run(int depth) {
+      if (depth == 0) {
+        co_return 0;
+      }
+      co_return co_await run(depth - 1) + 1;
+    }
+  };
+
+  scheduler s;
+  int result = 0;
+  spawn(s, [](int &r) -> task<void> {
+      r = co_await chain::run(1000);
+    }(result));
+  s.run();
+  EXPECT_EQ(result, 1000);
+}
+
+TEST(Coro, mutex) {
+  scheduler s;
+  async_mutex m(s);
+  std::vector<int> out;
+
+  for (int i = 0; i < 3; i++) {
+    spawn(s, locked_append(m, s, out, i));
+  }
+  s.run();
+
+  EXPECT_EQ(out, (std::vector<int>{0, 0, 1, 1, 2, 2}));
+  EXPECT_FALSE(m.is_locked());
+}
+
+TEST(Coro, mutex_cancel) {
+  scheduler s;
+  async_mutex m(s);
+  cancellation c;
+  bool acquired = true;
+
+  m.try_lock();
+  spawn(s, [](async_mutex &mx, cancellation &cn, bool &r) -> task<void> {
+      r = co_await mx.lock(&cn);
+    }(m, c, acquired));
+  s.run();
+  EXPECT_TRUE(c.is_waiting());
+
+  c.cancel();
+  EXPECT_FALSE(c.is_waiting());
+  s.run();
+  EXPECT_FALSE(acquired);
+
+  // cancelled waiter is not in the list anymore
+  m.unlock();
+  EXPECT_FALSE(m.is_locked());
+}
+
+TEST(Coro, semaphore) {
+  scheduler s;
+  async_semaphore sem(s, 2);
+  int running = 0;
+  int max_running = 0;
+
+  auto worker = [](scheduler &sc, async_semaphore &sm, int &cur, int &mx) -> task<void> {
+    co_await sm.acquire();
+    cur++;
+    mx = std::max(mx, cur);
+    co_await sc.schedule();
+    cur--;
+    sm.release();
+  };
+  for (int i = 0; i < 5; i++) {
+    spawn(s, worker(s, sem, running, max_running));
+  }
+  s.run();
+
+  EXPECT_EQ(max_running, 2);
+  EXPECT_EQ(running, 0);
+  EXPECT_EQ(sem.count(), 2u);
+}
+
+TEST(Coro, semaphore_destroy_waiter) {
+  scheduler s;
+  async_semaphore sem(s, 0);
+  cancellation c;
+  int acquired = 0;
+
+  task<void> t1 = acquire_once(sem, &c, acquired);
+  task<void> t2 = acquire_once(sem, nullptr, acquired);
+  start(t1);
+  start(t2);
+  EXPECT_TRUE(c.is_waiting());
+
+  // parked frame leaves the waiter list and the cancellation slot
+  t1 = task<void>();
+  EXPECT_FALSE(c.is_waiting());
+  c.cancel();
+
+  // woken frame leaves the ready queue
+  sem.release();
+  t2 = task<void>();
+  EXPECT_TRUE(s.is_empty());
+
+  sem.release();
+  EXPECT_EQ(sem.count(), 1u);
+  s.run();
+  EXPECT_EQ(acquired, 0);
+}
+
+TEST(Coro, event) {
+  scheduler s;
+  async_event e(s);
+  int woken = 0;
+
+  auto waiter = [](async_event &ev, int &w) -> task<void> {
+    co_await ev.wait();
+    w++;
+  };
+  spawn(s, waiter(e, woken));
+  spawn(s, waiter(e, woken));
+  s.run();
+  EXPECT_EQ(woken, 0);
+
+  e.set();
+  s.run();
+  EXPECT_EQ(woken, 2);
+
+  spawn(s, waiter(e, woken));
+  s.run();
+  EXPECT_EQ(woken, 3);
+}
+
+TEST(Coro, channel) {
+  scheduler s;
+  channel<std::string> ch(s);
+  std::vector<std::string> received;
+
+  spawn(s, [](channel<std::string> &c) -> task<void> {
+      co_await c.send("a");
+      co_await c.send("b");
+      c.close();
+    }(ch));
+  spawn(s, [](channel<std::string> &c, std::vector<std::string> &out) -> task<void> {
+      while (auto v = co_await c.receive()) {
+        out.push_back(*v);
+      }
+    }(ch, received));
+  s.run();
+
+  EXPECT_EQ(received, (std::vector<std::string>{"a", "b"}));
+  EXPECT_TRUE(ch.is_closed());
+}
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include <rock/delegate.hpp>
+
+
+namespace {
+
+class Counter {
+public:
+  int add(int x) { return value += x; }
+  int get(int x) const { return value * x; }
+
+  int value = 0;
+};
+
+int negate(int x) {
+  return -x;
+}
+
+Counter global_counter;
+
+}
+
+using Delegate = rock::delegate<int (int)>;
+
+
+TEST(Delegate, empty) {
+  Delegate d;
+  EXPECT_FALSE(d);
+}
+
+TEST(Delegate, method) {
+  Counter c;
+  auto d = Delegate::from<Counter, &Counter::add>(&c);
+  EXPECT_TRUE(d);
+  EXPECT_EQ(d(2), 2);
+  EXPECT_EQ(d(3), 5);
+  EXPECT_EQ(c.value, 5);
+}
+
+TEST(Delegate, const_method) {
+  Counter c;
+  c.value = 3;
+  const Counter *cc = &c;
+  auto d = Delegate::from<Counter, &Counter::get>(cc);
+  EXPECT_EQ(d(2), 6);
+}
+
+TEST(Delegate, function) {
+  auto d = Delegate::from<&negate>();
+  EXPECT_EQ(d(4), -4);
+}
+
+TEST(Delegate, bind) {
+  Counter c;
+  Delegate d;
+  d.bind<Counter, &Counter::add>(&c);
+  EXPECT_EQ(d(1), 1);
+
+  d.bind<&negate>();
+  EXPECT_EQ(d(1), -1);
+
+  d.clear();
+  EXPECT_FALSE(d);
+}
+
+TEST(Delegate, constexpr_construction) {
+  static constexpr Delegate d = Delegate::from<Counter, &Counter::add>(&global_counter);
+  global_counter.value = 0;
+  EXPECT_EQ(d(7), 7);
+}
+
+TEST(Delegate, compare) {
+  Counter c1;
+  Counter c2;
+  auto d1 = Delegate::from<Counter, &Counter::add>(&c1);
+  auto d2 = Delegate::from<Counter, &Counter::add>(&c1);
+  auto d3 = Delegate::from<Counter, &Counter::add>(&c2);
+  EXPECT_TRUE(d1 == d2);
+  EXPECT_TRUE(d1 != d3);
+  EXPECT_TRUE((d1 < d3) != (d3 < d1));
+}
+
+#if __cplusplus >= 201703L
+TEST(Delegate, auto_bind) {
+  Counter c;
+  Delegate d;
+  d.bind<&Counter::add>(&c);
+  EXPECT_EQ(d(2), 2);
+
+  auto g = Delegate::from<&Counter::get>(&c);
+  EXPECT_EQ(g(3), 6);
+}
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__)
+TEST(Delegate, runtime_bind) {
+  Counter c;
+  Delegate d;
+  d.bind(&c, &Counter::add);
+  EXPECT_EQ(d(5), 5);
+  EXPECT_EQ(c.value, 5);
+}
+#endif
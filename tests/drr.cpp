@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <vector>
+
+#include <rock/drr.hpp>
+#include <rock/utils.hpp>
+
+
+class Packet {
+public:
+  Packet(int f=0, uint32_t s=0) : flow(f), size(s) {}
+  Packet(const Packet &o) : flow(o.flow), size(o.size) {}
+
+  int flow;
+  uint32_t size;
+  rock::queue_node queue_node_;
+
+  using size_dmp = rock::dmp<uint32_t Packet::*, &Packet::size>;
+  using queue_node_dmp = rock::dmp<rock::queue_node Packet::*, &Packet::queue_node_>;
+};
+
+using drr = rock::drr_scheduler<Packet::queue_node_dmp, Packet::size_dmp>;
+using wrr = rock::drr_scheduler<Packet::queue_node_dmp>;
+
+
+TEST(Drr, empty) {
+  drr s;
+  EXPECT_TRUE(s.empty());
+  EXPECT_EQ(nullptr, s.dequeue());
+}
+
+TEST(Drr, single_flow_fifo) {
+  drr s;
+  drr::flow_type f(100);
+  Packet p1(0, 10);
+  Packet p2(0, 200);
+  Packet p3(0, 10);
+  s.enqueue(f, p1);
+  s.enqueue(f, p2);
+  s.enqueue(f, p3);
+  EXPECT_EQ(3u, s.size());
+  EXPECT_EQ(220u, f.backlog());
+  EXPECT_TRUE(f.active());
+
+  EXPECT_EQ(&p1, s.dequeue());
+  EXPECT_EQ(&p2, s.dequeue());
+  EXPECT_EQ(&p3, s.dequeue());
+  EXPECT_EQ(nullptr, s.dequeue());
+  EXPECT_FALSE(f.active());
+  EXPECT_EQ(0u, f.deficit());
+}
+
+TEST(Drr, fair_bytes) {
+  // noisy flow with large packets doesn't starve the small one
+  drr s;
+  drr::flow_type noisy(1500);
+  drr::flow_type quiet(1500);
+  std::vector<Packet> big(100, Packet(0, 1500));
+  std::vector<Packet> small(300, Packet(1, 100));
+  for (auto &p : big) {
+    s.enqueue(noisy, p);
+  }
+  for (auto &p : small) {
+    s.enqueue(quiet, p);
+  }
+
+  uint64_t bytes[2] = {0, 0};
+  for (int i = 0; i < 100; i++) {
+    Packet *p = s.dequeue();
+    ASSERT_NE(nullptr, p);
+    bytes[p->flow] += p->size;
+  }
+  EXPECT_NEAR(static_cast<double>(bytes[0]), static_cast<double>(bytes[1]), 1500);
+}
+
+TEST(Drr, weighted) {
+  drr s;
+  drr::flow_type heavy(3000);
+  drr::flow_type light(1000);
+  std::vector<Packet> a(1000, Packet(0, 500));
+  std::vector<Packet> b(1000, Packet(1, 500));
+  for (std::size_t i = 0; i < a.size(); i++) {
+    s.enqueue(heavy, a[i]);
+    s.enqueue(light, b[i]);
+  }
+  int count[2] = {0, 0};
+  for (int i = 0; i < 400; i++) {
+    count[s.dequeue()->flow]++;
+  }
+  EXPECT_EQ(300, count[0]);
+  EXPECT_EQ(100, count[1]);
+}
+
+TEST(Drr, round_robin_packets) {
+  wrr s;
+  wrr::flow_type f0(2);
+  wrr::flow_type f1(1);
+  std::vector<Packet> a(4, Packet(0));
+  std::vector<Packet> b(4, Packet(1));
+  for (std::size_t i = 0; i < a.size(); i++) {
+    s.enqueue(f0, a[i]);
+    s.enqueue(f1, b[i]);
+  }
+  std::vector<int> order;
+  while (Packet *p = s.dequeue()) {
+    order.push_back(p->flow);
+  }
+  EXPECT_EQ((std::vector<int>{0, 0, 1, 0, 0, 1, 1, 1}), order);
+}
+
+TEST(Drr, reactivation_resets_deficit) {
+  drr s;
+  drr::flow_type f0(1000);
+  drr::flow_type f1(1000);
+  Packet p0(0, 10);
+  s.enqueue(f0, p0);
+  EXPECT_EQ(&p0, s.dequeue());
+  EXPECT_EQ(0u, f0.deficit());
+
+  Packet q0(0, 1000);
+  Packet q1(0, 1000);
+  Packet r0(1, 1000);
+  s.enqueue(f0, q0);
+  s.enqueue(f0, q1);
+  s.enqueue(f1, r0);
+  EXPECT_EQ(&q0, s.dequeue());
+  EXPECT_EQ(&r0, s.dequeue());
+  EXPECT_EQ(&q1, s.dequeue());
+}
+
+TEST(Drr, remove) {
+  drr s;
+  drr::flow_type f0;
+  drr::flow_type f1;
+  Packet a(0, 10);
+  Packet b(0, 10);
+  Packet c(1, 10);
+  s.enqueue(f0, a);
+  s.enqueue(f0, b);
+  s.enqueue(f1, c);
+
+  rock::queue<Packet::queue_node_dmp> dropped;
+  s.remove(f0, dropped);
+  EXPECT_EQ(1u, s.size());
+  EXPECT_FALSE(f0.active());
+  EXPECT_EQ(&a, &dropped.pop());
+  EXPECT_EQ(&b, &dropped.pop());
+  EXPECT_EQ(&c, s.dequeue());
+  EXPECT_TRUE(s.empty());
+}
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <rock/epoch.hpp>
+#include <rock/utils.hpp>
+
+
+class Retired {
+public:
+  int reclaimed = 0;
+  rock::epoch_node epoch_node_;
+
+  void on_reclaim(rock::epoch_node &n) {
+    EXPECT_EQ(&epoch_node_, &n);
+    reclaimed++;
+  }
+
+  rock::epoch_node::reclaim_type reclaim() {
+    return rock::epoch_node::reclaim_type::from<Retired, &Retired::on_reclaim>(this);
+  }
+};
+
+
+TEST(Epoch, guard_nesting) {
+  EXPECT_FALSE(rock::epoch::pinned());
+  {
+    rock::epoch_guard g1;
+    EXPECT_TRUE(rock::epoch::pinned());
+    {
+      rock::epoch_guard g2;
+      EXPECT_TRUE(rock::epoch::pinned());
+    }
+    EXPECT_TRUE(rock::epoch::pinned());
+  }
+  EXPECT_FALSE(rock::epoch::pinned());
+}
+
+TEST(Epoch, grace_period) {
+  Retired r;
+  rock::epoch::retire(r.epoch_node_, r.reclaim());
+  // needs two epoch advances
+  rock::epoch::reclaim();
+  rock::epoch::reclaim();
+  EXPECT_EQ(1, r.reclaimed);
+  EXPECT_EQ(0u, rock::epoch::reclaim());
+}
+
+TEST(Epoch, reader_blocks_reclaim) {
+  Retired r;
+  std::atomic<int> state{0};
+  std::thread reader([&state]() {
+      rock::epoch_guard g;
+      state = 1;
+      while (state != 2) {
+        std::this_thread::yield();
+      }
+    });
+  while (state != 1) {
+    std::this_thread::yield();
+  }
+
+  rock::epoch::retire(r.epoch_node_, r.reclaim());
+  for (int i = 0; i < 10; i++) {
+    rock::epoch::reclaim();
+  }
+  EXPECT_EQ(0, r.reclaimed);
+
+  state = 2;
+  reader.join();
+  while (!r.reclaimed) {
+    rock::epoch::reclaim();
+  }
+  EXPECT_EQ(1, r.reclaimed);
+}
+
+TEST(Epoch, batch) {
+  std::vector<Retired> items(rock::epoch::reclaim_batch * 3);
+  for (auto &r : items) {
+    rock::epoch::retire(r.epoch_node_, r.reclaim());
+  }
+  rock::epoch::reclaim();
+  rock::epoch::reclaim();
+  for (auto &r : items) {
+    EXPECT_EQ(1, r.reclaimed);
+  }
+}
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include <rock/inplace_function.hpp>
+
+
+using Function = rock::inplace_function<int (int)>;
+
+
+static int twice(int x) {
+  return x * 2;
+}
+
+
+TEST(InplaceFunction, empty) {
+  Function f;
+  EXPECT_FALSE(f);
+
+  Function g(nullptr);
+  EXPECT_FALSE(g);
+}
+
+TEST(InplaceFunction, free_function) {
+  Function f(&twice);
+  EXPECT_TRUE(f);
+  EXPECT_EQ(f(21), 42);
+}
+
+TEST(InplaceFunction, lambda_capture) {
+  int base = 10;
+  Function f([base](int x) { return base + x; });
+  EXPECT_EQ(f(5), 15);
+}
+
+TEST(InplaceFunction, mutable_state) {
+  int counter = 0;
+  Function g([counter](int x) mutable { return counter += x; });
+  EXPECT_EQ(g(1), 1);
+  EXPECT_EQ(g(2), 3);
+}
+
+namespace {
+
+class MoveOnly {
+public:
+  explicit MoveOnly(int v) : p_(new int(v)) {}
+
+  int operator()(int x) const { return *p_ + x; }
+
+private:
+  std::unique_ptr<int> p_;
+};
+
+}
+
+TEST(InplaceFunction, move_only_capture) {
+  Function f(MoveOnly(7));
+  EXPECT_EQ(f(1), 8);
+
+  Function g(std::move(f));
+  EXPECT_FALSE(f);
+  EXPECT_EQ(g(2), 9);
+}
+
+TEST(InplaceFunction, destroys_callable) {
+  std::shared_ptr<int> p(new int(1));
+  {
+    Function f([p](int x) { return *p + x; });
+    EXPECT_EQ(p.use_count(), 2);
+
+    Function g;
+    g = std::move(f);
+    EXPECT_EQ(p.use_count(), 2);
+
+    g = nullptr;
+    EXPECT_EQ(p.use_count(), 1);
+    EXPECT_FALSE(g);
+  }
+  EXPECT_EQ(p.use_count(), 1);
+}
+
+TEST(InplaceFunction, reassign) {
+  Function f(&twice);
+  f = [](int x) { return x + 1; };
+  EXPECT_EQ(f(1), 2);
+}
+
+TEST(InplaceFunction, capacity) {
+  struct Big {
+    char data[64];
+    int operator()(int x) const { return x + data[0]; }
+  };
+  rock::inplace_function<int (int), 64> f(Big{{1}});
+  EXPECT_EQ(f(1), 2);
+}
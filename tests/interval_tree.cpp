@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <rock/interval_tree.hpp>
+#include <rock/utils.hpp>
+
+
+class Range {
+public:
+  Range(uint64_t b=0, uint64_t e=0) : begin(b), end(e) {}
+
+  uint64_t begin;
+  uint64_t end;
+  rock::interval_node<uint64_t> node_;
+
+  using node_dmp = rock::dmp<rock::interval_node<uint64_t> Range::*, &Range::node_>;
+  using begin_dmp = rock::dmp<uint64_t Range::*, &Range::begin>;
+  using end_dmp = rock::dmp<uint64_t Range::*, &Range::end>;
+};
+
+using Ranges = rock::interval_tree<Range::node_dmp, Range::begin_dmp, Range::end_dmp>;
+
+
+static std::vector<Range*> overlapping(Ranges &t, uint64_t lo, uint64_t hi) {
+  std::vector<Range*> r;
+  t.overlap(lo, hi, [&r](Range &o) { r.push_back(&o); });
+  return r;
+}
+
+
+TEST(IntervalTree, empty) {
+  Ranges t;
+  EXPECT_TRUE(t.empty());
+  EXPECT_EQ(nullptr, t.minimum());
+  EXPECT_EQ(nullptr, t.find_overlap(0, 100));
+  EXPECT_TRUE(overlapping(t, 0, 100).empty());
+}
+
+TEST(IntervalTree, overlap) {
+  Ranges t;
+  Range r1(10, 20);
+  Range r2(15, 30);
+  Range r3(40, 50);
+  Range r4(5, 8);
+  t.insert(r1);
+  t.insert(r2);
+  t.insert(r3);
+  t.insert(r4);
+  EXPECT_EQ(4u, t.size());
+  EXPECT_TRUE(r1.node_.is_linked());
+  EXPECT_EQ(&r4, t.minimum());
+  EXPECT_EQ(50u, t.max_end());
+
+  EXPECT_EQ((std::vector<Range*>{&r1, &r2}), overlapping(t, 18, 25));
+  EXPECT_EQ((std::vector<Range*>{&r4, &r1, &r2, &r3}), overlapping(t, 0, 100));
+  // half-open intervals
+  EXPECT_TRUE(overlapping(t, 30, 40).empty());
+  EXPECT_EQ((std::vector<Range*>{&r2}), overlapping(t, 29, 40));
+  EXPECT_EQ(&r4, t.find_overlap(0, 11));
+  EXPECT_FALSE(t.overlaps(50, 60));
+
+  std::vector<Range*> s;
+  t.stab(15, [&s](Range &o) { s.push_back(&o); });
+  EXPECT_EQ((std::vector<Range*>{&r1, &r2}), s);
+  s.clear();
+  t.stab(20, [&s](Range &o) { s.push_back(&o); });
+  EXPECT_EQ((std::vector<Range*>{&r2}), s);
+
+  t.erase(r2);
+  EXPECT_FALSE(r2.node_.is_linked());
+  EXPECT_EQ((std::vector<Range*>{&r1}), overlapping(t, 18, 25));
+  t.erase(r3);
+  EXPECT_EQ(20u, t.max_end());
+
+  t.clear();
+  EXPECT_TRUE(t.empty());
+  EXPECT_FALSE(r1.node_.is_linked());
+}
+
+TEST(IntervalTree, early_stop) {
+  Ranges t;
+  std::vector<Range> v(10);
+  for (uint64_t i = 0; i < v.size(); i++) {
+    v[i].begin = i;
+    v[i].end = 100;
+    t.insert(v[i]);
+  }
+  int n = 0;
+  t.overlap(0, 100, [&n](Range&) { return ++n < 3; });
+  EXPECT_EQ(3, n);
+  n = 0;
+  t.for_each([&n](Range&) { n++; });
+  EXPECT_EQ(10, n);
+}
+
+TEST(IntervalTree, random) {
+  Ranges t;
+  std::vector<Range> v(2000);
+  std::vector<bool> linked(v.size());
+  std::mt19937_64 rng(7);
+
+  for (int round = 0; round < 20000; round++) {
+    std::size_t i = rng() % v.size();
+    if (linked[i]) {
+      t.erase(v[i]);
+      linked[i] = false;
+    } else {
+      v[i].begin = rng() % 100000;
+      v[i].end = v[i].begin + rng() % 1000;
+      t.insert(v[i]);
+      linked[i] = true;
+    }
+
+    if (round % 500 == 0) {
+      uint64_t lo = rng() % 100000;
+      uint64_t hi = lo + rng() % 2000;
+      std::vector<Range*> expected;
+      for (std::size_t j = 0; j < v.size(); j++) {
+        if (linked[j] && v[j].begin < hi && lo < v[j].end) {
+          expected.push_back(&v[j]);
+        }
+      }
+      std::vector<Range*> got = overlapping(t, lo, hi);
+      ASSERT_TRUE(std::is_sorted(got.begin(), got.end(),
+                                 [](Range *a, Range *b) { return a->begin < b->begin; }));
+      std::sort(expected.begin(), expected.end());
+      std::sort(got.begin(), got.end());
+      ASSERT_EQ(expected, got);
+
+      uint64_t max_end = 0;
+      std::size_t n = 0;
+      for (std::size_t j = 0; j < v.size(); j++) {
+        if (linked[j]) {
+          max_end = std::max(max_end, v[j].end);
+          n++;
+        }
+      }
+      ASSERT_EQ(n, t.size());
+      if (n) {
+        ASSERT_EQ(max_end, t.max_end());
+      }
+    }
+  }
+}
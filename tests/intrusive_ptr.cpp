@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include <rock/intrusive_ptr.hpp>
+#include <rock/list.hpp>
+#include <rock/queue.hpp>
+#include <rock/utils.hpp>
+
+
+template<typename Policy>
+class Object : public rock::ref_counted<Object<Policy>, Policy> {
+public:
+  explicit Object(int v=0) : value(v) { alive++; }
+  ~Object() { alive--; }
+
+  int value;
+  rock::list_node list_node_;
+  rock::queue_node queue_node_;
+
+  using list_node_dmp = rock::dmp<rock::list_node Object::*, &Object::list_node_>;
+  using queue_node_dmp = rock::dmp<rock::queue_node Object::*, &Object::queue_node_>;
+
+  static int alive;
+};
+
+template<typename Policy>
+int Object<Policy>::alive = 0;
+
+
+template<typename Policy>
+class IntrusivePtr : public ::testing::Test {};
+
+typedef ::testing::Types<rock::refcount_plain, rock::refcount_atomic, rock::refcount_biased> Policies;
+TYPED_TEST_CASE(IntrusivePtr, Policies);
+
+
+TYPED_TEST(IntrusivePtr, basic) {
+  using O = Object<TypeParam>;
+  {
+    rock::intrusive_ptr<O> p = rock::make_intrusive<O>(5);
+    EXPECT_EQ(1, O::alive);
+    EXPECT_EQ(1u, p->use_count());
+    EXPECT_EQ(5, (*p).value);
+
+    rock::intrusive_ptr<O> q = p;
+    EXPECT_EQ(2u, p->use_count());
+    EXPECT_TRUE(p == q);
+
+    rock::intrusive_ptr<O> r = std::move(q);
+    EXPECT_FALSE(q);
+    EXPECT_EQ(2u, p->use_count());
+
+    r.reset();
+    EXPECT_EQ(1u, p->use_count());
+
+    O *raw = p.detach();
+    EXPECT_FALSE(p);
+    EXPECT_EQ(1, O::alive);
+    rock::intrusive_ptr<O> adopted(raw, rock::adopt_ref);
+    EXPECT_EQ(1u, adopted->use_count());
+  }
+  EXPECT_EQ(0, O::alive);
+}
+
+TYPED_TEST(IntrusivePtr, owning_list) {
+  using O = Object<TypeParam>;
+  {
+    rock::owning<rock::list<typename O::list_node_dmp>> l;
+    for (int i = 0; i < 3; i++) {
+      l.push_back(rock::make_intrusive<O>(i));
+    }
+    EXPECT_EQ(3, O::alive);
+    EXPECT_FALSE(l.container().empty());
+
+    rock::intrusive_ptr<O> first = l.pop_front();
+    EXPECT_EQ(0, first->value);
+    EXPECT_EQ(1u, first->use_count());
+    first.reset();
+    EXPECT_EQ(2, O::alive);
+
+    O &back = l.back();
+    rock::intrusive_ptr<O> keep(&back);
+    EXPECT_EQ(2u, keep->use_count());
+    l.erase(back);
+    EXPECT_EQ(1u, keep->use_count());
+    EXPECT_EQ(2, O::alive);
+  }
+  // remaining element released by the container
+  EXPECT_EQ(0, O::alive);
+}
+
+TYPED_TEST(IntrusivePtr, owning_queue) {
+  using O = Object<TypeParam>;
+  {
+    rock::owning<rock::queue<typename O::queue_node_dmp>> q;
+    q.push(rock::make_intrusive<O>(1));
+    q.push(rock::make_intrusive<O>(2));
+    EXPECT_EQ(1, q.pop()->value);
+    EXPECT_EQ(1, O::alive);
+  }
+  EXPECT_EQ(0, O::alive);
+}
+
+
+TEST(IntrusivePtrThreads, atomic_and_biased) {
+  using A = Object<rock::refcount_atomic>;
+  using B = Object<rock::refcount_biased>;
+  rock::intrusive_ptr<A> a = rock::make_intrusive<A>();
+  rock::intrusive_ptr<B> b = rock::make_intrusive<B>();
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([a, b]() {
+        for (int i = 0; i < 10000; i++) {
+          rock::intrusive_ptr<A> a1 = a;
+          rock::intrusive_ptr<B> b1 = b;
+        }
+      });
+  }
+  // owner keeps taking references through the biased counter
+  for (int i = 0; i < 10000; i++) {
+    rock::intrusive_ptr<B> b1 = b;
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  // captures were copied by the owner and released by the threads
+  EXPECT_EQ(1u, rock::refcount_biased::collect());
+  EXPECT_EQ(0u, rock::refcount_biased::collect());
+  EXPECT_EQ(1u, a->use_count());
+  EXPECT_EQ(1u, b->use_count());
+  a.reset();
+  b.reset();
+  EXPECT_EQ(0, A::alive);
+  EXPECT_EQ(0, B::alive);
+}
+
+TEST(IntrusivePtrThreads, biased_owner_releases_first) {
+  using B = Object<rock::refcount_biased>;
+  rock::intrusive_ptr<B> b = rock::make_intrusive<B>();
+  rock::intrusive_ptr<B> other = b;
+  std::thread t([&other]() {
+      rock::intrusive_ptr<B> mine = std::move(other);
+      EXPECT_EQ(1, B::alive);
+    });
+  t.join();
+  EXPECT_EQ(1, B::alive);
+
+  // owner hands its last reference to another thread
+  std::thread t2([](rock::intrusive_ptr<B> p) {
+      rock::intrusive_ptr<B> copy = p;
+      p.reset();
+      EXPECT_EQ(1, B::alive);
+    }, std::move(b));
+  t2.join();
+  EXPECT_EQ(1, B::alive);
+  EXPECT_EQ(1u, rock::refcount_biased::collect());
+  EXPECT_EQ(0, B::alive);
+}
+
+TEST(IntrusivePtrThreads, biased_owner_exits) {
+  using B = Object<rock::refcount_biased>;
+  rock::intrusive_ptr<B> b;
+  std::thread t([&b]() {
+      b = rock::make_intrusive<B>();
+      rock::intrusive_ptr<B> copy = b;
+    });
+  t.join();
+  EXPECT_EQ(1, B::alive);
+  EXPECT_EQ(1u, b->use_count());
+
+  // merged by the releasing thread
+  rock::intrusive_ptr<B> copy = b;
+  b.reset();
+  EXPECT_EQ(1, B::alive);
+  copy.reset();
+  EXPECT_EQ(0, B::alive);
+}
@@ -1,5 +1,11 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <vector>
+
 #include <rock/list.hpp>
 #include <rock/utils.hpp>
 
@@ -150,3 +156,168 @@ TEST(List, unlink) {
   mc1.unlink();
   EXPECT_TRUE(l.empty());
 }
+
+TEST(List, reverse_iterators) {
+  Container l;
+  MyClass mc1(1);
+  MyClass mc2(2);
+
+  l.push_back(mc1);
+  l.push_back(mc2);
+
+  auto i = l.rbegin();
+  EXPECT_EQ(i->i, 2);
+  ++i;
+  EXPECT_EQ(i->i, 1);
+  ++i;
+  EXPECT_EQ(i, l.rend());
+}
+
+TEST(List, sort) {
+  Container l;
+  std::vector<std::unique_ptr<MyClass>> items;
+  std::mt19937 rng(1);
+  for (int i = 0; i < 10000; i++) {
+    items.emplace_back(new MyClass(static_cast<int>(rng() % 1000)));
+    l.push_back(*items.back());
+  }
+
+  l.sort([](const MyClass &a, const MyClass &b) { return a.i < b.i; });
+
+  // stable: equal keys keep insertion order
+  std::vector<MyClass*> expected;
+  for (auto &p: items) {
+    expected.push_back(p.get());
+  }
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const MyClass *a, const MyClass *b) { return a->i < b->i; });
+
+  std::size_t n = 0;
+  for (auto &a: l) {
+    EXPECT_EQ(&a, expected[n++]);
+  }
+  EXPECT_EQ(n, expected.size());
+
+  // prev links are restored
+  n = expected.size();
+  for (auto i = l.rbegin(); i != l.rend(); ++i) {
+    EXPECT_EQ(&*i, expected[--n]);
+  }
+}
+
+TEST(List, merge) {
+  Container l1;
+  Container l2;
+  MyClass mc[6];
+  const int keys[] = {1, 3, 5, 2, 3, 6};
+  for (int i = 0; i < 6; i++) {
+    mc[i].i = keys[i];
+  }
+  for (int i = 0; i < 3; i++) {
+    l1.push_back(mc[i]);
+    l2.push_back(mc[i + 3]);
+  }
+
+  auto less = [](const MyClass &a, const MyClass &b) { return a.i < b.i; };
+  l1.merge(l2, less);
+  EXPECT_TRUE(l2.empty());
+
+  std::vector<MyClass*> order;
+  for (auto &a: l1) {
+    order.push_back(&a);
+  }
+  EXPECT_EQ(order, (std::vector<MyClass*>{&mc[0], &mc[3], &mc[1], &mc[4], &mc[2], &mc[5]}));
+  EXPECT_EQ(&l1.back(), &mc[5]);
+}
+
+TEST(List, unique) {
+  Container l;
+  MyClass mc[5];
+  const int keys[] = {1, 1, 2, 2, 1};
+  for (int i = 0; i < 5; i++) {
+    mc[i].i = keys[i];
+  }
+  for (auto &m: mc) {
+    l.push_back(m);
+  }
+
+  std::vector<MyClass*> removed;
+  auto n = l.unique([](const MyClass &a, const MyClass &b) { return a.i == b.i; },
+                    [&removed](MyClass &m) { removed.push_back(&m); });
+  EXPECT_EQ(n, 2u);
+  EXPECT_EQ(removed, (std::vector<MyClass*>{&mc[1], &mc[3]}));
+
+  std::vector<int> values;
+  for (auto &a: l) {
+    values.push_back(a.i);
+  }
+  EXPECT_EQ(values, (std::vector<int>{1, 2, 1}));
+}
+
+TEST(List, reverse) {
+  Container l;
+  MyClass mc[3];
+  const int keys[] = {1, 2, 3};
+  for (int i = 0; i < 3; i++) {
+    mc[i].i = keys[i];
+  }
+  for (auto &m: mc) {
+    l.push_back(m);
+  }
+
+  l.reverse();
+  EXPECT_EQ(&l.front(), &mc[2]);
+  EXPECT_EQ(&l.back(), &mc[0]);
+  EXPECT_EQ(&l.pop_front(), &mc[2]);
+  EXPECT_EQ(&l.pop_front(), &mc[1]);
+  EXPECT_EQ(&l.pop_front(), &mc[0]);
+  EXPECT_TRUE(l.empty());
+}
+
+TEST(List, relink_by_address) {
+  Container l;
+  MyClass mc[5];
+  const int order[] = {3, 0, 4, 1, 2};
+  for (int i: order) {
+    mc[i].i = i;
+    l.push_back(mc[i]);
+  }
+
+  l.relink_by_address();
+  int i = 0;
+  for (auto &a: l) {
+    EXPECT_EQ(&a, &mc[i++]);
+  }
+  EXPECT_EQ(i, 5);
+  EXPECT_EQ(&l.back(), &mc[4]);
+  EXPECT_EQ(&l.pop_back(), &mc[4]);
+  EXPECT_EQ(&l.pop_back(), &mc[3]);
+}
+
+TEST(List, relocate_from) {
+  static_assert(!std::is_move_constructible<rock::list_node>::value,
+                "list_node is relocated only explicitly");
+
+  Container l;
+  MyClass mc1(1);
+  MyClass mc2(2);
+  MyClass mc3(3);
+  l.push_back(mc1);
+  l.push_back(mc2);
+  l.push_back(mc3);
+
+  std::unique_ptr<MyClass> moved(new MyClass(2));
+  MyClass::list_node_dmp::to_member(moved.get())->relocate_from(*MyClass::list_node_dmp::to_member(&mc2));
+  std::vector<MyClass*> items;
+  for (auto &a: l) {
+    items.push_back(&a);
+  }
+  EXPECT_EQ(items, (std::vector<MyClass*>{&mc1, moved.get(), &mc3}));
+
+  // old node is left unlinked
+  mc2.unlink();
+  EXPECT_EQ(&l.pop_back(), &mc3);
+  EXPECT_EQ(&l.pop_back(), moved.get());
+  EXPECT_EQ(&l.pop_back(), &mc1);
+  EXPECT_TRUE(l.empty());
+}
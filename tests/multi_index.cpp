@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <rock/multi_index.hpp>
+#include <rock/utils.hpp>
+
+
+class Session {
+public:
+  explicit Session(uint64_t i=0, uint64_t e=0) : id(i), expires(e) {}
+
+  uint64_t id;
+  uint64_t expires;
+
+  rock::list_node lru_node_;
+  rock::chain_node bucket_node_;
+
+  using id_dmp = rock::dmp<uint64_t Session::*, &Session::id>;
+  using expires_dmp = rock::dmp<uint64_t Session::*, &Session::expires>;
+  using lru_dmp = rock::dmp<rock::list_node Session::*, &Session::lru_node_>;
+  using bucket_dmp = rock::dmp<rock::chain_node Session::*, &Session::bucket_node_>;
+};
+
+using Sessions = rock::multi_index<Session,
+                                   rock::list<Session::lru_dmp>,
+                                   rock::swiss_index<Session::id_dmp>,
+                                   rock::art<Session::expires_dmp>,
+                                   rock::chain<Session::bucket_dmp>>;
+
+enum { by_lru, by_id, by_expiry, by_bucket };
+
+
+static std::vector<uint64_t> lru_ids(Sessions &s) {
+  std::vector<uint64_t> r;
+  for (auto &i : s.get<by_lru>()) {
+    r.push_back(i.id);
+  }
+  return r;
+}
+
+
+TEST(MultiIndex, insert_erase) {
+  Sessions s;
+  EXPECT_TRUE(s.empty());
+
+  Session s1(1, 100);
+  Session s2(2, 50);
+  Session s3(3, 75);
+  EXPECT_TRUE(s.insert(s1));
+  EXPECT_TRUE(s.insert(s2));
+  EXPECT_TRUE(s.insert(s3));
+  EXPECT_EQ(3u, s.size());
+
+  EXPECT_EQ(&s2, s.get<by_id>().find(2));
+  EXPECT_EQ(&s2, s.get<by_expiry>().minimum());
+  EXPECT_EQ(&s1, s.get<by_expiry>().maximum());
+  EXPECT_EQ((std::vector<uint64_t>{1, 2, 3}), lru_ids(s));
+  EXPECT_FALSE(s.get<by_bucket>().empty());
+
+  s.erase(s2);
+  EXPECT_EQ(2u, s.size());
+  EXPECT_EQ(nullptr, s.get<by_id>().find(2));
+  EXPECT_EQ(nullptr, s.get<by_expiry>().find(50));
+  EXPECT_EQ(&s3, s.get<by_expiry>().minimum());
+  EXPECT_EQ((std::vector<uint64_t>{1, 3}), lru_ids(s));
+
+  s.erase(s1);
+  s.erase(s3);
+  EXPECT_TRUE(s.empty());
+  EXPECT_TRUE(s.get<by_lru>().empty());
+  EXPECT_TRUE(s.get<by_id>().empty());
+  EXPECT_TRUE(s.get<by_expiry>().empty());
+  EXPECT_TRUE(s.get<by_bucket>().empty());
+}
+
+TEST(MultiIndex, insert_rollback) {
+  Sessions s;
+  Session s1(1, 100);
+  Session s2(2, 100);   // expiry collides
+  Session s3(1, 200);   // id collides
+  EXPECT_TRUE(s.insert(s1));
+  EXPECT_FALSE(s.insert(s2));
+  EXPECT_FALSE(s.insert(s3));
+  EXPECT_EQ(1u, s.size());
+  EXPECT_EQ(nullptr, s.get<by_id>().find(2));
+  EXPECT_EQ(&s1, s.get<by_id>().find(1));
+  EXPECT_EQ(nullptr, s.get<by_expiry>().find(200));
+  EXPECT_EQ((std::vector<uint64_t>{1}), lru_ids(s));
+}
+
+TEST(MultiIndex, modify) {
+  Sessions s;
+  Session s1(1, 100);
+  Session s2(2, 200);
+  s.insert(s1);
+  s.insert(s2);
+
+  EXPECT_TRUE(s.modify(s1, [](Session &o) { o.expires = 300; }));
+  EXPECT_EQ(nullptr, s.get<by_expiry>().find(100));
+  EXPECT_EQ(&s1, s.get<by_expiry>().find(300));
+  EXPECT_EQ(&s2, s.get<by_expiry>().minimum());
+  // non keyed indexes keep their order
+  EXPECT_EQ((std::vector<uint64_t>{1, 2}), lru_ids(s));
+
+  EXPECT_FALSE(s.modify(s2, [](Session &o) { o.id = 1; }));
+  EXPECT_EQ(1u, s.size());
+  EXPECT_EQ(&s1, s.get<by_id>().find(1));
+  EXPECT_EQ(nullptr, s.get<by_expiry>().find(200));
+  EXPECT_EQ((std::vector<uint64_t>{1}), lru_ids(s));
+}
+
+TEST(MultiIndex, lru) {
+  Sessions s;
+  std::vector<Session> v(10);
+  for (uint64_t i = 0; i < v.size(); i++) {
+    v[i].id = i;
+    v[i].expires = 1000 + i;
+    s.insert(v[i]);
+  }
+
+  // touch: move to the back of LRU list
+  Session *t = s.get<by_id>().find(3);
+  s.get<by_lru>().erase(*t);
+  s.get<by_lru>().push_back(*t);
+
+  // evict the least recently used
+  Session &victim = s.get<by_lru>().front();
+  EXPECT_EQ(0u, victim.id);
+  s.erase(victim);
+  EXPECT_EQ(9u, s.size());
+  EXPECT_EQ(3u, s.get<by_lru>().back().id);
+  EXPECT_EQ(&v[1], s.get<by_expiry>().minimum());
+}
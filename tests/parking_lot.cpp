@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include <rock/parking_lot.hpp>
+
+
+TEST(ParkingLot, sizes) {
+  EXPECT_EQ(sizeof(rock::byte_lock), 1u);
+  EXPECT_EQ(sizeof(rock::byte_condition), 1u);
+}
+
+TEST(ParkingLot, validate_fails) {
+  int x = 0;
+  auto r = rock::parking_lot::park(&x, []() { return false; });
+  EXPECT_FALSE(r.was_unparked);
+}
+
+TEST(ParkingLot, park_unpark) {
+  std::atomic<int> parked{0};
+  std::thread t([&parked]() {
+      auto r = rock::parking_lot::park(&parked, [&parked]() {
+          parked.store(1);
+          return true;
+        });
+      EXPECT_TRUE(r.was_unparked);
+      EXPECT_EQ(r.token, 7);
+    });
+
+  while (!parked.load()) {
+    std::this_thread::yield();
+  }
+  rock::parking_lot::unpark_result r;
+  do {
+    r = rock::parking_lot::unpark_one(&parked, [](rock::parking_lot::unpark_result) {
+        return intptr_t(7);
+      });
+  } while (!r.did_unpark);
+  EXPECT_FALSE(r.may_have_more);
+  t.join();
+}
+
+TEST(ParkingLot, park_timeout) {
+  int x = 0;
+  auto r = rock::parking_lot::park(&x, []() { return true; }, []() {},
+                                   std::chrono::milliseconds(10));
+  EXPECT_FALSE(r.was_unparked);
+  EXPECT_FALSE(rock::parking_lot::unpark_one(&x).did_unpark);
+}
+
+TEST(ParkingLot, lock_contention) {
+  rock::byte_lock lock;
+  long counter = 0;
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&lock, &counter, i]() {
+        for (int j = 0; j < 20000; j++) {
+          lock.lock();
+          counter++;
+          if (i & 1) {
+            lock.unlock_fairly();
+          } else {
+            lock.unlock();
+          }
+        }
+      });
+  }
+  for (auto &t: threads) {
+    t.join();
+  }
+  EXPECT_EQ(counter, 80000);
+  EXPECT_FALSE(lock.is_locked());
+}
+
+TEST(ParkingLot, condition) {
+  rock::byte_lock lock;
+  rock::byte_condition cond;
+  int produced = 0;
+  int consumed = 0;
+
+  std::thread consumer([&]() {
+      for (int i = 0; i < 1000; i++) {
+        lock.lock();
+        cond.wait(lock, [&]() { return produced > consumed; });
+        consumed++;
+        cond.notify_all();
+        lock.unlock();
+      }
+    });
+
+  for (int i = 0; i < 1000; i++) {
+    lock.lock();
+    cond.wait(lock, [&]() { return produced == consumed; });
+    produced++;
+    cond.notify_all();
+    lock.unlock();
+  }
+  consumer.join();
+  EXPECT_EQ(consumed, 1000);
+}
+
+TEST(ParkingLot, condition_timeout) {
+  rock::byte_lock lock;
+  rock::byte_condition cond;
+
+  lock.lock();
+  EXPECT_FALSE(cond.wait_for(lock, std::chrono::milliseconds(5)));
+  EXPECT_TRUE(lock.is_locked());
+  lock.unlock();
+}
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <rock/percpu.hpp>
+#include <rock/utils.hpp>
+
+
+class MyClass {
+public:
+  explicit MyClass(int a=0) : value(a) {}
+
+  int value;
+  rock::stack_node stack_node_;
+
+  using stack_node_dmp = rock::dmp<rock::stack_node MyClass::*, &MyClass::stack_node_>;
+};
+
+
+class PercpuStack : public ::testing::TestWithParam<bool> {
+protected:
+  // rseq cases pass without running when rseq is not available
+  bool unsupported() const {
+    return GetParam() && !rock::detail::rseq_available();
+  }
+};
+
+TEST_P(PercpuStack, push_pop) {
+  if (unsupported()) {
+    return;
+  }
+  rock::percpu_stack<MyClass::stack_node_dmp> s(GetParam());
+  EXPECT_EQ(GetParam(), s.uses_rseq());
+  EXPECT_EQ(nullptr, s.pop());
+
+  // keep the thread on one CPU, so pops see own pushes
+  rock::detail::cpu_pin pin;
+  ASSERT_TRUE(pin.move_to(rock::detail::current_cpu()));
+
+  MyClass c1(1);
+  MyClass c2(2);
+  MyClass c3(3);
+  s.push(c1);
+  s.push(c2);
+  s.push(c3);
+  EXPECT_EQ(&c3, s.pop());
+  EXPECT_EQ(&c2, s.pop());
+  s.push(c2);
+  EXPECT_EQ(&c2, s.pop());
+  EXPECT_EQ(&c1, s.pop());
+  EXPECT_EQ(nullptr, s.pop());
+}
+
+TEST_P(PercpuStack, drain_all) {
+  if (unsupported()) {
+    return;
+  }
+  rock::percpu_stack<MyClass::stack_node_dmp> s(GetParam());
+  std::vector<MyClass> v(4000);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&s, &v, t]() {
+        for (int i = 0; i < 1000; i++) {
+          MyClass &c = v[static_cast<std::size_t>(t * 1000 + i)];
+          c.value = t * 1000 + i;
+          s.push(c);
+        }
+      });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  std::set<int> seen;
+  std::size_t n = s.drain_all([&seen](MyClass &c) { seen.insert(c.value); });
+  EXPECT_EQ(4000u, n);
+  EXPECT_EQ(4000u, seen.size());
+  EXPECT_EQ(0u, s.drain_all([](MyClass&) {}));
+}
+
+TEST_P(PercpuStack, concurrent_free_list) {
+  if (unsupported()) {
+    return;
+  }
+  // every thread takes and returns objects, nothing is lost or duplicated
+  rock::percpu_stack<MyClass::stack_node_dmp> s(GetParam());
+  std::vector<MyClass> v(256);
+  for (std::size_t i = 0; i < v.size(); i++) {
+    v[i].value = static_cast<int>(i);
+    s.push(v[i]);
+  }
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&s]() {
+        std::vector<MyClass*> taken;
+        for (int i = 0; i < 20000; i++) {
+          MyClass *c = s.pop();
+          if (c) {
+            taken.push_back(c);
+          }
+          if (taken.size() > 8 || (!c && !taken.empty())) {
+            s.push(*taken.back());
+            taken.pop_back();
+          }
+        }
+        for (MyClass *c : taken) {
+          s.push(*c);
+        }
+      });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  std::set<int> seen;
+  EXPECT_EQ(v.size(), s.drain_all([&seen](MyClass &c) { seen.insert(c.value); }));
+  EXPECT_EQ(v.size(), seen.size());
+}
+
+INSTANTIATE_TEST_CASE_P(Mode, PercpuStack, ::testing::Values(false, true));
+
+
+class PercpuCounter : public PercpuStack {};
+
+TEST_P(PercpuCounter, add) {
+  if (unsupported()) {
+    return;
+  }
+  rock::percpu_counter c(GetParam());
+  EXPECT_EQ(0, c.value());
+  c.inc();
+  c.add(10);
+  c.dec();
+  c.sub(3);
+  EXPECT_EQ(7, c.value());
+}
+
+TEST_P(PercpuCounter, concurrent) {
+  if (unsupported()) {
+    return;
+  }
+  rock::percpu_counter c(GetParam());
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&c]() {
+        for (int i = 0; i < 100000; i++) {
+          c.inc();
+        }
+      });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(400000, c.value());
+}
+
+INSTANTIATE_TEST_CASE_P(Mode, PercpuCounter, ::testing::Values(false, true));
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <rock/priority_queue.hpp>
+#include <rock/utils.hpp>
+
+
+class Packet {
+public:
+  explicit Packet(int a=0) : i(a) {}
+
+  int i;
+
+private:
+  rock::queue_node queue_node_;
+
+public:
+  using queue_node_dmp = rock::dmp<rock::queue_node Packet::*, &Packet::queue_node_>;
+};
+
+using Container = rock::priority_queue<Packet::queue_node_dmp>;
+using WideContainer = rock::priority_queue<Packet::queue_node_dmp, 200>;
+
+
+TEST(PriorityQueue, empty) {
+  Container q;
+  EXPECT_TRUE(q.is_empty());
+}
+
+TEST(PriorityQueue, pop_highest) {
+  Container q;
+  Packet p1(1);
+  Packet p2(2);
+  Packet p3(3);
+
+  q.push(p1, 10);
+  q.push(p2, 3);
+  q.push(p3, 63);
+  EXPECT_FALSE(q.is_empty());
+  EXPECT_EQ(q.top_level(), 3u);
+
+  EXPECT_EQ(&q.pop(), &p2);
+  EXPECT_EQ(&q.pop(), &p1);
+  EXPECT_EQ(&q.pop(), &p3);
+  EXPECT_TRUE(q.is_empty());
+}
+
+TEST(PriorityQueue, fifo_within_level) {
+  Container q;
+  Packet p1(1);
+  Packet p2(2);
+
+  q.push(p1, 5);
+  q.push(p2, 5);
+  EXPECT_EQ(&q.front(), &p1);
+  EXPECT_EQ(&q.pop(), &p1);
+  EXPECT_FALSE(q.is_empty(5));
+  EXPECT_EQ(&q.pop(), &p2);
+  EXPECT_TRUE(q.is_empty(5));
+}
+
+TEST(PriorityQueue, pop_level) {
+  Container q;
+  Packet p1(1);
+  Packet p2(2);
+  Packet p3(3);
+
+  q.push(p1, 7);
+  q.push(p2, 7);
+  q.push(p3, 9);
+
+  Container::level_type batch;
+  EXPECT_EQ(q.pop_level(batch), 7u);
+  EXPECT_EQ(&batch.pop(), &p1);
+  EXPECT_EQ(&batch.pop(), &p2);
+  EXPECT_TRUE(batch.is_empty());
+  EXPECT_EQ(q.top_level(), 9u);
+}
+
+TEST(PriorityQueue, multi_word_bitmap) {
+  WideContainer q;
+  Packet p1(1);
+  Packet p2(2);
+
+  q.push(p1, 199);
+  q.push(p2, 128);
+  EXPECT_EQ(q.top_level(), 128u);
+  EXPECT_EQ(&q.pop(), &p2);
+  EXPECT_EQ(&q.pop(), &p1);
+  EXPECT_TRUE(q.is_empty());
+}
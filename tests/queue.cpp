@@ -0,0 +1,236 @@
+#include <gtest/gtest.h>
+
+#include <type_traits>
+#include <vector>
+
+#include <rock/queue.hpp>
+#include <rock/utils.hpp>
+
+
+class MyClass {
+public:
+  explicit MyClass(int a=0) : i(a) {}
+
+  int i;
+
+private:
+  rock::queue_node queue_node_;
+
+public:
+  using queue_node_dmp = rock::dmp<rock::queue_node MyClass::*, &MyClass::queue_node_>;
+};
+
+using Container = rock::queue<MyClass::queue_node_dmp>;
+using Cancellable = rock::cancellable_queue<MyClass::queue_node_dmp>;
+
+
+TEST(Queue, empty) {
+  Container q;
+  EXPECT_TRUE(q.is_empty());
+  EXPECT_EQ(q.begin(), q.end());
+}
+
+TEST(Queue, push_pop) {
+  Container q;
+  MyClass mc1(1);
+  MyClass mc2(2);
+
+  q.push(mc1);
+  q.push(mc2);
+  EXPECT_EQ(&q.front(), &mc1);
+  EXPECT_EQ(&q.back(), &mc2);
+  EXPECT_EQ(&q.pop(), &mc1);
+  EXPECT_EQ(&q.pop(), &mc2);
+  EXPECT_TRUE(q.is_empty());
+}
+
+TEST(Queue, push_after_drain) {
+  Container q;
+  MyClass mc1(1);
+  MyClass mc2(2);
+
+  q.push(mc1);
+  q.pop();
+  q.push(mc2);
+  EXPECT_EQ(&q.front(), &mc2);
+  EXPECT_EQ(&q.back(), &mc2);
+}
+
+TEST(Queue, push_front) {
+  Container q;
+  MyClass mc1(1);
+  MyClass mc2(2);
+  MyClass mc3(3);
+
+  q.push_front(mc2);
+  EXPECT_EQ(&q.back(), &mc2);
+  q.push_front(mc1);
+  q.push(mc3);
+  EXPECT_EQ(&q.pop(), &mc1);
+  EXPECT_EQ(&q.pop(), &mc2);
+  EXPECT_EQ(&q.pop(), &mc3);
+  EXPECT_TRUE(q.is_empty());
+}
+
+TEST(Queue, splice) {
+  Container q1;
+  Container q2;
+  MyClass mc1(1);
+  MyClass mc2(2);
+  MyClass mc3(3);
+
+  q1.push(mc1);
+  q2.push(mc2);
+  q2.push(mc3);
+  q1.splice(q2);
+  EXPECT_TRUE(q2.is_empty());
+
+  int i = 1;
+  for (auto &a: q1) {
+    EXPECT_EQ(a.i, i++);
+  }
+  EXPECT_EQ(i, 4);
+}
+
+
+TEST(Queue, relink_by_address) {
+  static_assert(!std::is_move_constructible<rock::queue_node>::value,
+                "queue_node is relocated only by the queue");
+
+  Container q;
+  MyClass mc[6];
+  const int order[] = {5, 2, 0, 4, 1, 3};
+  for (int i: order) {
+    mc[i].i = i;
+    q.push(mc[i]);
+  }
+
+  q.relink_by_address();
+  int i = 0;
+  for (auto &a: q) {
+    EXPECT_EQ(&a, &mc[i++]);
+  }
+  EXPECT_EQ(i, 6);
+  EXPECT_EQ(&q.back(), &mc[5]);
+
+  MyClass extra(6);
+  q.push(extra);
+  for (int j = 0; j < 6; j++) {
+    EXPECT_EQ(&q.pop(), &mc[j]);
+  }
+  EXPECT_EQ(&q.pop(), &extra);
+  EXPECT_TRUE(q.is_empty());
+}
+
+struct Reclaimed {
+  void reclaim(MyClass &o) {
+    items.push_back(o.i);
+  }
+
+  std::vector<int> items;
+};
+
+TEST(CancellableQueue, cancel) {
+  Reclaimed r;
+  Cancellable q(Cancellable::reclaim_type::from<Reclaimed, &Reclaimed::reclaim>(&r));
+  MyClass mc1(1);
+  MyClass mc2(2);
+  MyClass mc3(3);
+
+  q.push(mc1);
+  q.push(mc2);
+  q.push(mc3);
+  q.cancel(mc2);
+  EXPECT_TRUE(Cancellable::is_cancelled(mc2));
+  EXPECT_EQ(q.size(), 2u);
+  EXPECT_EQ(q.dead(), 1u);
+
+  int i = 1;
+  for (auto &a: q) {
+    EXPECT_EQ(a.i, i);
+    i += 2;
+  }
+  EXPECT_EQ(i, 5);
+
+  EXPECT_EQ(&q.pop(), &mc1);
+  EXPECT_TRUE(r.items.empty());
+  EXPECT_EQ(&q.pop(), &mc3);
+  EXPECT_EQ(r.items, std::vector<int>({2}));
+  EXPECT_FALSE(Cancellable::is_cancelled(mc2));
+  EXPECT_TRUE(q.is_empty());
+  EXPECT_EQ(q.dead(), 0u);
+}
+
+TEST(CancellableQueue, cancel_tail) {
+  Cancellable q;
+  MyClass mc1(1);
+  MyClass mc2(2);
+  MyClass mc3(3);
+
+  q.push(mc1);
+  q.push(mc2);
+  q.cancel(mc2);
+  q.push(mc3);
+  q.cancel(mc1);
+  EXPECT_EQ(&q.front(), &mc3);
+  EXPECT_EQ(q.dead(), 0u);
+  EXPECT_EQ(&q.pop(), &mc3);
+  EXPECT_TRUE(q.is_empty());
+
+  q.push(mc1);
+  q.cancel(mc1);
+  EXPECT_TRUE(q.is_empty());
+  EXPECT_EQ(q.begin(), q.end());
+  q.push(mc2);
+  EXPECT_EQ(&q.pop(), &mc2);
+  EXPECT_EQ(q.dead(), 0u);
+}
+
+TEST(CancellableQueue, compact) {
+  Reclaimed r;
+  Cancellable q(Cancellable::reclaim_type::from<Reclaimed, &Reclaimed::reclaim>(&r), 4);
+  std::vector<MyClass> items(16);
+  for (int i = 0; i < 16; i++) {
+    items[i].i = i;
+    q.push(items[i]);
+  }
+
+  // odd elements are cancelled, compaction starts when tombstones
+  // outnumber both the live elements and max_dead
+  for (int i = 1; i < 16; i += 2) {
+    q.cancel(items[i]);
+  }
+  EXPECT_EQ(q.dead(), 8u);
+  EXPECT_TRUE(r.items.empty());
+  q.cancel(items[0]);
+  EXPECT_EQ(q.dead(), 0u);
+  EXPECT_EQ(r.items, std::vector<int>({0, 1, 3, 5, 7, 9, 11, 13, 15}));
+  EXPECT_EQ(q.size(), 7u);
+
+  q.push(items[1]);
+  int i = 2;
+  for (auto &a: q) {
+    EXPECT_EQ(a.i, i);
+    i = i == 14 ? 1 : i + 2;
+  }
+  EXPECT_EQ(i, 3);
+  while (!q.is_empty()) {
+    q.pop();
+  }
+}
+
+TEST(CancellableQueue, destroy) {
+  Reclaimed r;
+  MyClass mc1(1);
+  MyClass mc2(2);
+  {
+    Cancellable q(Cancellable::reclaim_type::from<Reclaimed, &Reclaimed::reclaim>(&r));
+    q.push(mc1);
+    q.push(mc2);
+    q.cancel(mc1);
+    q.pop();
+    q.push(mc2);
+    q.cancel(mc2);
+  }
+  EXPECT_EQ(r.items, std::vector<int>({1, 2}));
+}
@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <rock/chain.hpp>
+#include <rock/list.hpp>
+#include <rock/snapshot.hpp>
+#include <rock/utils.hpp>
+
+
+class Connection {
+public:
+  explicit Connection(int32_t a=0) : idle(a), bytes(a * 1000LL) {}
+
+  int32_t idle;
+  int64_t bytes;
+  double  score = 0.5;
+
+  rock::list_node list_node_;
+  rock::chain_node chain_node_;
+
+  using list_node_dmp = rock::dmp<rock::list_node Connection::*, &Connection::list_node_>;
+  using chain_node_dmp = rock::dmp<rock::chain_node Connection::*, &Connection::chain_node_>;
+  using idle_dmp = rock::dmp<int32_t Connection::*, &Connection::idle>;
+  using bytes_dmp = rock::dmp<int64_t Connection::*, &Connection::bytes>;
+  using score_dmp = rock::dmp<double Connection::*, &Connection::score>;
+};
+
+static const rock::compare_op all_ops[] = {
+  rock::compare_op::less,
+  rock::compare_op::less_equal,
+  rock::compare_op::greater,
+  rock::compare_op::greater_equal,
+  rock::compare_op::equal,
+  rock::compare_op::not_equal
+};
+
+
+TEST(Snapshot, gather_list) {
+  rock::list<Connection::list_node_dmp> l;
+  Connection c1(5);
+  Connection c2(10);
+  Connection c3(1);
+  l.push_back(c1);
+  l.push_back(c2);
+  l.push_back(c3);
+
+  rock::snapshot<Connection::idle_dmp> s;
+  s.gather(l);
+  EXPECT_EQ(s.size(), 3u);
+  EXPECT_EQ(s.object(1), &c2);
+  EXPECT_EQ(s.min(), 1);
+  EXPECT_EQ(s.max(), 10);
+  EXPECT_EQ(s.count(rock::compare_op::greater, 4), 2u);
+
+  std::vector<Connection*> idle;
+  s.for_each_match(rock::compare_op::greater_equal, 5, [&idle](Connection &c) {
+      idle.push_back(&c);
+    });
+  EXPECT_EQ(idle, (std::vector<Connection*>{&c1, &c2}));
+}
+
+TEST(Snapshot, gather_chain_double) {
+  rock::chain<Connection::chain_node_dmp> c;
+  Connection c1(1);
+  Connection c2(2);
+  c2.score = 0.9;
+  c.push(c1);
+  c.push(c2);
+
+  rock::snapshot<Connection::score_dmp> s;
+  s.gather(c);
+  EXPECT_EQ(s.count(rock::compare_op::greater, 0.6), 1u);
+  EXPECT_DOUBLE_EQ(s.max(), 0.9);
+  EXPECT_TRUE((reinterpret_cast<uintptr_t>(s.values()) & 63) == 0);
+}
+
+TEST(Snapshot, kernels_match_scalar) {
+  std::mt19937 rng(3);
+  rock::list<Connection::list_node_dmp> l;
+  std::vector<std::unique_ptr<Connection>> items;
+  for (int i = 0; i < 1003; i++) {
+    items.emplace_back(new Connection(static_cast<int32_t>(rng() % 200) - 100));
+    items.back()->bytes = static_cast<int64_t>(rng()) * 1000 - 500000;
+    l.push_back(*items.back());
+  }
+
+  rock::snapshot<Connection::idle_dmp> s32;
+  rock::snapshot<Connection::bytes_dmp> s64;
+  s32.gather(l);
+  s64.gather(l);
+
+  std::vector<uint32_t> idx(s32.size());
+  std::vector<uint32_t> expected(s32.size());
+  for (auto op: all_ops) {
+    EXPECT_EQ(s32.count(op, 7), rock::simd::count_scalar(s32.values(), s32.size(), op, 7));
+    EXPECT_EQ(s64.count(op, items[5]->bytes),
+              rock::simd::count_scalar(s64.values(), s64.size(), op, items[5]->bytes));
+
+    std::size_t n = s32.filter(op, -3, idx.data());
+    std::size_t m = rock::simd::filter_scalar(s32.values(), s32.size(), op, -3, expected.data());
+    ASSERT_EQ(n, m);
+    EXPECT_TRUE(std::equal(idx.begin(), idx.begin() + n, expected.begin()));
+
+    n = s64.filter(op, items[9]->bytes, idx.data());
+    m = rock::simd::filter_scalar(s64.values(), s64.size(), op, items[9]->bytes, expected.data());
+    ASSERT_EQ(n, m);
+    EXPECT_TRUE(std::equal(idx.begin(), idx.begin() + n, expected.begin()));
+  }
+
+  EXPECT_EQ(s32.min(), rock::simd::min_scalar(s32.values(), s32.size()));
+  EXPECT_EQ(s32.max(), rock::simd::max_scalar(s32.values(), s32.size()));
+  EXPECT_EQ(s64.min(), rock::simd::min_scalar(s64.values(), s64.size()));
+  EXPECT_EQ(s64.max(), rock::simd::max_scalar(s64.values(), s64.size()));
+
+#ifdef ROCK_SNAPSHOT_X86
+  if (__builtin_cpu_supports("sse4.1")) {
+    for (auto op: all_ops) {
+      EXPECT_EQ(rock::simd::count_sse41(s32.values(), s32.size(), op, 7),
+                rock::simd::count_scalar(s32.values(), s32.size(), op, 7));
+    }
+    EXPECT_EQ(rock::simd::min_sse41(s32.values(), s32.size()),
+              rock::simd::min_scalar(s32.values(), s32.size()));
+    EXPECT_EQ(rock::simd::max_sse41(s32.values(), s32.size()),
+              rock::simd::max_scalar(s32.values(), s32.size()));
+  }
+#endif
+}
+
+TEST(Snapshot, reuse_buffers) {
+  rock::list<Connection::list_node_dmp> l;
+  Connection c1(1);
+  l.push_back(c1);
+
+  rock::snapshot<Connection::idle_dmp> s;
+  s.gather(l);
+  const int32_t *values = s.values();
+  l.erase(c1);
+  s.gather(l);
+  EXPECT_TRUE(s.empty());
+  l.push_back(c1);
+  s.gather(l);
+  EXPECT_EQ(s.values(), values);
+}
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <rock/split_map.hpp>
+#include <rock/utils.hpp>
+
+
+class Session {
+public:
+  explicit Session(uint64_t i=0) : id(i) {}
+
+  uint64_t id;
+  bool reclaimed = false;
+  rock::split_node node_;
+
+  using id_dmp = rock::dmp<uint64_t Session::*, &Session::id>;
+  using node_dmp = rock::dmp<rock::split_node Session::*, &Session::node_>;
+};
+
+using session_map = rock::split_map<Session::node_dmp, Session::id_dmp>;
+
+
+static void mark_reclaimed(Session &s) {
+  EXPECT_FALSE(s.reclaimed);
+  s.reclaimed = true;
+}
+
+static session_map::reclaim_type reclaimer() {
+  return session_map::reclaim_type::from<&mark_reclaimed>();
+}
+
+
+TEST(SplitMap, empty) {
+  session_map m;
+  EXPECT_TRUE(m.empty());
+  EXPECT_EQ(16u, m.bucket_count());
+  EXPECT_EQ(nullptr, m.find(1));
+  EXPECT_EQ(nullptr, m.erase(1));
+}
+
+TEST(SplitMap, insert_find_erase) {
+  Session s1(1);
+  Session s2(2);
+  Session s3(3);
+  {
+    session_map m(reclaimer());
+    EXPECT_TRUE(m.insert(s1));
+    EXPECT_TRUE(m.insert(s2));
+    EXPECT_TRUE(m.insert(s3));
+    EXPECT_EQ(3u, m.size());
+
+    Session dup(2);
+    EXPECT_FALSE(m.insert(dup));
+    EXPECT_EQ(&s2, m.find(2));
+    EXPECT_TRUE(m.contains(1));
+    EXPECT_EQ(nullptr, m.find(4));
+
+    {
+      rock::epoch_guard g;
+      EXPECT_EQ(&s2, m.erase(2));
+      EXPECT_EQ(nullptr, m.find(2));
+      EXPECT_EQ(nullptr, m.erase(2));
+      rock::epoch::reclaim();
+      rock::epoch::reclaim();
+      // still pinned
+      EXPECT_FALSE(s2.reclaimed);
+    }
+    EXPECT_EQ(2u, m.size());
+
+    int n = 0;
+    m.for_each([&n](Session &s) { EXPECT_NE(2u, s.id); n++; });
+    EXPECT_EQ(2, n);
+  }
+  // destructor waits for retired elements
+  EXPECT_TRUE(s2.reclaimed);
+  EXPECT_FALSE(s1.reclaimed);
+}
+
+TEST(SplitMap, growth) {
+  // map waits for retired elements, so it is destroyed first
+  std::vector<Session> sessions(10000);
+  session_map m(reclaimer(), 2);
+  for (std::size_t i = 0; i < sessions.size(); i++) {
+    sessions[i].id = i;
+    ASSERT_TRUE(m.insert(sessions[i]));
+  }
+  EXPECT_EQ(sessions.size(), m.size());
+  EXPECT_GE(m.bucket_count() * session_map::max_load, sessions.size());
+
+  for (std::size_t i = 0; i < sessions.size(); i++) {
+    ASSERT_EQ(&sessions[i], m.find(i));
+  }
+  for (std::size_t i = 0; i < sessions.size(); i += 2) {
+    ASSERT_EQ(&sessions[i], m.erase(i));
+  }
+  for (std::size_t i = 0; i < sessions.size(); i++) {
+    ASSERT_EQ(i % 2 ? &sessions[i] : nullptr, m.find(i));
+  }
+  EXPECT_EQ(sessions.size() / 2, m.size());
+}
+
+TEST(SplitMap, collisions) {
+  struct Constant {
+    std::size_t operator()(uint64_t) const { return 7; }
+  };
+  std::vector<Session> sessions(100);
+  rock::split_map<Session::node_dmp, Session::id_dmp, Constant> m;
+  for (std::size_t i = 0; i < sessions.size(); i++) {
+    sessions[i].id = i;
+    ASSERT_TRUE(m.insert(sessions[i]));
+  }
+  EXPECT_EQ(&sessions[50], m.erase(50));
+  for (std::size_t i = 0; i < sessions.size(); i++) {
+    ASSERT_EQ(i == 50 ? nullptr : &sessions[i], m.find(i));
+  }
+}
+
+TEST(SplitMap, threads) {
+  static constexpr unsigned threads = 4;
+  static constexpr uint64_t per_thread = 5000;
+  std::vector<Session> sessions(threads * per_thread);
+  for (std::size_t i = 0; i < sessions.size(); i++) {
+    sessions[i].id = i;
+  }
+  std::atomic<uint64_t> found{0};
+  {
+    session_map m(reclaimer(), 2);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+      workers.emplace_back([&m, &sessions, &found, t]() {
+          uint64_t first = t * per_thread;
+          for (uint64_t i = first; i < first + per_thread; i++) {
+            EXPECT_TRUE(m.insert(sessions[i]));
+            // readers of other ranges
+            rock::epoch_guard g;
+            Session *s = m.find((i * 7919) % (threads * per_thread));
+            if (s) {
+              EXPECT_FALSE(s->reclaimed);
+              found++;
+            }
+          }
+          for (uint64_t i = first; i < first + per_thread; i += 2) {
+            EXPECT_EQ(&sessions[i], m.erase(i));
+          }
+        });
+    }
+    for (auto &w : workers) {
+      w.join();
+    }
+    EXPECT_EQ(sessions.size() / 2, m.size());
+    for (std::size_t i = 0; i < sessions.size(); i++) {
+      ASSERT_EQ(i % 2 ? &sessions[i] : nullptr, m.find(i));
+    }
+  }
+  for (std::size_t i = 0; i < sessions.size(); i++) {
+    ASSERT_EQ(!(i % 2), sessions[i].reclaimed);
+  }
+  EXPECT_LT(0u, found.load());
+}
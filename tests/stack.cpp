@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <rock/stack.hpp>
+#include <rock/utils.hpp>
+
+
+class MyClass {
+public:
+  explicit MyClass(int a=0) : i(a) {}
+
+  int i;
+
+private:
+  rock::stack_node stack_node_;
+
+public:
+  using stack_node_dmp = rock::dmp<rock::stack_node MyClass::*, &MyClass::stack_node_>;
+};
+
+using Container = rock::stack<MyClass::stack_node_dmp>;
+using Cancellable = rock::cancellable_stack<MyClass::stack_node_dmp>;
+
+
+TEST(Stack, push_pop) {
+  Container s;
+  MyClass mc1(1);
+  MyClass mc2(2);
+
+  EXPECT_TRUE(s.is_empty());
+  s.push(mc1);
+  s.push(mc2);
+  EXPECT_EQ(&s.front(), &mc2);
+  EXPECT_EQ(&s.pop(), &mc2);
+  EXPECT_EQ(&s.pop(), &mc1);
+  EXPECT_TRUE(s.is_empty());
+}
+
+
+struct Reclaimed {
+  void reclaim(MyClass &o) {
+    items.push_back(o.i);
+  }
+
+  std::vector<int> items;
+};
+
+TEST(CancellableStack, cancel) {
+  Reclaimed r;
+  Cancellable s(Cancellable::reclaim_type::from<Reclaimed, &Reclaimed::reclaim>(&r));
+  MyClass mc1(1);
+  MyClass mc2(2);
+  MyClass mc3(3);
+
+  s.push(mc1);
+  s.push(mc2);
+  s.push(mc3);
+  s.cancel(mc2);
+  s.cancel(mc3);
+  EXPECT_TRUE(Cancellable::is_cancelled(mc3));
+  EXPECT_EQ(s.size(), 1u);
+  EXPECT_EQ(s.dead(), 2u);
+
+  int n = 0;
+  for (auto &a: s) {
+    EXPECT_EQ(&a, &mc1);
+    n++;
+  }
+  EXPECT_EQ(n, 1);
+
+  EXPECT_EQ(&s.front(), &mc1);
+  EXPECT_EQ(r.items, std::vector<int>({3, 2}));
+  EXPECT_EQ(&s.pop(), &mc1);
+  EXPECT_TRUE(s.is_empty());
+  EXPECT_EQ(s.begin(), s.end());
+}
+
+TEST(CancellableStack, compact) {
+  Reclaimed r;
+  Cancellable s(Cancellable::reclaim_type::from<Reclaimed, &Reclaimed::reclaim>(&r), 2);
+  std::vector<MyClass> items(8);
+  for (int i = 0; i < 8; i++) {
+    items[i].i = i;
+    s.push(items[i]);
+  }
+
+  for (int i = 0; i < 8; i += 2) {
+    s.cancel(items[i]);
+  }
+  EXPECT_EQ(s.dead(), 4u);
+  s.cancel(items[1]);
+  EXPECT_EQ(s.dead(), 0u);
+  EXPECT_EQ(r.items, std::vector<int>({6, 4, 2, 1, 0}));
+
+  int i = 7;
+  for (auto &a: s) {
+    EXPECT_EQ(a.i, i);
+    i -= 2;
+  }
+  EXPECT_EQ(i, 1);
+  EXPECT_EQ(s.pop().i, 7);
+  EXPECT_EQ(s.pop().i, 5);
+  EXPECT_EQ(s.pop().i, 3);
+  EXPECT_TRUE(s.is_empty());
+}
+
+TEST(CancellableStack, destroy) {
+  Reclaimed r;
+  MyClass mc1(1);
+  MyClass mc2(2);
+  {
+    Cancellable s(Cancellable::reclaim_type::from<Reclaimed, &Reclaimed::reclaim>(&r));
+    s.push(mc1);
+    s.push(mc2);
+    s.cancel(mc1);
+  }
+  EXPECT_EQ(r.items, std::vector<int>({1}));
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <rock/chain.hpp>
+#include <rock/list.hpp>
+#include <rock/queue.hpp>
+#include <rock/stack.hpp>
+#include <rock/stats.hpp>
+#include <rock/utils.hpp>
+
+
+class MyClass {
+public:
+  explicit MyClass(int a=0) : i(a) {}
+
+  int i;
+  uint64_t enqueued_at = 0;
+
+  rock::list_node list_node_;
+  rock::chain_node chain_node_;
+  rock::queue_node queue_node_;
+  rock::stack_node stack_node_;
+
+  using list_node_dmp = rock::dmp<rock::list_node MyClass::*, &MyClass::list_node_>;
+  using chain_node_dmp = rock::dmp<rock::chain_node MyClass::*, &MyClass::chain_node_>;
+  using queue_node_dmp = rock::dmp<rock::queue_node MyClass::*, &MyClass::queue_node_>;
+  using stack_node_dmp = rock::dmp<rock::stack_node MyClass::*, &MyClass::stack_node_>;
+  using enqueued_at_dmp = rock::dmp<uint64_t MyClass::*, &MyClass::enqueued_at>;
+};
+
+
+TEST(Stats, compiled_out_by_default) {
+  EXPECT_EQ(sizeof(rock::queue<MyClass::queue_node_dmp>), 2 * sizeof(void*));
+  EXPECT_EQ(sizeof(rock::stack<MyClass::stack_node_dmp>), sizeof(void*));
+  EXPECT_EQ(sizeof(rock::chain<MyClass::chain_node_dmp>), sizeof(void*));
+  EXPECT_EQ(sizeof(rock::list<MyClass::list_node_dmp>), 2 * sizeof(void*));
+}
+
+TEST(Stats, queue_counters) {
+  rock::queue<MyClass::queue_node_dmp, rock::counter_stats> q;
+  MyClass mc1(1);
+  MyClass mc2(2);
+
+  q.push(mc1);
+  q.push(mc2);
+  q.pop();
+  EXPECT_EQ(q.stats().pushes(), 2u);
+  EXPECT_EQ(q.stats().pops(), 1u);
+  EXPECT_EQ(q.stats().depth(), 1u);
+  EXPECT_EQ(q.stats().high_water(), 2u);
+}
+
+TEST(Stats, queue_splice) {
+  rock::queue<MyClass::queue_node_dmp, rock::counter_stats> q1;
+  rock::queue<MyClass::queue_node_dmp, rock::counter_stats> q2;
+  MyClass mc1(1);
+  MyClass mc2(2);
+
+  q1.push(mc1);
+  q2.push(mc2);
+  q1.splice(q2);
+  EXPECT_EQ(q1.stats().depth(), 2u);
+  EXPECT_EQ(q2.stats().depth(), 0u);
+}
+
+TEST(Stats, list_erase) {
+  rock::list<MyClass::list_node_dmp, rock::counter_stats> l;
+  MyClass mc1(1);
+  MyClass mc2(2);
+  MyClass mc3(2);
+
+  l.push_back(mc1);
+  l.push_back(mc2);
+  l.push_back(mc3);
+  l.erase(mc1);
+  l.unique([](const MyClass &a, const MyClass &b) { return a.i == b.i; });
+  EXPECT_EQ(l.stats().erases(), 2u);
+  EXPECT_EQ(l.stats().depth(), 1u);
+  EXPECT_EQ(l.stats().high_water(), 3u);
+}
+
+TEST(Stats, chain_and_stack) {
+  rock::chain<MyClass::chain_node_dmp, rock::counter_stats> c;
+  rock::stack<MyClass::stack_node_dmp, rock::counter_stats> s;
+  MyClass mc1(1);
+  MyClass mc2(2);
+
+  c.push(mc1);
+  c.push(mc2);
+  c.erase(mc1);
+  EXPECT_EQ(c.stats().depth(), 1u);
+  EXPECT_EQ(c.stats().erases(), 1u);
+
+  s.push(mc1);
+  s.push(mc2);
+  EXPECT_EQ(&s.pop(), &mc2);
+  EXPECT_EQ(&s.pop(), &mc1);
+  EXPECT_TRUE(s.is_empty());
+  EXPECT_EQ(s.stats().pops(), 2u);
+  EXPECT_EQ(s.stats().high_water(), 2u);
+}
+
+TEST(Stats, dwell_time) {
+  rock::queue<MyClass::queue_node_dmp, rock::dwell_stats<MyClass::enqueued_at_dmp>> q;
+  MyClass mc(1);
+
+  q.push(mc);
+  EXPECT_NE(mc.enqueued_at, 0u);
+  q.pop();
+
+  uint64_t total = 0;
+  for (std::size_t i = 0; i < q.stats().buckets; i++) {
+    total += q.stats().histogram(i);
+  }
+  EXPECT_EQ(total, 1u);
+  EXPECT_GE(q.stats().percentile(1.0), q.stats().max_dwell());
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <rock/swiss_index.hpp>
+#include <rock/utils.hpp>
+
+
+class MyClass {
+public:
+  explicit MyClass(uint64_t a=0) : id(a), name(std::to_string(a)) {}
+
+  uint64_t    id;
+  std::string name;
+
+  using id_dmp = rock::dmp<uint64_t MyClass::*, &MyClass::id>;
+  using name_dmp = rock::dmp<std::string MyClass::*, &MyClass::name>;
+};
+
+
+TEST(SwissIndex, empty) {
+  rock::swiss_index<MyClass::id_dmp> s;
+  EXPECT_TRUE(s.empty());
+  EXPECT_EQ(0u, s.size());
+  EXPECT_EQ(nullptr, s.find(1));
+  EXPECT_EQ(nullptr, s.erase(1));
+}
+
+TEST(SwissIndex, insert_find_erase) {
+  rock::swiss_index<MyClass::id_dmp> s;
+  MyClass c1(1);
+  MyClass c2(2);
+  MyClass c3(3);
+  EXPECT_TRUE(s.insert(c1));
+  EXPECT_TRUE(s.insert(c2));
+  EXPECT_TRUE(s.insert(c3));
+  EXPECT_EQ(3u, s.size());
+
+  MyClass dup(2);
+  EXPECT_FALSE(s.insert(dup));
+  EXPECT_EQ(&c2, s.find(2));
+
+  EXPECT_EQ(&c1, s.find(1));
+  EXPECT_EQ(&c3, s.find(3));
+  EXPECT_EQ(nullptr, s.find(4));
+
+  EXPECT_EQ(&c2, s.erase(2));
+  EXPECT_EQ(nullptr, s.find(2));
+  EXPECT_EQ(nullptr, s.erase(2));
+  s.erase(c1);
+  EXPECT_EQ(nullptr, s.find(1));
+  EXPECT_EQ(1u, s.size());
+
+  s.clear();
+  EXPECT_TRUE(s.empty());
+  EXPECT_EQ(nullptr, s.find(3));
+}
+
+TEST(SwissIndex, string_keys) {
+  rock::swiss_index<MyClass::name_dmp> s;
+  std::vector<std::unique_ptr<MyClass>> v;
+  for (uint64_t i = 0; i < 1000; i++) {
+    v.emplace_back(new MyClass(i));
+    EXPECT_TRUE(s.insert(*v.back()));
+  }
+  EXPECT_EQ(1000u, s.size());
+  for (uint64_t i = 0; i < 1000; i++) {
+    EXPECT_EQ(v[i].get(), s.find(std::to_string(i)));
+  }
+  EXPECT_EQ(nullptr, s.find("x"));
+}
+
+TEST(SwissIndex, reserve) {
+  rock::swiss_index<MyClass::id_dmp> s(100);
+  std::size_t c = s.capacity();
+  EXPECT_GE(c, 100u);
+  std::vector<MyClass> v(100);
+  for (uint64_t i = 0; i < 100; i++) {
+    v[i].id = i;
+    s.insert(v[i]);
+  }
+  EXPECT_EQ(c, s.capacity());
+}
+
+TEST(SwissIndex, for_each) {
+  rock::swiss_index<MyClass::id_dmp> s;
+  std::vector<MyClass> v(50);
+  for (uint64_t i = 0; i < 50; i++) {
+    v[i].id = i;
+    s.insert(v[i]);
+  }
+  uint64_t sum = 0;
+  std::size_t n = 0;
+  s.for_each([&](MyClass &c) { sum += c.id; n++; });
+  EXPECT_EQ(50u, n);
+  EXPECT_EQ(49u * 50u / 2u, sum);
+}
+
+TEST(SwissIndex, churn) {
+  // insert/erase cycles leave tombstones, index has to purge them
+  rock::swiss_index<MyClass::id_dmp> s;
+  std::vector<MyClass> v(64);
+  for (uint64_t round = 0; round < 200; round++) {
+    for (uint64_t i = 0; i < 64; i++) {
+      v[i].id = round * 64 + i;
+      ASSERT_TRUE(s.insert(v[i]));
+    }
+    for (uint64_t i = 0; i < 64; i++) {
+      ASSERT_EQ(&v[i], s.erase(round * 64 + i));
+    }
+    ASSERT_TRUE(s.empty());
+  }
+  EXPECT_LE(s.capacity(), 256u);
+}
+
+TEST(SwissIndex, random) {
+  rock::swiss_index<MyClass::id_dmp> s;
+  std::unordered_map<uint64_t, MyClass*> m;
+  std::vector<std::unique_ptr<MyClass>> pool;
+  std::mt19937_64 rng(42);
+
+  for (int i = 0; i < 100000; i++) {
+    uint64_t key = rng() % 5000;
+    if (rng() % 3) {
+      pool.emplace_back(new MyClass(key));
+      bool inserted = m.emplace(key, pool.back().get()).second;
+      ASSERT_EQ(inserted, s.insert(*pool.back()));
+    } else {
+      auto it = m.find(key);
+      MyClass *e = s.erase(key);
+      if (it == m.end()) {
+        ASSERT_EQ(nullptr, e);
+      } else {
+        ASSERT_EQ(it->second, e);
+        m.erase(it);
+      }
+    }
+  }
+  ASSERT_EQ(m.size(), s.size());
+  for (uint64_t key = 0; key < 5000; key++) {
+    auto it = m.find(key);
+    ASSERT_EQ(it == m.end() ? nullptr : it->second, s.find(key));
+  }
+}
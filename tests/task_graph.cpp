@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <random>
+#include <vector>
+
+#include <rock/task_graph.hpp>
+
+
+class Step {
+public:
+  Step() : task(rock::task::body_type::from<Step, &Step::run>(this)) {}
+
+  void run() {
+    for (Step *p : predecessors) {
+      if (p->runs.load() != runs.load() + 1) {
+        violations++;
+      }
+    }
+    order = clock->fetch_add(1);
+    runs++;
+  }
+
+  rock::task         task;
+  std::vector<Step*> predecessors;
+  std::atomic<int>   runs{0};
+  int                order = -1;
+  std::atomic<int>  *clock = nullptr;
+
+  static std::atomic<int> violations;
+};
+
+std::atomic<int> Step::violations{0};
+
+
+TEST(TaskGraph, empty) {
+  rock::task_executor e(2);
+  rock::task_graph g;
+  e.run(g);
+  EXPECT_TRUE(g.empty());
+}
+
+TEST(TaskGraph, diamond_sequential) {
+  // a -> b, a -> c, b -> d, c -> d
+  rock::task_executor e(0);
+  rock::task_graph g;
+  std::atomic<int> clock{0};
+  Step s[4];
+  rock::task_edge edges[4];
+  for (auto &i : s) {
+    i.clock = &clock;
+    g.add(i.task);
+  }
+  g.precede(s[0].task, s[1].task, edges[0]);
+  g.precede(s[0].task, s[2].task, edges[1]);
+  g.precede(s[1].task, s[3].task, edges[2]);
+  g.precede(s[2].task, s[3].task, edges[3]);
+  EXPECT_EQ(2u, s[3].task.dependencies());
+
+  e.run(g);
+  EXPECT_EQ(0, s[0].order);
+  EXPECT_EQ(3, s[3].order);
+  for (auto &i : s) {
+    EXPECT_EQ(1, i.runs.load());
+  }
+
+  // graph is reused without any changes
+  clock = 0;
+  e.run(g);
+  EXPECT_EQ(0, s[0].order);
+  EXPECT_EQ(3, s[3].order);
+  for (auto &i : s) {
+    EXPECT_EQ(2, i.runs.load());
+  }
+}
+
+TEST(TaskGraph, random_dag_parallel) {
+  const std::size_t n = 500;
+  rock::task_executor e(4);
+  rock::task_graph g;
+  std::atomic<int> clock{0};
+  std::vector<Step> steps(n);
+  std::vector<rock::task_edge> edges(n * 3);
+  std::mt19937 rng(3);
+
+  std::size_t used = 0;
+  for (std::size_t i = 0; i < n; i++) {
+    steps[i].clock = &clock;
+    g.add(steps[i].task);
+    // edges only go forward, so the graph is acyclic
+    for (int k = 0; k < 3 && i > 0; k++) {
+      std::size_t p = rng() % i;
+      g.precede(steps[p].task, steps[i].task, edges[used++]);
+      steps[i].predecessors.push_back(&steps[p]);
+    }
+  }
+
+  Step::violations = 0;
+  for (int run = 1; run <= 20; run++) {
+    e.run(g);
+    for (auto &s : steps) {
+      ASSERT_EQ(run, s.runs.load());
+    }
+  }
+  EXPECT_EQ(0, Step::violations.load());
+}
+
+TEST(TaskGraph, independent_tasks) {
+  rock::task_executor e(3);
+  EXPECT_EQ(3u, e.threads());
+  rock::task_graph g;
+  std::atomic<int> clock{0};
+  std::vector<Step> steps(100);
+  for (auto &s : steps) {
+    s.clock = &clock;
+    g.add(s.task);
+  }
+  e.run(g);
+  EXPECT_EQ(100, clock.load());
+}
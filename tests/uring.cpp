@@ -0,0 +1,231 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <rock/uring.hpp>
+
+
+class Request {
+public:
+  Request() {
+    op.on_complete = rock::uring_operation::completion_type::from<Request, &Request::complete>(this);
+  }
+
+  void complete(const rock::uring_completion &c) {
+    results.push_back(c.res);
+    flags.push_back(c.flags);
+  }
+
+  rock::uring_operation op;
+  std::vector<int32_t>  results;
+  std::vector<uint32_t> flags;
+};
+
+
+static void drain(rock::uring &ring) {
+  while (ring.has_pending() || ring.in_flight()) {
+    ring.wait();
+  }
+}
+
+
+TEST(Uring, nop_batch) {
+  rock::uring ring(8);
+  std::vector<Request> reqs(20);
+  for (auto &r : reqs) {
+    r.op.prep_nop();
+    ring.submit(r.op);
+  }
+  EXPECT_TRUE(ring.has_pending());
+  // only 8 operations fit into the ring at once, rest stays queued
+  EXPECT_EQ(8, ring.flush());
+  EXPECT_TRUE(ring.has_pending());
+  drain(ring);
+  for (auto &r : reqs) {
+    ASSERT_EQ(1u, r.results.size());
+    EXPECT_EQ(0, r.results[0]);
+  }
+  EXPECT_EQ(0u, ring.in_flight());
+}
+
+TEST(Uring, file_write_read) {
+  rock::uring ring;
+  FILE *f = tmpfile();
+  ASSERT_NE(nullptr, f);
+  int fd = fileno(f);
+
+  const std::string data = "hello, io_uring";
+  Request w;
+  w.op.prep_write(fd, data.data(), static_cast<uint32_t>(data.size()), 0);
+  ring.submit(w.op);
+  drain(ring);
+  ASSERT_EQ(1u, w.results.size());
+  EXPECT_EQ(static_cast<int32_t>(data.size()), w.results[0]);
+
+  char buf[64] = {};
+  Request r;
+  r.op.prep_read(fd, buf, sizeof(buf), 0);
+  ring.submit(r.op);
+  drain(ring);
+  ASSERT_EQ(1u, r.results.size());
+  EXPECT_EQ(static_cast<int32_t>(data.size()), r.results[0]);
+  EXPECT_EQ(data, std::string(buf, data.size()));
+  fclose(f);
+}
+
+TEST(Uring, registered_buffers) {
+  rock::uring ring;
+  FILE *f = tmpfile();
+  ASSERT_NE(nullptr, f);
+  int fd = fileno(f);
+
+  static char storage[4096];
+  struct iovec iov = {storage, sizeof(storage)};
+  ring.register_buffers(&iov, 1);
+
+  std::memcpy(storage, "fixed", 5);
+  Request w;
+  w.op.prep_write_fixed(fd, storage, 5, 0, 0);
+  ring.submit(w.op);
+  drain(ring);
+  EXPECT_EQ(5, w.results.at(0));
+
+  std::memset(storage, 0, sizeof(storage));
+  Request r;
+  r.op.prep_read_fixed(fd, storage + 100, 5, 0, 0);
+  ring.submit(r.op);
+  drain(ring);
+  EXPECT_EQ(5, r.results.at(0));
+  EXPECT_EQ(0, std::memcmp(storage + 100, "fixed", 5));
+
+  ring.unregister_buffers();
+  fclose(f);
+}
+
+TEST(Uring, socketpair_send_recv) {
+  rock::uring ring;
+  int sv[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+
+  char buf[16] = {};
+  Request r;
+  r.op.prep_recv(sv[1], buf, sizeof(buf));
+  ring.submit(r.op);
+  Request s;
+  s.op.prep_send(sv[0], "ping", 4);
+  ring.submit(s.op);
+  drain(ring);
+  EXPECT_EQ(4, s.results.at(0));
+  EXPECT_EQ(4, r.results.at(0));
+  EXPECT_EQ("ping", std::string(buf, 4));
+
+  close(sv[0]);
+  close(sv[1]);
+}
+
+TEST(Uring, multishot_recv) {
+  rock::uring ring;
+  rock::uring_buffer_ring buffers(ring, 1, 8, 64);
+  int sv[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+
+  std::string received;
+  struct Receiver {
+    rock::uring_buffer_ring *buffers;
+    std::string *received;
+    int completions;
+    bool done;
+
+    void complete(const rock::uring_completion &c) {
+      completions++;
+      if (c.res > 0) {
+        EXPECT_TRUE(c.has_buffer());
+        received->append(buffers->buffer(c.buffer_id()), static_cast<std::size_t>(c.res));
+        buffers->recycle(c.buffer_id());
+      }
+      if (!c.more()) {
+        done = true;
+      }
+    }
+  } receiver{&buffers, &received, 0, false};
+
+  rock::uring_operation op;
+  op.on_complete = rock::uring_operation::completion_type::from<Receiver, &Receiver::complete>(&receiver);
+  op.prep_recv_multishot(sv[1], buffers.group());
+  ring.submit(op);
+  ring.flush();
+
+  for (int i = 0; i < 20; i++) {
+    std::string m = "msg" + std::to_string(i) + ";";
+    ASSERT_EQ(static_cast<ssize_t>(m.size()), write(sv[0], m.data(), m.size()));
+    ring.wait();
+  }
+  close(sv[0]);
+  while (!receiver.done) {
+    ring.wait();
+  }
+
+  std::string expected;
+  for (int i = 0; i < 20; i++) {
+    expected += "msg" + std::to_string(i) + ";";
+  }
+  EXPECT_EQ(expected, received);
+  EXPECT_GE(receiver.completions, 2);
+  EXPECT_EQ(0u, ring.in_flight());
+  close(sv[1]);
+}
+
+TEST(Uring, multishot_accept_and_cancel) {
+  rock::uring ring;
+  int l = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(l, 0);
+  struct sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(0, bind(l, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)));
+  ASSERT_EQ(0, listen(l, 16));
+  socklen_t len = sizeof(addr);
+  ASSERT_EQ(0, getsockname(l, reinterpret_cast<struct sockaddr*>(&addr), &len));
+
+  Request accept;
+  accept.op.prep_accept_multishot(l);
+  ring.submit(accept.op);
+  ring.flush();
+
+  std::vector<int> clients;
+  for (int i = 0; i < 3; i++) {
+    int c = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(0, connect(c, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)));
+    clients.push_back(c);
+  }
+  while (accept.results.size() < 3) {
+    ring.wait();
+  }
+  for (std::size_t i = 0; i < 3; i++) {
+    EXPECT_GE(accept.results[i], 0);
+    EXPECT_TRUE(accept.flags[i] & IORING_CQE_F_MORE);
+    close(accept.results[i]);
+  }
+  EXPECT_EQ(1u, ring.in_flight());
+
+  Request cancel;
+  cancel.op.prep_cancel(accept.op);
+  ring.submit(cancel.op);
+  drain(ring);
+  EXPECT_EQ(0, cancel.results.at(0));
+  EXPECT_EQ(-ECANCELED, accept.results.back());
+  EXPECT_FALSE(accept.flags.back() & IORING_CQE_F_MORE);
+
+  for (int c : clients) {
+    close(c);
+  }
+  close(l);
+}